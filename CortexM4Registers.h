@@ -36,4 +36,9 @@ void causeHardFault(void);
 extern void pushR4R11(void);
 extern void popR4R11(void);
 
+/********************************************************************************/
+/********************************************************************************/
+extern void *popFreeListAtomic(void **head);
+extern void pushFreeListAtomic(void **head, void *block);
+
 #endif
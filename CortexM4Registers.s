@@ -201,3 +201,36 @@ popR4R11:
     msr psp, r0
     bx lr
 
+;********************************************************************************
+; @brief
+; Pops the first block of a free list, r0 holds the address of the list head.
+; Each free block stores the address of the next one in its first word.
+; Any exception between LDREX and STREX clears the exclusive monitor, so the
+; STREX fails and the pop is retried: safe against ISRs without masking them
+; @return The block or 0 if the list is empty
+    .def popFreeListAtomic
+popFreeListAtomic:
+    ldrex r1, [r0]          ; r1 = head
+    cbz r1, popFreeListEmpty
+    ldr r2, [r1]            ; r2 = head->next
+    strex r3, r2, [r0]      ; head = head->next, r3 = 0 on success
+    cmp r3, #0
+    bne popFreeListAtomic   ; Interrupted, try again
+    mov r0, r1
+    bx lr
+popFreeListEmpty:
+    clrex
+    mov r0, #0
+    bx lr
+
+; @brief
+; Pushes the block in r1 on the free list whose head address is in r0
+    .def pushFreeListAtomic
+pushFreeListAtomic:
+    ldrex r2, [r0]          ; r2 = head
+    str r2, [r1]            ; block->next = head
+    strex r3, r1, [r0]      ; head = block, r3 = 0 on success
+    cmp r3, #0
+    bne pushFreeListAtomic  ; Interrupted, try again
+    bx lr
+
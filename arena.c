@@ -0,0 +1,179 @@
+// Task arena functions
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target uC:       TM4C123GH6PM
+// System Clock:    40 MHz
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#include <stdint.h>
+#include "arena.h"
+#include "kernel.h"
+#include "mm.h"
+#include "shell_auxiliary.h"
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+/**
+ * @brief
+ * Size class of an object of total bytes (header included), the smallest
+ * power of two that fits, i.e. 32 - CLZ(total - 1)
+ */
+static uint8_t arenaClass(uint32_t total)
+{
+    uint8_t shift = 32 - CLZ(total - 1);
+
+    return shift <= ARENA_MIN_CLASS_SHIFT ? 0 : shift - ARENA_MIN_CLASS_SHIFT;
+}
+
+/**
+ * @brief
+ * Adds a block of the given class to its free list
+ */
+static void arenaPush(ARENA *arena, uint8_t *block, uint8_t cls)
+{
+    ((ARENA_BLOCK *)block)->next = arena->freeLists[cls];
+    arena->freeLists[cls] = (ARENA_BLOCK *)block;
+}
+
+/**
+ * @brief
+ * Makes [chunk, chunk + size) the current chunk after splitting what
+ * is left of the previous one into the free lists
+ */
+static void arenaAddChunk(ARENA *arena, uint8_t *chunk, uint32_t size)
+{
+    int8_t cls;
+
+    for (cls = ARENA_NUM_CLASSES - 1; cls >= 0; cls--)
+    {
+        uint32_t classSize = 1 << (cls + ARENA_MIN_CLASS_SHIFT);
+
+        while (arena->bump + classSize <= arena->bumpEnd)
+        {
+            arenaPush(arena, arena->bump, cls);
+            arena->bump += classSize;
+        }
+    }
+
+    arena->bump = chunk;
+    arena->bumpEnd = chunk + size;
+    arena->bytesGranted += size;
+}
+
+/**
+ * @brief
+ * Asks the kernel for more memory, the only path that makes a service call
+ */
+static bool arenaGrow(ARENA *arena, uint32_t size)
+{
+    uint32_t alignedSize = ALIGN_SIZE(size);
+    uint8_t *chunk = malloc_from_heap_wrapper(alignedSize);
+
+    arena->chunkRequests++;
+    if (chunk == NULL)
+        return false;
+
+    arenaAddChunk(arena, chunk, alignedSize);
+    return true;
+}
+
+/**
+ * @brief
+ * Prepares an arena and grants it initialBytes (0 to grow on the first allocation)
+ */
+bool arenaInit(ARENA *arena, uint32_t initialBytes)
+{
+    uint8_t cls;
+
+    for (cls = 0; cls < ARENA_NUM_CLASSES; cls++)
+        arena->freeLists[cls] = NULL;
+    arena->bump = NULL;
+    arena->bumpEnd = NULL;
+    arena->bytesGranted = 0;
+    arena->bytesInUse = 0;
+    arena->chunkRequests = 0;
+
+    return initialBytes == 0 || arenaGrow(arena, initialBytes);
+}
+
+/**
+ * @brief
+ * Allocates size bytes from the arena
+ *
+ * @return The object or NULL if the kernel has no memory left
+ */
+void *arenaAlloc(ARENA *arena, uint32_t size)
+{
+    uint32_t total = size + ARENA_HEADER_SIZE;
+    uint32_t *block;
+    uint32_t classSize;
+    uint8_t cls;
+
+    if (size == 0 || total < size)
+        return NULL;
+
+    // Too big for the classes, straight from the heap
+    if (total > ARENA_MAX_CLASS_SIZE)
+    {
+        block = malloc_from_heap_wrapper(total);
+        if (block == NULL)
+            return NULL;
+        block[0] = ARENA_LARGE;
+        return block + 1;
+    }
+
+    cls = arenaClass(total);
+    classSize = 1 << (cls + ARENA_MIN_CLASS_SHIFT);
+
+    if (arena->freeLists[cls] != NULL)
+    {
+        block = (uint32_t *)arena->freeLists[cls];
+        arena->freeLists[cls] = arena->freeLists[cls]->next;
+    }
+    else
+    {
+        if (arena->bump + classSize > arena->bumpEnd && !arenaGrow(arena, ARENA_CHUNK_SIZE))
+            return NULL;
+        block = (uint32_t *)arena->bump;
+        arena->bump += classSize;
+    }
+
+    block[0] = cls;
+    arena->bytesInUse += classSize;
+    return block + 1;
+}
+
+/**
+ * @brief
+ * Returns an object allocated with arenaAlloc() to the arena
+ */
+void arenaFree(ARENA *arena, void *ptr)
+{
+    uint32_t *block;
+    uint8_t cls;
+
+    if (ptr == NULL)
+        return;
+
+    block = (uint32_t *)ptr - 1;
+    if (block[0] == ARENA_LARGE)
+    {
+        free_to_heap_wrapper(block);
+        return;
+    }
+
+    cls = block[0];
+    if (cls >= ARENA_NUM_CLASSES)
+        return;
+
+    arena->bytesInUse -= 1 << (cls + ARENA_MIN_CLASS_SHIFT);
+    arenaPush(arena, (uint8_t *)block, cls);
+}
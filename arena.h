@@ -0,0 +1,70 @@
+// Task arena functions
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target uC:       TM4C123GH6PM
+// System Clock:    40 MHz
+
+#ifndef ARENA_H_
+#define ARENA_H_
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+    Per-task small object allocator that runs in the task, without service calls.
+
+    The task owns the ARENA (usually a local in its task function, globals are
+    not accessible to unprivileged code). Memory comes from the kernel in
+    ARENA_CHUNK_SIZE chunks through malloc_from_heap_wrapper(), only when the
+    arena has run out of space.
+
+    - Objects are rounded up to a size class: 16, 32, 64, 128 or 256 bytes
+      including a 4 byte header holding the class
+    - Freed objects go on a per class free list (the link is stored in the
+      object), allocation pops the list or bumps a pointer in the current chunk
+    - When a chunk cannot fit the requested class, its tail is split into the
+      smaller class free lists before a new chunk is requested
+    - Larger objects are passed straight to malloc_from_heap_wrapper() and
+      free_to_heap_wrapper()
+
+    Chunks are not returned to the kernel while the task runs, stopping the
+    task reclaims them with the rest of its memory.
+*/
+#define ARENA_NUM_CLASSES 5
+#define ARENA_MIN_CLASS_SHIFT 4 // 16 bytes
+#define ARENA_MAX_CLASS_SIZE (1 << (ARENA_MIN_CLASS_SHIFT + ARENA_NUM_CLASSES - 1))
+#define ARENA_HEADER_SIZE 4
+#define ARENA_CHUNK_SIZE 512    // One 512 B subregion
+#define ARENA_LARGE 0xFF        // Header class of an object allocated directly from the heap
+
+typedef struct _ARENA_BLOCK
+{
+    struct _ARENA_BLOCK *next;
+} ARENA_BLOCK;
+
+typedef struct _ARENA
+{
+    ARENA_BLOCK *freeLists[ARENA_NUM_CLASSES];
+    uint8_t *bump;             // Next unused byte of the current chunk
+    uint8_t *bumpEnd;          // End of the current chunk
+    uint32_t bytesGranted;     // Bytes of heap given to the arena by the kernel
+    uint32_t bytesInUse;       // Bytes of the live objects, headers included
+    uint32_t chunkRequests;    // Service calls made to grow the arena
+} ARENA;
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+bool arenaInit(ARENA *arena, uint32_t initialBytes);
+void *arenaAlloc(ARENA *arena, uint32_t size);
+void arenaFree(ARENA *arena, void *ptr);
+
+#endif
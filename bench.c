@@ -0,0 +1,378 @@
+// Benchmark functions
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target uC:       TM4C123GH6PM
+// System Clock:    40 MHz
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#include <stdint.h>
+#include "tm4c123gh6pm.h"
+#include "bench.h"
+#include "uart0.h"
+#include "shell_auxiliary.h"
+#include "shell_commands.h"
+#include "kstats.h"
+
+#ifdef BENCH
+typedef void (*_benchFn)(uint32_t samples[], uint32_t overhead);
+
+typedef struct _BENCHMARK
+{
+    const char *name;
+    _benchFn fn;
+} BENCHMARK;
+
+//-----------------------------------------------------------------------------
+// Peer tasks
+//-----------------------------------------------------------------------------
+
+/**
+ * @brief
+ * BenchSem: the other end of the semaphore ping-pong
+ */
+void benchEcho(void)
+{
+    while (true)
+    {
+        wait(benchPing);
+        post(benchPong);
+    }
+}
+
+/**
+ * @brief
+ * BenchMtx: holds benchMutex across one task switch so the caller finds
+ * it locked, then hands it over
+ */
+void benchHolder(void)
+{
+    while (true)
+    {
+        wait(benchHold);
+        lock(benchMutex);
+        post(benchPong);
+        yield();
+        unlock(benchMutex);
+    }
+}
+
+/**
+ * @brief
+ * BenchYld: the other end of the yield round trips, a little longer than
+ * the caller so every sample switches, then reports it is done
+ */
+void benchYielder(void)
+{
+    uint16_t i;
+
+    while (true)
+    {
+        wait(benchSwitch);
+        for (i = 0; i < BENCH_YIELDS; i++)
+            yield();
+        post(benchPong);
+    }
+}
+
+//-----------------------------------------------------------------------------
+// Benchmarks
+//-----------------------------------------------------------------------------
+
+/**
+ * @brief
+ * Cycles between two reads less the cost of the reads, 0 if they were faster
+ */
+static uint32_t elapsed(uint32_t start, uint32_t end, uint32_t overhead)
+{
+    uint32_t cycles = end - start;
+
+    return cycles > overhead ? cycles - overhead : 0;
+}
+
+static void benchSvc(uint32_t samples[], uint32_t overhead)
+{
+    uint32_t start;
+    uint16_t i;
+
+    for (i = 0; i < BENCH_SAMPLES; i++)
+    {
+        start = getCycleCount();
+        samples[i] = getCycleCount() - start;
+    }
+}
+
+static void benchYield(uint32_t samples[], uint32_t overhead)
+{
+    uint32_t start;
+    uint16_t i;
+
+    for (i = 0; i < BENCH_SAMPLES; i++)
+    {
+        start = getCycleCount();
+        yield();
+        samples[i] = elapsed(start, getCycleCount(), overhead);
+    }
+}
+
+static void benchContextSwitch(uint32_t samples[], uint32_t overhead)
+{
+    uint32_t start;
+    uint16_t i;
+
+    // The first yields line up the two tasks in the priority ring
+    post(benchSwitch);
+    for (i = 0; i < BENCH_WARMUP; i++)
+        yield();
+
+    // There and back is two switches
+    for (i = 0; i < BENCH_SAMPLES; i++)
+    {
+        start = getCycleCount();
+        yield();
+        samples[i] = elapsed(start, getCycleCount(), overhead) / 2;
+    }
+
+    // BenchYld must be blocked again before the next benchmark
+    wait(benchPong);
+}
+
+static void benchSemaphore(uint32_t samples[], uint32_t overhead)
+{
+    uint32_t start;
+    uint16_t i;
+
+    for (i = 0; i < BENCH_SAMPLES; i++)
+    {
+        start = getCycleCount();
+        post(benchPing);
+        wait(benchPong);
+        samples[i] = elapsed(start, getCycleCount(), overhead);
+    }
+}
+
+static void benchLock(uint32_t samples[], uint32_t overhead)
+{
+    uint32_t start;
+    uint16_t i;
+
+    for (i = 0; i < BENCH_SAMPLES; i++)
+    {
+        start = getCycleCount();
+        lock(benchMutex);
+        unlock(benchMutex);
+        samples[i] = elapsed(start, getCycleCount(), overhead);
+    }
+}
+
+static void benchContended(uint32_t samples[], uint32_t overhead)
+{
+    uint32_t start;
+    uint16_t i;
+
+    for (i = 0; i < BENCH_SAMPLES; i++)
+    {
+        // BenchMtx runs until it holds the mutex and yields back
+        post(benchHold);
+        wait(benchPong);
+
+        start = getCycleCount();
+        lock(benchMutex);
+        samples[i] = elapsed(start, getCycleCount(), overhead);
+        unlock(benchMutex);
+    }
+}
+
+static void benchSleep(uint32_t samples[], uint32_t overhead)
+{
+    uint32_t start;
+    uint16_t i;
+
+    for (i = 0; i < BENCH_SAMPLES; i++)
+    {
+        start = getCycleCount();
+        sleep(0);
+        samples[i] = elapsed(start, getCycleCount(), overhead);
+    }
+}
+
+static void benchMalloc(uint32_t samples[], uint32_t overhead)
+{
+    uint32_t start;
+    void *p;
+    uint16_t i;
+
+    for (i = 0; i < BENCH_SAMPLES; i++)
+    {
+        start = getCycleCount();
+        p = malloc_from_heap_wrapper(BENCH_BLOCK_SIZE);
+        samples[i] = elapsed(start, getCycleCount(), overhead);
+        free_to_heap_wrapper(p);
+    }
+}
+
+static void benchFree(uint32_t samples[], uint32_t overhead)
+{
+    uint32_t start;
+    void *p;
+    uint16_t i;
+
+    for (i = 0; i < BENCH_SAMPLES; i++)
+    {
+        p = malloc_from_heap_wrapper(BENCH_BLOCK_SIZE);
+        start = getCycleCount();
+        free_to_heap_wrapper(p);
+        samples[i] = elapsed(start, getCycleCount(), overhead);
+    }
+}
+
+static const BENCHMARK benchmarks[] = {
+    {"svc", benchSvc},
+    {"yield", benchYield},
+    {"switch", benchContextSwitch},
+    {"sem", benchSemaphore},
+    {"lock", benchLock},
+    {"contended", benchContended},
+    {"sleep", benchSleep},
+    {"malloc", benchMalloc},
+    {"free", benchFree},
+};
+
+#define NUM_BENCHMARKS (sizeof(benchmarks) / sizeof(benchmarks[0]))
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+/**
+ * @brief
+ * Creates the peer tasks, called from main() with the other threads
+ */
+bool initBench(void)
+{
+    bool ok;
+
+    initMutex(benchMutex);
+    initSemaphore(benchPing, 0);
+    initSemaphore(benchPong, 0);
+    initSemaphore(benchHold, 0);
+    initSemaphore(benchSwitch, 0);
+
+    ok =  createThread(benchEcho, "BenchSem", BENCH_PEER_PRIORITY, 512);
+    ok &= createThread(benchHolder, "BenchMtx", BENCH_PEER_PRIORITY, 512);
+    ok &= createThread(benchYielder, "BenchYld", BENCH_PRIORITY, 512);
+    return ok;
+}
+
+/**
+ * @brief
+ * Sorts the samples in place, insertion sort is enough for BENCH_SAMPLES
+ */
+static void sortSamples(uint32_t samples[])
+{
+    uint32_t value;
+    uint16_t i, j;
+
+    for (i = 1; i < BENCH_SAMPLES; i++)
+    {
+        value = samples[i];
+        for (j = i; j > 0 && samples[j - 1] > value; j--)
+            samples[j] = samples[j - 1];
+        samples[j] = value;
+    }
+}
+
+/**
+ * @brief
+ * Prints one line of results: min, avg, p50, p90, p99 and max
+ */
+static void putResults(const char name[], uint32_t samples[])
+{
+    uint64_t sum = 0;
+    uint16_t i;
+
+    sortSamples(samples);
+    for (i = 0; i < BENCH_SAMPLES; i++)
+        sum += samples[i];
+
+    putsUart0(name);
+    for (i = stringLength(name); i < 11; i++)
+        putcUart0(' ');
+    putPadded(samples[0], 8);
+    putPadded(sum / BENCH_SAMPLES, 8);
+    putPadded(samples[(BENCH_SAMPLES - 1) * 50 / 100], 8);
+    putPadded(samples[(BENCH_SAMPLES - 1) * 90 / 100], 8);
+    putPadded(samples[(BENCH_SAMPLES - 1) * 99 / 100], 8);
+    putPadded(samples[BENCH_SAMPLES - 1], 0);
+    putcUart0('\n');
+}
+
+/**
+ * @brief
+ * Runs the benchmark called name, or all of them if name is NULL, and
+ * prints the results in cycles. caller is the PID of the calling task,
+ * its priority is raised for the duration.
+ * Runs in the calling (unprivileged) task, so every buffer lives on its stack
+ */
+void runBenchmarks(_fn caller, const char name[])
+{
+    uint32_t samples[BENCH_SAMPLES];
+    uint32_t overhead;
+    uint8_t priority = BENCH_PRIORITY;
+    uint8_t i;
+    bool found = false;
+    KSTATS stats;
+
+    for (i = 0; i < NUM_BENCHMARKS; i++)
+        found |= name == NULL || strCmp(name, benchmarks[i].name);
+    if (!found)
+    {
+        putsUart0("Benchmarks:");
+        for (i = 0; i < NUM_BENCHMARKS; i++)
+        {
+            putcUart0(' ');
+            putsUart0(benchmarks[i].name);
+        }
+        putsUart0("\n\n");
+        return;
+    }
+
+    readKernelStats(&stats);
+    for (i = 0; i < stats.taskCount; i++)
+    {
+        if (stats.tasks[i].pid == (uint32_t)caller)
+            priority = stats.tasks[i].priority;
+    }
+    setThreadPriority(caller, BENCH_PRIORITY);
+
+    // Cost of the two reads that every other sample is corrected by
+    benchSvc(samples, 0);
+    sortSamples(samples);
+    overhead = samples[0];
+
+    putsUart0("\nBenchmark  Min     Avg     p50     p90     p99     Max\n");
+    putsUart0("------------------------------------------------------------\n");
+    for (i = 0; i < NUM_BENCHMARKS; i++)
+    {
+        if (name != NULL && !strCmp(name, benchmarks[i].name))
+            continue;
+        benchmarks[i].fn(samples, overhead);
+        putResults(benchmarks[i].name, samples);
+    }
+    putsUart0("cycles, ");
+    putPadded(BENCH_SAMPLES, 0);
+    putsUart0(" samples each\n\n");
+
+    setThreadPriority(caller, priority);
+}
+#else
+void runBenchmarks(_fn caller, const char name[])
+{
+    putsUart0("No benchmarks, build with BENCH defined\n\n");
+}
+#endif
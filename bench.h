@@ -0,0 +1,70 @@
+// Benchmark functions
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target uC:       TM4C123GH6PM
+// System Clock:    40 MHz
+
+#ifndef BENCH_H_
+#define BENCH_H_
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "kernel.h"
+
+/*
+    Microbenchmarks of the kernel primitives, run by the shell's bench command,
+    built in with BENCH defined
+
+    Times are CPU cycles from getCycleCount(). Tasks are unprivileged and the
+    DWT cycle counter is on the private peripheral bus, so the counter is
+    read in a service call. A sample is the difference of two reads around
+    the operation minus the fastest empty pair (the "svc" benchmark), which
+    leaves the cost of the operation alone.
+
+    svc        service call entry and exit, two back to back reads (not corrected)
+    yield      yield() with no other task ready at the caller's priority
+    switch     one task switch, half of a yield() round trip through BenchYld
+    sem        post(benchPing) then wait(benchPong), answered by BenchSem
+    lock       lock() and unlock() of a free mutex
+    contended  lock() of benchMutex while BenchMtx holds it, until BenchMtx
+               unlocks it and blocks again
+    sleep      sleep(0) (gives up the processor, see svcSleep())
+    malloc     malloc_from_heap_wrapper(BENCH_BLOCK_SIZE)
+    free       free_to_heap_wrapper() of that block
+
+    The caller runs at BENCH_PRIORITY for the duration, only Important and
+    the interrupts can preempt it and they land in the maximum and the
+    upper percentiles. Under the round robin scheduler every ready task
+    runs in between, use the priority scheduler.
+
+    The peers created by initBench() take three task slots and 1.5 KiB of
+    stack, so they are only built with BENCH. They stay blocked outside of
+    a benchmark:
+    BenchSem  (priority 2) waits on benchPing and posts benchPong
+    BenchMtx  (priority 2) waits on benchHold, then locks benchMutex, posts
+              benchPong and yields, and unlocks when it runs again
+    BenchYld  (BENCH_PRIORITY) waits on benchSwitch, yields BENCH_YIELDS
+              times then posts benchPong
+*/
+#define BENCH_SAMPLES 128
+#define BENCH_WARMUP 4
+#define BENCH_YIELDS (BENCH_WARMUP + BENCH_SAMPLES + BENCH_WARMUP)
+#define BENCH_BLOCK_SIZE 512
+#define BENCH_PRIORITY 1
+#define BENCH_PEER_PRIORITY 2
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+bool initBench(void);
+void runBenchmarks(_fn caller, const char name[]);
+
+#endif
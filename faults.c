@@ -18,6 +18,7 @@
 #include "CortexM4Registers.h"
 #include "shell_auxiliary.h"
 #include "kernel.h"
+#include "ktrace.h"
 
 //-----------------------------------------------------------------------------
 // Globals
@@ -38,6 +39,8 @@ void mpuFaultIsr(void)
     uint32_t *psp = getPSP();
     uint32_t pc = getPC();
 
+    traceFault(KTRACE_FAULT_MPU);
+
     putsUart0("MMU fault in PID = 0x");
     itoa((uint32_t)getPID(), str, 16);
     putsUart0(str);
@@ -129,6 +132,8 @@ void hardFaultIsr(void)
     char str[32];
     uint32_t *psp = (uint32_t *)getPSP();
 
+    traceFault(KTRACE_FAULT_HARD);
+
     putsUart0("Hard fault in PID = 0x");
     itoa((uint32_t)getPID(), str, 16);
     putsUart0(str);
@@ -198,6 +203,8 @@ void hardFaultIsr(void)
 // REQUIRED: code this function
 void busFaultIsr(void)
 {
+    traceFault(KTRACE_FAULT_BUS);
+
     if (foo)
     {
         causeBusFault();
@@ -223,6 +230,7 @@ void usageFaultIsr(void)
 {
     char str[32];
 
+    traceFault(KTRACE_FAULT_USAGE);
     putsUart0("Usage fault in PID = 0x");
     itoa((uint32_t)getPID(), str, 16);
     putsUart0(str);
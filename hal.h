@@ -0,0 +1,69 @@
+// Hardware abstraction layer
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target uC:       TM4C123GH6PM
+// System Clock:    40 MHz
+
+#ifndef HAL_H_
+#define HAL_H_
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+    The few places where the kernel depends on the Cortex-M4 itself rather
+    than on memory mapped registers.
+
+    The target build uses the instructions directly. Building with HOST
+    defined (host/Makefile) runs the same kernel as a Linux process, the
+    hooks are then implemented by host/hal_host.c:
+    - PendSV is a plain function called when a host "exception" returns
+    - task stacks are host stacks, the kernel's stack window only holds
+      the initial frame
+    - read only task arguments live in the executable's read only segments
+      instead of flash
+*/
+
+// SysTick source, the reload value is derived from it for a 1 ms tick.
+// QEMU_MPS2 (qemu/Makefile) runs on mps2-an386, whose SYSCLK is fixed
+#ifdef QEMU_MPS2
+#define SYSTEM_CLOCK_HZ 25000000
+#else
+#define SYSTEM_CLOCK_HZ 40000000
+#endif
+
+// DWT cycle counter, a core register block tm4c123gh6pm.h does not define.
+// NVIC_DBG_INT_R is the DEMCR, TRCENA powers the DWT. The host port models
+// the counter in host/periph_host.c, QEMU does not implement it
+#define DWT_CTRL_R          (*((volatile uint32_t *)0xE0001000))
+#define DWT_CYCCNT_R        (*((volatile uint32_t *)0xE0001004))
+#define DWT_CTRL_CYCCNTENA  0x00000001  // Enable CYCCNT
+#define NVIC_DBG_INT_TRCENA 0x01000000  // Trace enable (DWT, ITM)
+
+#ifdef HOST
+
+#define PENDSV_ENTRY
+#define SAVE_EXC_RETURN()
+#define HAL_IS_TASK_STACK(task, address, size) hostIsTaskStack(task, address, size)
+#define HAL_IS_READ_ONLY(address, size) hostIsReadOnly(address, size)
+
+bool hostIsTaskStack(uint8_t task, const void *address, uint32_t size);
+bool hostIsReadOnly(const void *address, uint32_t size);
+
+#else
+
+#define PENDSV_ENTRY __attribute__((naked))
+#define SAVE_EXC_RETURN() __asm(" mov r12, lr")
+#define HAL_IS_TASK_STACK(task, address, size) false
+#define HAL_IS_READ_ONLY(address, size) ((uint32_t)(address) < FLASH_END && (size) <= FLASH_END - (uint32_t)(address))
+
+#endif
+
+#endif
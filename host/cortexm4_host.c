@@ -0,0 +1,114 @@
+// Host port CortexM4Registers.s replacements
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target:          Linux process (x86-64), built by host/Makefile
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "CortexM4Registers.h"
+
+// Shared by the host port (hal_host.c) and the simulator (sim.c). The PSP
+// is only a token there, it identifies the frame of the running task
+uint32_t hostPsp;
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+void setASP()
+{
+}
+
+void setTMPL(void)
+{
+}
+
+void setPSP(uint32_t value)
+{
+    hostPsp = value;
+}
+
+uint32_t *getPSP(void)
+{
+    return (uint32_t *)(uintptr_t)hostPsp;
+}
+
+uint32_t getMSP(void)
+{
+    return 0;
+}
+
+uint32_t getPC(void)
+{
+    return 0;
+}
+
+uint32_t getxPSR(void)
+{
+    return 0;
+}
+
+// R4-R11 are saved by swapcontext()
+void pushR4R11(void)
+{
+}
+
+void popR4R11(void)
+{
+}
+
+// Fault generation is target only
+void enableBusFault(void)
+{
+}
+
+void causeBusFault(void)
+{
+}
+
+void enableUsageFault(void)
+{
+}
+
+void setDiv0Trap(void)
+{
+}
+
+void causeUsageFault(void)
+{
+}
+
+void enableMPUHandler(void)
+{
+}
+
+void causeMemFault(void)
+{
+}
+
+void *popFreeListAtomic(void **head)
+{
+    void *block = __atomic_load_n(head, __ATOMIC_ACQUIRE);
+
+    while (block != NULL && !__atomic_compare_exchange_n(head, &block, *(void **)block, true,
+                                                          __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+        ;
+    return block;
+}
+
+void pushFreeListAtomic(void **head, void *block)
+{
+    void *next = __atomic_load_n(head, __ATOMIC_RELAXED);
+
+    do
+        *(void **)block = next;
+    while (!__atomic_compare_exchange_n(head, &next, block, true, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+}
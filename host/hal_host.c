@@ -0,0 +1,322 @@
+// Host port hardware abstraction layer
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target:          Linux process (x86-64), built by host/Makefile
+// System Clock:    SysTick emulated with SIGALRM
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#define _GNU_SOURCE
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#define sleep unistdSleep // kernel.h declares the service call sleep()
+#include <unistd.h>
+#undef sleep
+#include <signal.h>
+#include <ucontext.h>
+#include <link.h>
+#include <sys/time.h>
+#include "tm4c123gh6pm.h"
+#include "CortexM4Registers.h"
+#include "kernel.h"
+#include "syscalls.h"
+#include "faults.h"
+#include "hal.h"
+#include "periph_host.h"
+
+/*
+    The kernel runs unmodified on top of these pieces:
+
+    - Memory and peripherals: periph_host.c maps and models the target's
+      address ranges. The executable is linked without PIE so function
+      addresses (the PIDs) fit in 32 bits
+    - Service calls: the generated wrappers jump to hostSvCall() with the
+      number as a fifth argument. It masks the tick, builds an SVC_FRAME,
+      runs svcDispatch() and then the pending PendSV, like the exception
+      return on the target
+    - Context switch: each task runs on its own host stack with a ucontext.
+      The kernel still saves and restores a PSP per task, the value only
+      identifies which context to resume. A PSP pointing at the frame built
+      by initThreadStack() starts the task's function from the stacked PC
+      with the stacked R0 as its argument
+    - SysTick: the SysTick model raises SIGALRM, the handler calls
+      systickIsr() and switches tasks from inside the handler when PendSV
+      was requested
+    - Privilege: tasks run unprivileged, service calls, the tick and faults
+      run privileged so the MPU model only checks task accesses
+    - Task stacks are host stacks and the kernel's data is in the
+      executable, the MPU only covers the heap
+*/
+#define HOST_STACK_SIZE 131072 // Room for the nested signal frames of the trapped registers
+#define HOST_MAX_READ_ONLY_SEGMENTS 4
+#define HOST_FRAME_R0 9  // Stacked R0 in the frame built by initThreadStack()
+#define HOST_FRAME_PC 15 // Stacked PC
+#define HOST_FAULT_FRAME_SIZE 8
+
+typedef struct _HOST_CONTEXT
+{
+    ucontext_t context;
+    uint32_t psp; // PSP handed to the kernel the last time the task was switched in
+} HOST_CONTEXT;
+
+typedef struct _HOST_RANGE
+{
+    uintptr_t start;
+    uintptr_t end;
+} HOST_RANGE;
+
+extern uint8_t taskCurrent;
+extern uint32_t hostPsp; // PSP of the running task, see cortexm4_host.c
+
+// In .bss so task stack addresses also fit the 32 bit service call frame
+static uint8_t hostStacks[MAX_TASKS][HOST_STACK_SIZE] __attribute__((aligned(16)));
+static HOST_CONTEXT hostContexts[MAX_TASKS];
+static ucontext_t hostMainContext;
+static int8_t hostRunning = -1; // Task whose context is live, -1 before startRtos()
+static HOST_RANGE hostReadOnly[HOST_MAX_READ_ONLY_SEGMENTS];
+static uint8_t hostReadOnlyCount = 0;
+static char **hostArgv;
+
+static void hostSysTick(int signal);
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+/**
+ * @brief
+ * Records the read only loadable segments of the executable, they play the
+ * part of flash for isTaskReadable()
+ */
+static int hostFindReadOnly(struct dl_phdr_info *info, size_t size, void *data)
+{
+    uint16_t i;
+
+    // The first object is the executable
+    for (i = 0; i < info->dlpi_phnum && hostReadOnlyCount < HOST_MAX_READ_ONLY_SEGMENTS; i++)
+    {
+        const ElfW(Phdr) *phdr = &info->dlpi_phdr[i];
+
+        if (phdr->p_type == PT_LOAD && !(phdr->p_flags & PF_W))
+        {
+            hostReadOnly[hostReadOnlyCount].start = info->dlpi_addr + phdr->p_vaddr;
+            hostReadOnly[hostReadOnlyCount].end = info->dlpi_addr + phdr->p_vaddr + phdr->p_memsz;
+            hostReadOnlyCount++;
+        }
+    }
+    return 1;
+}
+
+/**
+ * @brief
+ * Finds the read only segments and installs the SysTick handler before main() runs
+ */
+__attribute__((constructor)) static void hostInit(int argc, char **argv)
+{
+    struct sigaction action = {0};
+
+    hostArgv = argv;
+
+    dl_iterate_phdr(hostFindReadOnly, NULL);
+
+    action.sa_handler = hostSysTick;
+    action.sa_flags = SA_RESTART;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGALRM, &action, NULL);
+}
+
+/**
+ * @brief
+ * Restarts the process, the host equivalent of SYSRESETREQ
+ */
+static void hostReset(void)
+{
+    fflush(NULL);
+    execv("/proc/self/exe", hostArgv);
+    _exit(1);
+}
+
+/**
+ * @brief
+ * First code run on a task's host stack, calls the function stacked as PC
+ * with the stacked R0, like the exception return on the target
+ */
+static void hostTaskEntry(uint32_t pc, uint32_t r0)
+{
+    sigset_t tick;
+
+    // The tick stays masked until the switch to this stack is complete
+    sigemptyset(&tick);
+    sigaddset(&tick, SIGALRM);
+    hostSetPrivileged(false);
+    sigprocmask(SIG_UNBLOCK, &tick, NULL);
+
+    ((_fn)(uintptr_t)pc)(r0);
+
+    // Returning from a task function faults on the target
+    fprintf(stderr, "host: task function 0x%08x returned\n", pc);
+    exit(1);
+}
+
+/**
+ * @brief
+ * Switches to the context of taskCurrent if the kernel selected another
+ * task, or started the selected one over with a new frame
+ */
+static void hostSwitch(void)
+{
+    int8_t from = hostRunning;
+    uint8_t to = taskCurrent;
+    HOST_CONTEXT *next = &hostContexts[to];
+    ucontext_t *save = from < 0 ? &hostMainContext : &hostContexts[from].context;
+
+    if (hostPsp == next->psp)
+    {
+        if (from == to)
+            return;
+        hostRunning = to;
+        swapcontext(save, &next->context);
+        return;
+    }
+
+    // Frame from initThreadStack(), the hardware would pop it and leave the
+    // PSP at the top of the stack
+    uint32_t pc = ((uint32_t *)(uintptr_t)hostPsp)[HOST_FRAME_PC];
+    uint32_t r0 = ((uint32_t *)(uintptr_t)hostPsp)[HOST_FRAME_R0];
+    next->psp = hostPsp + 17 * sizeof(uint32_t);
+    hostPsp = next->psp;
+
+    getcontext(&next->context);
+    next->context.uc_stack.ss_sp = hostStacks[to];
+    next->context.uc_stack.ss_size = HOST_STACK_SIZE;
+    next->context.uc_link = NULL;
+    makecontext(&next->context, (void (*)(void))hostTaskEntry, 2, pc, r0);
+
+    hostRunning = to;
+    swapcontext(save, &next->context);
+}
+
+/**
+ * @brief
+ * Exception return: runs a pending PendSV, then resumes whatever task
+ * the kernel selected
+ */
+static void hostExceptionReturn(void)
+{
+    if (NVIC_APINT_R & NVIC_APINT_SYSRESETREQ)
+        hostReset();
+
+    if (NVIC_INT_CTRL_R & NVIC_INT_CTRL_PEND_SV)
+    {
+        NVIC_INT_CTRL_R &= ~NVIC_INT_CTRL_PEND_SV;
+        pendSvIsr();
+    }
+
+    if (hostRunning != taskCurrent || hostPsp != hostContexts[taskCurrent].psp)
+        hostSwitch();
+}
+
+/**
+ * @brief
+ * SIGALRM handler, the SysTick exception
+ */
+static void hostSysTick(int signal)
+{
+    bool privileged;
+
+    if (!hostSysTickExpired() || hostRunning < 0)
+        return;
+
+    privileged = hostSetPrivileged(true);
+    systickIsr();
+    hostExceptionReturn();
+    hostSetPrivileged(privileged);
+}
+
+/**
+ * @brief
+ * Entered from the service call wrappers with the tick masked for the
+ * duration, the same way the SVC exception preempts the task
+ *
+ * @return The handler's stacked R0
+ */
+uint64_t hostSvCall(uint64_t r0, uint64_t r1, uint64_t r2, uint64_t r3, uint64_t number)
+{
+    SVC_FRAME frame = {r0, r1, r2, r3, number, 0, 0, 0};
+    sigset_t tick, previous;
+    bool privileged;
+
+    sigemptyset(&tick);
+    sigaddset(&tick, SIGALRM);
+    sigprocmask(SIG_BLOCK, &tick, &previous);
+    privileged = hostSetPrivileged(true);
+
+    svcDispatch(&frame);
+    hostExceptionReturn();
+
+    hostSetPrivileged(privileged);
+    sigprocmask(SIG_SETMASK, &previous, NULL);
+    return frame.r0;
+}
+
+/**
+ * @brief
+ * Memory management fault taken by the running task. Stacks an exception
+ * frame from the task's registers on its (otherwise unused) target stack so
+ * mpuFaultIsr() can dump it, then runs the handler like the hardware would
+ */
+void hostMemManageFault(ucontext_t *context)
+{
+    greg_t *r = context->uc_mcontext.gregs;
+    uint32_t *frame = (uint32_t *)(uintptr_t)hostPsp - HOST_FAULT_FRAME_SIZE;
+
+    hostSetPrivileged(true);
+
+    frame[0] = r[REG_RDI]; // R0-R3: the first four argument registers
+    frame[1] = r[REG_RSI];
+    frame[2] = r[REG_RDX];
+    frame[3] = r[REG_RCX];
+    frame[4] = r[REG_R8];  // R12: the service call number register
+    frame[5] = 0;
+    frame[6] = r[REG_RIP];
+    frame[7] = 1 << 24;    // Thumb bit
+    hostPsp = (uint32_t)(uintptr_t)frame;
+
+    mpuFaultIsr();
+}
+
+/**
+ * @brief
+ * True if [address, address + size) is on the host stack of the task
+ */
+bool hostIsTaskStack(uint8_t task, const void *address, uint32_t size)
+{
+    uintptr_t start = (uintptr_t)hostStacks[task];
+    uintptr_t p = (uintptr_t)address;
+
+    return p >= start && p - start < HOST_STACK_SIZE && size <= HOST_STACK_SIZE - (p - start);
+}
+
+/**
+ * @brief
+ * True if [address, address + size) is in a read only segment of the executable
+ */
+bool hostIsReadOnly(const void *address, uint32_t size)
+{
+    uintptr_t p = (uintptr_t)address;
+    uint8_t i;
+
+    for (i = 0; i < hostReadOnlyCount; i++)
+    {
+        if (p >= hostReadOnly[i].start && p < hostReadOnly[i].end && size <= hostReadOnly[i].end - p)
+            return true;
+    }
+    return false;
+}
@@ -0,0 +1,617 @@
+// Allocator benchmark and aging harness
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target:          Linux process (x86-64), built by host/Makefile (make heapbench)
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#define _GNU_SOURCE
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <getopt.h>
+#include <sys/mman.h>
+#define sleep unistdSleep // kernel.h declares the service calls sleep() and wait()
+#define wait waitWait
+#include <unistd.h>
+#include <sys/wait.h>
+#undef sleep
+#undef wait
+#include "mm.h"
+#include "kstats.h"
+
+/*
+    Drives mm.c's mallocFromHeap(), freeToHeap() and reallocFromHeap()
+    directly, with no kernel around them, and measures:
+    - the time of every call, min/avg/p50/p99/max per operation
+    - the failure rate of the allocations
+    - fragmentation over time from readHeapMap(): bytes used and free, the
+      largest free run, the number of free runs and 100 - largest * 100 / free
+
+    Random mode (the default): each operation allocates with a probability
+    that keeps about -l blocks live, sizes log-uniform in -z min..max, and
+    otherwise frees a random live block.
+
+    Replay mode (-r file): the allocation trace of a target, captured with
+    the shell's heaptrace command in a build with HEAP_TRACE defined (see
+    mm.h). One operation per line, # starts a comment:
+
+        <op> <owner> <size> <address> <result>
+
+    op is m (malloc), f (free), r (realloc) or v (compaction move).
+    Addresses are the target's, each maps to the block the replay got in
+    its place, so the trace runs under any policy. A free of a block
+    allocated before the capture started is counted as unmatched and
+    skipped. The trace is replayed from an empty heap until -n operations
+    have run, each pass ends by freeing what is left (not timed).
+
+    Each policy runs in its own forked process, from a fresh heap. Times are
+    TSC cycles on x86 (ns elsewhere) of the host, less the cost of reading
+    the counter, so compare builds on the same machine.
+*/
+#define HB_DEFAULT_OPS 1000000
+#define HB_DEFAULT_LIVE 16
+#define HB_DEFAULT_MIN_SIZE 16
+#define HB_DEFAULT_MAX_SIZE 4096
+#define HB_DEFAULT_SAMPLES 10      // Fragmentation rows when -i is not given
+#define HB_MAX_LIVE NUM_SUBREGIONS // Every live block takes a subregion at least
+#define HB_HIST_BUCKETS 16384      // One per cycle, the last one collects the rest
+#define HB_MAX_LINE 256
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HB_NOW() __rdtsc()
+#define HB_UNIT "TSC cycles"
+#else
+static uint64_t hbNanoseconds(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+#define HB_NOW() hbNanoseconds()
+#define HB_UNIT "ns"
+#endif
+
+// Operations, as in the trace
+#define HB_MALLOC 0
+#define HB_FREE 1
+#define HB_REALLOC 2
+#define HB_MOVE 3
+#define HB_NUM_OPS 3 // Timed ones
+
+typedef struct _HB_STATS
+{
+    uint64_t count;
+    uint64_t failures;
+    uint64_t sum;
+    uint64_t min;
+    uint64_t max;
+    uint64_t histogram[HB_HIST_BUCKETS];
+} HB_STATS;
+
+typedef struct _HB_RECORD
+{
+    uint8_t op;
+    uint8_t owner;
+    uint32_t size;
+    uint32_t address;
+    uint32_t result;
+} HB_RECORD;
+
+typedef struct _HB_POLICY
+{
+    const char *name;
+    uint8_t policy;
+} HB_POLICY;
+
+static const HB_POLICY hbPolicies[] =
+    {
+        {"seg", ALLOC_SEGREGATED},
+        {"first", ALLOC_FIRST_FIT},
+        {"best", ALLOC_BEST_FIT}};
+
+static const char *const hbOpNames[HB_NUM_OPS] = {"malloc", "free", "realloc"};
+
+static HB_STATS hbStats[HB_NUM_OPS];
+static uint64_t hbOverhead;
+static uint64_t hbOps = HB_DEFAULT_OPS;
+static uint64_t hbInterval = 0;
+static uint32_t hbTarget = HB_DEFAULT_LIVE;
+static uint32_t hbMinSize = HB_DEFAULT_MIN_SIZE;
+static uint32_t hbMaxSize = HB_DEFAULT_MAX_SIZE;
+static uint64_t hbRng;
+
+// Interval statistics of the fragmentation rows
+static uint64_t hbDone = 0;
+static uint64_t hbIntervalAllocs = 0;
+static uint64_t hbIntervalFailures = 0;
+
+// Trace
+static HB_RECORD *hbTrace = NULL;
+static uint32_t hbTraceCount = 0;
+static uint32_t hbTraceDropped = 0;
+static uint64_t hbUnmatched = 0;
+
+// Live blocks: the random mode's list, the replay's target address map (by subregion bit)
+static void *hbLive[HB_MAX_LIVE];
+static uint32_t hbLiveCount = 0;
+static void *hbReplayed[NUM_SUBREGIONS];
+
+// The kernel statistics page mm.c points MPU region 7 at
+volatile KSTATS_PAGE kernelStats;
+
+//-----------------------------------------------------------------------------
+// Memory
+//-----------------------------------------------------------------------------
+
+/**
+ * @brief
+ * Maps plain memory where the heap is, reallocFromHeap() moves the data
+ * of the blocks it cannot grow in place
+ */
+__attribute__((constructor)) static void hbMapMemory(void)
+{
+    if (mmap((void *)0x20000000, 0x8000, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0) == MAP_FAILED)
+    {
+        perror("heapbench: mmap");
+        exit(1);
+    }
+}
+
+//-----------------------------------------------------------------------------
+// Measurements
+//-----------------------------------------------------------------------------
+
+// xorshift64*
+static uint64_t hbRandom(void)
+{
+    hbRng ^= hbRng >> 12;
+    hbRng ^= hbRng << 25;
+    hbRng ^= hbRng >> 27;
+    return hbRng * 0x2545F4914F6CDD1DULL;
+}
+
+/**
+ * @brief
+ * Cheapest of many back to back counter reads, taken off every sample
+ */
+static uint64_t hbMeasureOverhead(void)
+{
+    uint64_t best = UINT64_MAX, start, elapsed;
+    uint32_t i;
+
+    for (i = 0; i < 10000; i++)
+    {
+        start = HB_NOW();
+        elapsed = HB_NOW() - start;
+        if (elapsed < best)
+            best = elapsed;
+    }
+    return best;
+}
+
+static void hbRecord(uint8_t op, uint64_t start, uint64_t end, bool failed)
+{
+    HB_STATS *stats = &hbStats[op];
+    uint64_t elapsed = end - start > hbOverhead ? end - start - hbOverhead : 0;
+
+    if (stats->count == 0 || elapsed < stats->min)
+        stats->min = elapsed;
+    if (elapsed > stats->max)
+        stats->max = elapsed;
+    stats->count++;
+    stats->sum += elapsed;
+    stats->histogram[elapsed < HB_HIST_BUCKETS - 1 ? elapsed : HB_HIST_BUCKETS - 1]++;
+    if (failed)
+        stats->failures++;
+
+    if (op != HB_FREE)
+    {
+        hbIntervalAllocs++;
+        hbIntervalFailures += failed;
+    }
+    hbDone++;
+}
+
+static uint64_t hbPercentile(const HB_STATS *stats, uint32_t permille)
+{
+    uint64_t target = (stats->count * permille + 999) / 1000;
+    uint64_t seen = 0;
+    uint32_t i;
+
+    for (i = 0; i < HB_HIST_BUCKETS - 1; i++)
+    {
+        seen += stats->histogram[i];
+        if (seen >= target)
+            return i;
+    }
+    return stats->max;
+}
+
+/**
+ * @brief
+ * One row of the fragmentation table, every hbInterval operations
+ */
+static void hbSample(void)
+{
+    HEAP_MAP map;
+    uint32_t runs = 0;
+    uint8_t i;
+
+    if (hbDone % hbInterval != 0)
+        return;
+
+    readHeapMap(&map);
+    for (i = 0; i < FREE_RUN_BUCKETS; i++)
+        runs += map.freeRuns[i];
+    printf("%10llu %6u %8u %8u %8u %6u %6.2f %6.2f\n", (unsigned long long)hbDone, hbLiveCount,
+           HEAP_SIZE - map.freeBytes, map.freeBytes, map.largestFreeRun, runs,
+           map.freeBytes ? 100.0 - map.largestFreeRun * 100.0 / map.freeBytes : 0.0,
+           hbIntervalAllocs ? hbIntervalFailures * 100.0 / hbIntervalAllocs : 0.0);
+    hbIntervalAllocs = 0;
+    hbIntervalFailures = 0;
+}
+
+static void hbReport(void)
+{
+    uint8_t op;
+
+    printf("%-8s %10s %7s %8s %9s %8s %8s %8s\n", "Op", "Count", "Fail%", "Min", "Avg", "p50", "p99", "Max");
+    for (op = 0; op < HB_NUM_OPS; op++)
+    {
+        const HB_STATS *stats = &hbStats[op];
+
+        if (stats->count == 0)
+            continue;
+        printf("%-8s %10llu %7.2f %8llu %9.1f %8llu %8llu %8llu\n", hbOpNames[op], (unsigned long long)stats->count,
+               stats->failures * 100.0 / stats->count, (unsigned long long)stats->min, (double)stats->sum / stats->count,
+               (unsigned long long)hbPercentile(stats, 500), (unsigned long long)hbPercentile(stats, 990),
+               (unsigned long long)stats->max);
+    }
+    printf("%s per operation, less %llu of timing overhead\n\n", HB_UNIT, (unsigned long long)hbOverhead);
+}
+
+//-----------------------------------------------------------------------------
+// Random mode
+//-----------------------------------------------------------------------------
+
+static uint32_t hbRandomSize(void)
+{
+    double u = (hbRandom() >> 11) * (1.0 / 9007199254740992.0);
+
+    return (uint32_t)exp(log(hbMinSize) + u * (log(hbMaxSize + 1.0) - log(hbMinSize)));
+}
+
+static void hbRunRandom(void)
+{
+    uint64_t start, end;
+    uint32_t size, i;
+    void *block;
+
+    while (hbDone < hbOps)
+    {
+        // Allocate with probability 1 - live / (2 * target), so the live count settles at the target
+        if (hbLiveCount == 0 || (hbLiveCount < HB_MAX_LIVE && hbRandom() % (2 * hbTarget) >= hbLiveCount))
+        {
+            size = hbRandomSize();
+            start = HB_NOW();
+            block = mallocFromHeap(size, hbLiveCount % MAX_TASKS);
+            end = HB_NOW();
+            hbRecord(HB_MALLOC, start, end, block == NULL);
+            if (block != NULL)
+                hbLive[hbLiveCount++] = block;
+        }
+        else
+        {
+            i = hbRandom() % hbLiveCount;
+            block = hbLive[i];
+            hbLive[i] = hbLive[--hbLiveCount];
+            start = HB_NOW();
+            freeToHeap(block);
+            end = HB_NOW();
+            hbRecord(HB_FREE, start, end, false);
+        }
+        hbSample();
+    }
+}
+
+//-----------------------------------------------------------------------------
+// Replay mode
+//-----------------------------------------------------------------------------
+
+static void hbLoad(const char *path)
+{
+    FILE *file = fopen(path, "r");
+    char line[HB_MAX_LINE];
+    uint32_t number = 0, capacity = 0;
+    unsigned owner;
+    unsigned long size, dropped;
+    long address, result;
+    char op;
+
+    if (file == NULL)
+    {
+        perror(path);
+        exit(1);
+    }
+    while (fgets(line, sizeof(line), file) != NULL)
+    {
+        HB_RECORD *record;
+
+        number++;
+        if (sscanf(line, "# dropped %lu", &dropped) == 1)
+            hbTraceDropped += dropped;
+        if (line[0] == '#' || strspn(line, " \t\r\n") == strlen(line))
+            continue;
+        if (sscanf(line, " %c %u %lu %li %li", &op, &owner, &size, &address, &result) != 5 ||
+            strchr("mfrv", op) == NULL)
+        {
+            fprintf(stderr, "heapbench: %s:%u: not a trace record\n", path, number);
+            exit(1);
+        }
+        if (hbTraceCount == capacity)
+        {
+            capacity = capacity ? capacity * 2 : 1024;
+            hbTrace = realloc(hbTrace, capacity * sizeof(HB_RECORD));
+            if (hbTrace == NULL)
+            {
+                fprintf(stderr, "heapbench: out of memory\n");
+                exit(1);
+            }
+        }
+        record = &hbTrace[hbTraceCount++];
+        record->op = strchr("mfrv", op) - "mfrv";
+        record->owner = owner;
+        record->size = size;
+        record->address = address;
+        record->result = result;
+    }
+    fclose(file);
+    if (hbTraceCount == 0)
+    {
+        fprintf(stderr, "heapbench: %s: no records\n", path);
+        exit(1);
+    }
+}
+
+/**
+ * @brief
+ * Slot of a target address in hbReplayed, NULL if it is not a heap address
+ */
+static void **hbSlot(uint32_t address)
+{
+    int8_t bit = getSubregionBit(address);
+
+    return bit < 0 ? NULL : &hbReplayed[bit];
+}
+
+static void hbReplay(const HB_RECORD *record)
+{
+    void **from = hbSlot(record->address);
+    void **to = hbSlot(record->result);
+    uint64_t start, end;
+    void *block;
+
+    // A block still mapped where the target allocates lost its free to a dropped record
+    if (record->op != HB_MOVE && to != NULL && to != from && *to != NULL)
+    {
+        freeToHeap(*to);
+        *to = NULL;
+    }
+
+    switch (record->op)
+    {
+        case HB_MALLOC:
+            start = HB_NOW();
+            block = mallocFromHeap(record->size, record->owner);
+            end = HB_NOW();
+            hbRecord(HB_MALLOC, start, end, block == NULL);
+            if (to != NULL)
+                *to = block;
+            else if (block != NULL)
+                freeToHeap(block); // Failed on the target, nothing in the trace frees it
+            break;
+
+        case HB_FREE:
+            if (from == NULL || *from == NULL)
+            {
+                hbUnmatched++;
+                break;
+            }
+            start = HB_NOW();
+            freeToHeap(*from);
+            end = HB_NOW();
+            hbRecord(HB_FREE, start, end, false);
+            *from = NULL;
+            break;
+
+        case HB_REALLOC:
+            if (from == NULL || *from == NULL)
+            {
+                hbUnmatched++;
+                break;
+            }
+            start = HB_NOW();
+            block = reallocFromHeap(*from, record->size);
+            end = HB_NOW();
+            hbRecord(HB_REALLOC, start, end, block == NULL);
+            // Where the target has the block now, the old place if it failed there
+            if (block == NULL)
+                block = *from;
+            *from = NULL;
+            *(to != NULL ? to : from) = block;
+            break;
+
+        case HB_MOVE:
+            if (from != NULL && to != NULL)
+            {
+                block = *from;
+                *from = NULL;
+                *to = block;
+            }
+            break;
+    }
+}
+
+static uint32_t hbCountReplayed(void)
+{
+    uint32_t live = 0;
+    uint8_t i;
+
+    for (i = 0; i < NUM_SUBREGIONS; i++)
+        live += hbReplayed[i] != NULL;
+    return live;
+}
+
+static void hbRunReplay(void)
+{
+    uint64_t passes = 0;
+    uint32_t i;
+
+    while (hbDone < hbOps)
+    {
+        for (i = 0; i < hbTraceCount && hbDone < hbOps; i++)
+        {
+            uint64_t before = hbDone;
+
+            hbReplay(&hbTrace[i]);
+            if (hbDone != before)
+            {
+                hbLiveCount = hbCountReplayed();
+                hbSample();
+            }
+        }
+        passes++;
+
+        // The next pass starts from an empty heap
+        for (i = 0; i < NUM_SUBREGIONS; i++)
+        {
+            if (hbReplayed[i] != NULL)
+                freeToHeap(hbReplayed[i]);
+            hbReplayed[i] = NULL;
+        }
+        hbLiveCount = 0;
+        if (hbDone == 0)
+            break; // Nothing in the trace is timed
+    }
+    printf("%llu passes, %llu unmatched frees and reallocs, %u records dropped on the target\n",
+           (unsigned long long)passes, (unsigned long long)hbUnmatched, hbTraceDropped);
+}
+
+//-----------------------------------------------------------------------------
+// Main
+//-----------------------------------------------------------------------------
+
+static void hbRun(const HB_POLICY *policy, const char *trace, uint64_t seed)
+{
+    setAllocationPolicy(policy->policy);
+    hbRng = (seed + 1) * 0x9E3779B97F4A7C15ULL;
+    hbOverhead = hbMeasureOverhead();
+
+    if (trace != NULL)
+        printf("policy %s: %llu operations, replay of %s (%u records)\n", policy->name,
+               (unsigned long long)hbOps, trace, hbTraceCount);
+    else
+        printf("policy %s: %llu operations, sizes %u..%u B, %u live blocks, seed %llu\n", policy->name,
+               (unsigned long long)hbOps, hbMinSize, hbMaxSize, hbTarget, (unsigned long long)seed);
+    printf("%10s %6s %8s %8s %8s %6s %6s %6s\n", "Ops", "Live", "Used B", "Free B", "Largest", "Runs", "Frag%", "Fail%");
+
+    if (trace != NULL)
+        hbRunReplay();
+    else
+        hbRunRandom();
+    hbReport();
+}
+
+static void hbUsage(void)
+{
+    fprintf(stderr, "usage: heapbench [-p seg,first,best] [-n ops] [-i interval] [-s seed] [-l live] [-z min..max] [-r trace]\n");
+    exit(2);
+}
+
+int main(int argc, char *argv[])
+{
+    char policies[64] = "seg,first,best";
+    const char *trace = NULL;
+    uint64_t seed = 1;
+    char *name;
+    int option;
+    bool ok = true;
+
+    while ((option = getopt(argc, argv, "p:n:i:s:l:z:r:")) != -1)
+    {
+        switch (option)
+        {
+            case 'p':
+                snprintf(policies, sizeof(policies), "%s", optarg);
+                break;
+            case 'n':
+                hbOps = strtoull(optarg, NULL, 10);
+                break;
+            case 'i':
+                hbInterval = strtoull(optarg, NULL, 10);
+                break;
+            case 's':
+                seed = strtoull(optarg, NULL, 10);
+                break;
+            case 'l':
+                hbTarget = strtoul(optarg, NULL, 10);
+                break;
+            case 'z':
+                if (sscanf(optarg, "%u..%u", &hbMinSize, &hbMaxSize) != 2)
+                    hbUsage();
+                break;
+            case 'r':
+                trace = optarg;
+                break;
+            default:
+                hbUsage();
+        }
+    }
+    if (optind != argc || hbOps == 0 || hbTarget == 0 || hbTarget > HB_MAX_LIVE || hbMinSize == 0 || hbMinSize > hbMaxSize)
+        hbUsage();
+    if (hbInterval == 0)
+        hbInterval = hbOps / HB_DEFAULT_SAMPLES ? hbOps / HB_DEFAULT_SAMPLES : 1;
+    if (trace != NULL)
+        hbLoad(trace);
+
+    for (name = strtok(policies, ","); name != NULL; name = strtok(NULL, ","))
+    {
+        const HB_POLICY *policy = NULL;
+        uint8_t i;
+        int status;
+        pid_t child;
+
+        for (i = 0; i < sizeof(hbPolicies) / sizeof(hbPolicies[0]); i++)
+        {
+            if (strcmp(name, hbPolicies[i].name) == 0)
+                policy = &hbPolicies[i];
+        }
+        if (policy == NULL)
+            hbUsage();
+
+        // The allocator's statics start fresh for every policy
+        fflush(stdout);
+        child = fork();
+        if (child == 0)
+        {
+            hbRun(policy, trace, seed);
+            fflush(stdout);
+            _exit(0);
+        }
+        if (child < 0 || waitpid(child, &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+            ok = false;
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,686 @@
+// Host port peripheral model
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target:          Linux process (x86-64), built by host/Makefile
+// UART Interface:
+//   HOST_UART=pty (default) UART0 is a pseudo terminal, its name is printed on stderr
+//   HOST_UART=stdio         UART0 is stdin/stdout
+//   HOST_UART=tcp:<port>    UART0 is a TCP connection, startup waits for a client
+// Pushbuttons:
+//   HOST_BUTTONS=<tick>:<mask>,...  readPbs() returns mask from that SysTick on
+// Memory Protection Unit (MPU):
+//   Enforced on task accesses to SRAM once NVIC_MPU_CTRL_R enables it,
+//   HOST_MPU=on enables it at reset as if enableMPU() had been called
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#define _GNU_SOURCE
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <time.h>
+#include <ucontext.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include "tm4c123gh6pm.h"
+#include "hal.h"
+#include "periph_host.h"
+
+#if !defined(__x86_64__)
+#error "host peripheral model: single stepping is only implemented for x86-64"
+#endif
+
+/*
+    The target's address ranges are mapped at their real addresses, so the
+    drivers and the kernel access the registers exactly as on the board.
+    Plain registers (GPIO, system control...) are ordinary memory.
+
+    Registers with side effects live on pages mapped without access. The
+    faulting access runs the device's before() hook (e.g. load the UART
+    receive FIFO into DR), opens the page and single steps the instruction
+    with the trap flag, then the after() hook sees the result (e.g. the byte
+    written to DR) and the page is closed again. The tick is masked during
+    the step so no other task can use the open page.
+
+    - UART0: DR/FR backed by a pseudo terminal, stdin/stdout or a socket
+    - SysTick: RELOAD/CTRL arm an interval timer (SIGALRM), CURRENT counts
+      down from the time since the last tick, COUNT is set on every tick
+    - DWT: CYCCNT counts HOST_CPU_HZ cycles of the monotonic clock while
+      TRCENA (DEMCR) and CYCCNTENA are set
+    - Bitband: every peripheral bitband alias word reads and writes its bit,
+      so setPinValue()/getPinValue() and the DATA registers agree
+    - GPIO: HOST_BUTTONS drives the pushbutton pins read by readPbs()
+    - MPU: RNR/RBAR/RASR are kept per region. While a task runs with the MPU
+      enabled SRAM is closed and every access is checked against the
+      regions, a denied access sets MMFSR/MMFAR and raises the memory
+      management fault on the task (mpuFaultIsr())
+*/
+#define HOST_PAGE_SIZE 4096
+#define HOST_MAX_STEPS 4        // Trapped pages one instruction may touch
+#define HOST_EFLAGS_TF 0x100    // x86 trap flag, single step
+#define HOST_PF_WRITE 0x2       // Page fault error code: write access
+#define HOST_CPU_HZ 40000000
+#define HOST_MPU_REGIONS 8
+#define HOST_UART_FIFO_SIZE 16
+#define HOST_MAX_BUTTON_EVENTS 32
+#define BITBAND_ALIAS_BASE 0x42000000
+#define BITBAND_BASE 0x40000000
+
+typedef struct _HOST_DEVICE
+{
+    uintptr_t base;
+    size_t size;
+    volatile uint8_t *view; // Always accessible mapping of the registers, NULL if not needed
+    void (*before)(uintptr_t address, bool isWrite, ucontext_t *context);
+    void (*after)(uintptr_t address, bool isWrite);
+} HOST_DEVICE;
+
+typedef struct _HOST_STEP
+{
+    HOST_DEVICE *device;
+    uintptr_t address;
+    bool isWrite;
+} HOST_STEP;
+
+typedef struct _HOST_BUTTON_EVENT
+{
+    uint32_t tick;
+    uint8_t pressed;
+} HOST_BUTTON_EVENT;
+
+// Register of a device through its view, e.g. HOST_REG(hostPpb, NVIC_ST_CTRL_R)
+#define HOST_REG(device, reg) (*(volatile uint32_t *)((device).view + ((uintptr_t)&(reg) - (device).base)))
+
+static void hostSramBefore(uintptr_t address, bool isWrite, ucontext_t *context);
+static void hostUartBefore(uintptr_t address, bool isWrite, ucontext_t *context);
+static void hostUartAfter(uintptr_t address, bool isWrite);
+static void hostPpbBefore(uintptr_t address, bool isWrite, ucontext_t *context);
+static void hostPpbAfter(uintptr_t address, bool isWrite);
+static void hostBitbandBefore(uintptr_t address, bool isWrite, ucontext_t *context);
+static void hostBitbandAfter(uintptr_t address, bool isWrite);
+static void hostDwtBefore(uintptr_t address, bool isWrite, ucontext_t *context);
+static void hostDwtAfter(uintptr_t address, bool isWrite);
+
+//-----------------------------------------------------------------------------
+// Global variables
+//-----------------------------------------------------------------------------
+
+static HOST_DEVICE hostSram = {0x20000000, 0x00008000, NULL, hostSramBefore, NULL};
+static HOST_DEVICE hostUart = {0x4000C000, HOST_PAGE_SIZE, NULL, hostUartBefore, hostUartAfter};
+static HOST_DEVICE hostPpb = {0xE000E000, HOST_PAGE_SIZE, NULL, hostPpbBefore, hostPpbAfter};
+static HOST_DEVICE hostBitband = {BITBAND_ALIAS_BASE, 0x02000000, NULL, hostBitbandBefore, hostBitbandAfter};
+static HOST_DEVICE hostDwt = {0xE0001000, HOST_PAGE_SIZE, NULL, hostDwtBefore, hostDwtAfter};
+static HOST_DEVICE *const hostDevices[] = {&hostSram, &hostUart, &hostPpb, &hostBitband, &hostDwt};
+
+static HOST_STEP hostSteps[HOST_MAX_STEPS];
+static uint8_t hostStepCount = 0;
+static bool hostStepTickMasked;
+
+static bool hostPrivileged = true;
+static bool hostSramClosed = false;
+
+static uint32_t hostMpuCtrl = 0;
+static uint32_t hostMpuNumber = 0;
+static uint32_t hostMpuBase[HOST_MPU_REGIONS];
+static uint32_t hostMpuAttr[HOST_MPU_REGIONS];
+
+static struct timespec hostLastTick;
+static uint32_t hostTicks = 0;
+
+static struct timespec hostCycleTime; // CYCCNT was hostCycleCount at this time
+static uint32_t hostCycleCount = 0;
+
+static int hostUartRx = -1;
+static int hostUartTx = -1;
+static uint8_t hostUartFifo[HOST_UART_FIFO_SIZE];
+static uint8_t hostUartHead = 0;
+static uint8_t hostUartCount = 0;
+
+static HOST_BUTTON_EVENT hostButtons[HOST_MAX_BUTTON_EVENTS];
+static uint8_t hostButtonCount = 0;
+static uint8_t hostButtonNext = 0;
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+/**
+ * @brief
+ * Maps size bytes at base, exits if the address range is taken
+ */
+static void hostMap(uintptr_t base, size_t size, int prot, int flags, int fd)
+{
+    void *p = mmap((void *)base, size, prot, flags | MAP_FIXED_NOREPLACE | MAP_NORESERVE, fd, 0);
+
+    if (p != (void *)base)
+    {
+        fprintf(stderr, "host: cannot map 0x%08lx, is the executable built without PIE?\n", (unsigned long)base);
+        exit(1);
+    }
+}
+
+/**
+ * @brief
+ * Maps a trapped device page and a second, always accessible view of it
+ */
+static void hostMapDevice(HOST_DEVICE *device)
+{
+    int fd = memfd_create("register page", 0);
+
+    if (fd < 0 || ftruncate(fd, device->size) != 0)
+    {
+        perror("host: register page");
+        exit(1);
+    }
+    hostMap(device->base, device->size, PROT_NONE, MAP_SHARED, fd);
+    device->view = mmap(NULL, device->size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+}
+
+/**
+ * @brief
+ * Opens or closes the page holding address
+ */
+static void hostSetPageAccess(uintptr_t address, bool open)
+{
+    mprotect((void *)(address & ~(uintptr_t)(HOST_PAGE_SIZE - 1)), HOST_PAGE_SIZE, open ? PROT_READ | PROT_WRITE : PROT_NONE);
+}
+
+static HOST_DEVICE *hostFindDevice(uintptr_t address)
+{
+    uint8_t i;
+
+    for (i = 0; i < sizeof(hostDevices) / sizeof(hostDevices[0]); i++)
+    {
+        if (address - hostDevices[i]->base < hostDevices[i]->size)
+            return hostDevices[i];
+    }
+    return NULL;
+}
+
+/**
+ * @brief
+ * SIGSEGV handler, an access to a trapped page. Runs the device's before()
+ * hook and single steps the instruction with the page open
+ */
+static void hostAccessTrap(int signal, siginfo_t *info, void *context)
+{
+    ucontext_t *uc = context;
+    uintptr_t address = (uintptr_t)info->si_addr;
+    bool isWrite = (uc->uc_mcontext.gregs[REG_ERR] & HOST_PF_WRITE) != 0;
+    HOST_DEVICE *device = hostFindDevice(address);
+
+    if (device == NULL || hostStepCount == HOST_MAX_STEPS)
+    {
+        // A real segmentation fault, the access is retried and kills the process
+        struct sigaction action = {0};
+        action.sa_handler = SIG_DFL;
+        sigaction(SIGSEGV, &action, NULL);
+        return;
+    }
+
+    hostSetPageAccess(address, true);
+    if (device->before != NULL)
+        device->before(address, isWrite, uc);
+
+    if (hostStepCount == 0)
+    {
+        hostStepTickMasked = sigismember(&uc->uc_sigmask, SIGALRM);
+        sigaddset(&uc->uc_sigmask, SIGALRM);
+    }
+    hostSteps[hostStepCount].device = device;
+    hostSteps[hostStepCount].address = address;
+    hostSteps[hostStepCount].isWrite = isWrite;
+    hostStepCount++;
+
+    uc->uc_mcontext.gregs[REG_EFL] |= HOST_EFLAGS_TF;
+}
+
+/**
+ * @brief
+ * SIGTRAP handler, the stepped instruction has completed
+ */
+static void hostStepTrap(int signal, siginfo_t *info, void *context)
+{
+    ucontext_t *uc = context;
+
+    uc->uc_mcontext.gregs[REG_EFL] &= ~HOST_EFLAGS_TF;
+
+    while (hostStepCount > 0)
+    {
+        HOST_STEP *step = &hostSteps[--hostStepCount];
+
+        if (step->device->after != NULL)
+            step->device->after(step->address, step->isWrite);
+        hostSetPageAccess(step->address, step->device == &hostSram ? !hostSramClosed : false);
+    }
+
+    if (!hostStepTickMasked)
+        sigdelset(&uc->uc_sigmask, SIGALRM);
+}
+
+//-----------------------------------------------------------------------------
+// MPU
+//-----------------------------------------------------------------------------
+
+/**
+ * @brief
+ * True if an unprivileged access is allowed by the MPU regions.
+ * The highest numbered region that matches decides, a disabled subregion
+ * does not match. No match is a fault (no background region for tasks)
+ */
+static bool hostMpuAllows(uintptr_t address, bool isWrite)
+{
+    int8_t region;
+
+    if (!(hostMpuCtrl & NVIC_MPU_CTRL_ENABLE))
+        return true;
+
+    for (region = HOST_MPU_REGIONS - 1; region >= 0; region--)
+    {
+        uint32_t attr = hostMpuAttr[region];
+        uint8_t sizeField = (attr & NVIC_MPU_ATTR_SIZE_M) >> 1;
+        uint64_t size = 1ull << (sizeField + 1);
+        uint64_t offset = (uint64_t)address - (hostMpuBase[region] & ~(size - 1));
+        uint8_t ap = (attr & NVIC_MPU_ATTR_AP_M) >> 24;
+
+        if (!(attr & NVIC_MPU_ATTR_ENABLE) || offset >= size)
+            continue;
+        if (sizeField >= 7 && (attr >> (8 + offset / (size / 8))) & 1)
+            continue;
+
+        return ap == 3 || (!isWrite && (ap == 2 || ap == 6 || ap == 7));
+    }
+    return false;
+}
+
+/**
+ * @brief
+ * Closes SRAM while a task runs with the MPU enabled
+ *
+ * @return The previous privilege, to be restored on the way out
+ */
+bool hostSetPrivileged(bool privileged)
+{
+    bool previous = hostPrivileged;
+    bool close = !privileged && (hostMpuCtrl & NVIC_MPU_CTRL_ENABLE);
+
+    hostPrivileged = privileged;
+    if (close != hostSramClosed)
+    {
+        mprotect((void *)hostSram.base, hostSram.size, close ? PROT_NONE : PROT_READ | PROT_WRITE);
+        hostSramClosed = close;
+    }
+    return previous;
+}
+
+static void hostSramBefore(uintptr_t address, bool isWrite, ucontext_t *context)
+{
+    if (!hostMpuAllows(address, isWrite))
+    {
+        HOST_REG(hostPpb, NVIC_FAULT_STAT_R) |= NVIC_FAULT_STAT_DERR | NVIC_FAULT_STAT_MMARV;
+        HOST_REG(hostPpb, NVIC_MM_ADDR_R) = address;
+        hostMemManageFault(context);
+    }
+}
+
+//-----------------------------------------------------------------------------
+// System control space: SysTick and MPU
+//-----------------------------------------------------------------------------
+
+/**
+ * @brief
+ * Starts, changes or stops the tick timer to follow CTRL and RELOAD
+ */
+static void hostSysTickArm(void)
+{
+    struct itimerval timer = {{0, 0}, {0, 0}};
+    uint32_t us = ((uint64_t)(HOST_REG(hostPpb, NVIC_ST_RELOAD_R) + 1) * 1000000) / HOST_CPU_HZ;
+
+    if (HOST_REG(hostPpb, NVIC_ST_CTRL_R) & NVIC_ST_CTRL_ENABLE)
+    {
+        if (us == 0)
+            us = 1;
+        timer.it_interval.tv_sec = us / 1000000;
+        timer.it_interval.tv_usec = us % 1000000;
+        timer.it_value = timer.it_interval;
+        clock_gettime(CLOCK_MONOTONIC, &hostLastTick);
+    }
+    setitimer(ITIMER_REAL, &timer, NULL);
+}
+
+static void hostPpbBefore(uintptr_t address, bool isWrite, ucontext_t *context)
+{
+    if (address == (uintptr_t)&NVIC_ST_CURRENT_R)
+    {
+        struct timespec now;
+        uint32_t reload = HOST_REG(hostPpb, NVIC_ST_RELOAD_R);
+        uint64_t cycles;
+
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        cycles = ((uint64_t)(now.tv_sec - hostLastTick.tv_sec) * 1000000000 + now.tv_nsec - hostLastTick.tv_nsec) / (1000000000 / HOST_CPU_HZ);
+        HOST_REG(hostPpb, NVIC_ST_CURRENT_R) = reload - (uint32_t)(cycles % ((uint64_t)reload + 1));
+    }
+    else if (address >= (uintptr_t)&NVIC_MPU_TYPE_R && address <= (uintptr_t)&NVIC_MPU_ATTR_R)
+    {
+        HOST_REG(hostPpb, NVIC_MPU_TYPE_R) = HOST_MPU_REGIONS << 8;
+        HOST_REG(hostPpb, NVIC_MPU_CTRL_R) = hostMpuCtrl;
+        HOST_REG(hostPpb, NVIC_MPU_NUMBER_R) = hostMpuNumber;
+        HOST_REG(hostPpb, NVIC_MPU_BASE_R) = hostMpuBase[hostMpuNumber] | hostMpuNumber;
+        HOST_REG(hostPpb, NVIC_MPU_ATTR_R) = hostMpuAttr[hostMpuNumber];
+    }
+}
+
+static void hostPpbAfter(uintptr_t address, bool isWrite)
+{
+    uint32_t value = *(volatile uint32_t *)(hostPpb.view + ((address & ~3) - hostPpb.base));
+
+    if (address == (uintptr_t)&NVIC_ST_CTRL_R)
+    {
+        if (isWrite)
+            hostSysTickArm();
+        else
+            HOST_REG(hostPpb, NVIC_ST_CTRL_R) &= ~NVIC_ST_CTRL_COUNT;
+    }
+    else if (address == (uintptr_t)&NVIC_ST_RELOAD_R && isWrite)
+        hostSysTickArm();
+    else if (address == (uintptr_t)&NVIC_ST_CURRENT_R && isWrite)
+    {
+        HOST_REG(hostPpb, NVIC_ST_CURRENT_R) = 0;
+        HOST_REG(hostPpb, NVIC_ST_CTRL_R) &= ~NVIC_ST_CTRL_COUNT;
+        clock_gettime(CLOCK_MONOTONIC, &hostLastTick);
+    }
+    else if (!isWrite)
+        return;
+    else if (address == (uintptr_t)&NVIC_MPU_CTRL_R)
+        hostMpuCtrl = value;
+    else if (address == (uintptr_t)&NVIC_MPU_NUMBER_R)
+        hostMpuNumber = value % HOST_MPU_REGIONS;
+    else if (address == (uintptr_t)&NVIC_MPU_BASE_R)
+    {
+        if (value & NVIC_MPU_BASE_VALID)
+            hostMpuNumber = value % HOST_MPU_REGIONS;
+        hostMpuBase[hostMpuNumber] = value & ~0x1F;
+    }
+    else if (address == (uintptr_t)&NVIC_MPU_ATTR_R)
+        hostMpuAttr[hostMpuNumber] = value;
+}
+
+//-----------------------------------------------------------------------------
+// DWT cycle counter
+//-----------------------------------------------------------------------------
+
+/**
+ * @brief
+ * CYCCNT now, it only advances while the counter is enabled
+ */
+static uint32_t hostCycles(void)
+{
+    struct timespec now;
+    uint64_t ns;
+
+    if (!(HOST_REG(hostPpb, NVIC_DBG_INT_R) & NVIC_DBG_INT_TRCENA) || !(HOST_REG(hostDwt, DWT_CTRL_R) & DWT_CTRL_CYCCNTENA))
+        return hostCycleCount;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    ns = (uint64_t)(now.tv_sec - hostCycleTime.tv_sec) * 1000000000 + now.tv_nsec - hostCycleTime.tv_nsec;
+    return hostCycleCount + (uint32_t)(ns / (1000000000 / HOST_CPU_HZ));
+}
+
+static void hostDwtBefore(uintptr_t address, bool isWrite, ucontext_t *context)
+{
+    if (isWrite)
+    {
+        // Count up to the write with the old settings
+        hostCycleCount = hostCycles();
+        clock_gettime(CLOCK_MONOTONIC, &hostCycleTime);
+    }
+    else if (address == (uintptr_t)&DWT_CYCCNT_R)
+        HOST_REG(hostDwt, DWT_CYCCNT_R) = hostCycles();
+}
+
+static void hostDwtAfter(uintptr_t address, bool isWrite)
+{
+    if (isWrite && address == (uintptr_t)&DWT_CYCCNT_R)
+        hostCycleCount = HOST_REG(hostDwt, DWT_CYCCNT_R);
+}
+
+//-----------------------------------------------------------------------------
+// GPIO and bitband
+//-----------------------------------------------------------------------------
+
+/**
+ * @brief
+ * Drives the pushbutton pins, a pressed button pulls its pin low.
+ * Bit n of pressed is bit n of readPbs()
+ */
+static void hostSetButtons(uint8_t pressed)
+{
+    GPIO_PORTC_DATA_R = (GPIO_PORTC_DATA_R & ~0xF0) | (~pressed << 4 & 0xF0);
+    GPIO_PORTD_DATA_R = (GPIO_PORTD_DATA_R & ~0xC0) | (~pressed << 2 & 0xC0);
+}
+
+/**
+ * @brief
+ * Parses HOST_BUTTONS, e.g. "500:32,520:0" presses the button 32 at tick 500
+ * and releases it 20 ticks later
+ */
+static void hostLoadButtons(const char *script)
+{
+    char *end;
+
+    while (script != NULL && *script != '\0' && hostButtonCount < HOST_MAX_BUTTON_EVENTS)
+    {
+        hostButtons[hostButtonCount].tick = strtoul(script, &end, 0);
+        if (*end != ':')
+            break;
+        hostButtons[hostButtonCount].pressed = strtoul(end + 1, &end, 0);
+        hostButtonCount++;
+        script = *end == ',' ? end + 1 : NULL;
+    }
+}
+
+static volatile uint8_t *hostBitbandTarget(uintptr_t address, uint8_t *bit)
+{
+    uint32_t offset = (address & ~3) - BITBAND_ALIAS_BASE;
+
+    *bit = (offset >> 2) & 7;
+    return (volatile uint8_t *)(uintptr_t)(BITBAND_BASE + (offset >> 5));
+}
+
+static void hostBitbandBefore(uintptr_t address, bool isWrite, ucontext_t *context)
+{
+    uint8_t bit;
+    volatile uint8_t *target = hostBitbandTarget(address, &bit);
+
+    *(volatile uint32_t *)(address & ~3) = (*target >> bit) & 1;
+}
+
+static void hostBitbandAfter(uintptr_t address, bool isWrite)
+{
+    uint8_t bit;
+    volatile uint8_t *target = hostBitbandTarget(address, &bit);
+
+    if (!isWrite)
+        return;
+    if (*(volatile uint32_t *)(address & ~3) & 1)
+        *target |= 1 << bit;
+    else
+        *target &= ~(1 << bit);
+}
+
+//-----------------------------------------------------------------------------
+// UART0
+//-----------------------------------------------------------------------------
+
+static void hostUartOpenPty(void)
+{
+    int pty = posix_openpt(O_RDWR | O_NOCTTY);
+
+    if (pty < 0 || grantpt(pty) != 0 || unlockpt(pty) != 0)
+    {
+        perror("host: UART0 pseudo terminal");
+        exit(1);
+    }
+    fprintf(stderr, "host: UART0 on %s\n", ptsname(pty));
+    hostUartRx = pty;
+    hostUartTx = pty;
+}
+
+static void hostUartOpenTcp(uint16_t port)
+{
+    struct sockaddr_in address = {0};
+    int listener = socket(AF_INET, SOCK_STREAM, 0);
+    int one = 1;
+
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    if (listener < 0 || bind(listener, (struct sockaddr *)&address, sizeof(address)) != 0 || listen(listener, 1) != 0)
+    {
+        perror("host: UART0 socket");
+        exit(1);
+    }
+    fprintf(stderr, "host: UART0 waiting on 127.0.0.1:%u\n", port);
+    hostUartRx = accept(listener, NULL, NULL);
+    hostUartTx = hostUartRx;
+    close(listener);
+}
+
+/**
+ * @brief
+ * Moves what the backend has received into the receive FIFO
+ */
+static void hostUartReceive(void)
+{
+    struct pollfd fd = {hostUartRx, POLLIN, 0};
+    uint8_t c;
+
+    while (hostUartRx >= 0 && hostUartCount < HOST_UART_FIFO_SIZE && poll(&fd, 1, 0) == 1)
+    {
+        if (read(hostUartRx, &c, 1) != 1)
+        {
+            // End of input, the line stays idle
+            hostUartRx = -1;
+            break;
+        }
+        hostUartFifo[(hostUartHead + hostUartCount++) % HOST_UART_FIFO_SIZE] = c;
+    }
+}
+
+static void hostUartBefore(uintptr_t address, bool isWrite, ucontext_t *context)
+{
+    hostUartReceive();
+
+    if (address == (uintptr_t)&UART0_FR_R)
+        HOST_REG(hostUart, UART0_FR_R) = UART_FR_TXFE | (hostUartCount == 0 ? UART_FR_RXFE : 0) |
+                                         (hostUartCount == HOST_UART_FIFO_SIZE ? UART_FR_RXFF : 0);
+    else if (address == (uintptr_t)&UART0_DR_R && !isWrite)
+        HOST_REG(hostUart, UART0_DR_R) = hostUartCount > 0 ? hostUartFifo[hostUartHead] : 0;
+}
+
+static void hostUartAfter(uintptr_t address, bool isWrite)
+{
+    if (address != (uintptr_t)&UART0_DR_R)
+        return;
+
+    if (isWrite)
+    {
+        uint8_t c = HOST_REG(hostUart, UART0_DR_R);
+        if (write(hostUartTx, &c, 1) < 0)
+            hostUartTx = -1;
+    }
+    else if (hostUartCount > 0)
+    {
+        hostUartHead = (hostUartHead + 1) % HOST_UART_FIFO_SIZE;
+        hostUartCount--;
+    }
+}
+
+//-----------------------------------------------------------------------------
+// SysTick
+//-----------------------------------------------------------------------------
+
+/**
+ * @brief
+ * Called on every timer expiry, advances the pushbutton script
+ *
+ * @return True if the SysTick exception is enabled
+ */
+bool hostSysTickExpired(void)
+{
+    uint32_t ctrl;
+
+    clock_gettime(CLOCK_MONOTONIC, &hostLastTick);
+    hostTicks++;
+    HOST_REG(hostPpb, NVIC_ST_CTRL_R) |= NVIC_ST_CTRL_COUNT;
+
+    while (hostButtonNext < hostButtonCount && hostButtons[hostButtonNext].tick <= hostTicks)
+        hostSetButtons(hostButtons[hostButtonNext++].pressed);
+
+    ctrl = HOST_REG(hostPpb, NVIC_ST_CTRL_R);
+    return (ctrl & NVIC_ST_CTRL_ENABLE) && (ctrl & NVIC_ST_CTRL_INTEN);
+}
+
+//-----------------------------------------------------------------------------
+// Reset
+//-----------------------------------------------------------------------------
+
+/**
+ * @brief
+ * Maps the target's memory before main() runs, every register and the heap
+ * start out zeroed like after a reset with all pushbuttons released
+ */
+__attribute__((constructor)) static void hostPeripheralsInit(void)
+{
+    const char *uart = getenv("HOST_UART");
+    const char *mpu = getenv("HOST_MPU");
+    struct sigaction action = {0};
+
+    hostMap(hostSram.base, hostSram.size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1);
+    hostMap(0x40000000, 0x00100000, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1);
+    munmap((void *)hostUart.base, hostUart.size);
+    hostMapDevice(&hostUart);
+    hostMapDevice(&hostPpb);
+    hostMapDevice(&hostDwt);
+    hostMap(hostBitband.base, hostBitband.size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1);
+
+    action.sa_sigaction = hostAccessTrap;
+    action.sa_flags = SA_SIGINFO | SA_NODEFER;
+    sigemptyset(&action.sa_mask);
+    sigaddset(&action.sa_mask, SIGALRM);
+    sigaction(SIGSEGV, &action, NULL);
+    action.sa_sigaction = hostStepTrap;
+    sigaction(SIGTRAP, &action, NULL);
+
+    hostSetButtons(0);
+    hostLoadButtons(getenv("HOST_BUTTONS"));
+
+    if (mpu != NULL && strcmp(mpu, "on") == 0)
+        hostMpuCtrl = NVIC_MPU_CTRL_PRIVDEFEN | NVIC_MPU_CTRL_ENABLE;
+
+    if (uart != NULL && strcmp(uart, "stdio") == 0)
+    {
+        hostUartRx = STDIN_FILENO;
+        hostUartTx = STDOUT_FILENO;
+    }
+    else if (uart != NULL && strncmp(uart, "tcp:", 4) == 0)
+        hostUartOpenTcp(atoi(uart + 4));
+    else
+        hostUartOpenPty();
+}
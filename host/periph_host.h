@@ -0,0 +1,30 @@
+// Host port peripheral model
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target:          Linux process (x86-64), built by host/Makefile
+
+#ifndef PERIPH_HOST_H_
+#define PERIPH_HOST_H_
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <ucontext.h>
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+bool hostSetPrivileged(bool privileged);
+bool hostSysTickExpired(void);
+
+// Provided by hal_host.c, the exception entry for a denied task access
+void hostMemManageFault(ucontext_t *context);
+
+#endif
@@ -0,0 +1,899 @@
+// Discrete-event scheduling simulator
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target:          Linux process (x86-64), built by host/Makefile (make sim)
+// System Clock:    simulated, 1 ms SysTick
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#define _GNU_SOURCE
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+#include <getopt.h>
+#include <sys/mman.h>
+#define sleep unistdSleep // kernel.h declares the service calls sleep() and wait()
+#define wait waitWait
+#include <unistd.h>
+#include <sys/wait.h>
+#undef sleep
+#undef wait
+#include "tm4c123gh6pm.h"
+#include "kernel.h"
+#include "kstats.h"
+#include "syscalls.h"
+#include "uart0.h"
+#include "hal.h"
+
+/*
+    Drives the kernel's own rtosScheduler(), systickIsr(), pendSvIsr() and
+    service call handlers with a declarative workload in simulated time.
+    Nothing runs on a task stack: each task is a list of actions, compute
+    time is only accounted and the actions that are service calls go
+    through svcDispatch() like the SVC exception would. Each scheduling
+    mode runs in its own forked process, from a fresh kernel.
+
+    Workload file, one directive per line, # starts a comment:
+
+        mutex <m>
+        semaphore <s> <count>
+        task <name> <priority> [period=<ms>] [deadline=<ms>] [stack=<bytes>] : <actions>
+
+    Actions are separated by ';' and repeat forever:
+
+        run <us>            compute for a fixed time
+        run <min>..<max>    uniformly distributed
+        run exp:<mean>      exponentially distributed
+        sleep <ms>, yield, lock <m>, unlock <m>, wait <s>, post <s>
+        [<actions>]*<n>     the bracketed actions n times
+
+    <m> and <s> are indices or the names from kernel.h (resource, flashReq...).
+    With period= the list is one job, released every period ms from time 0,
+    the task sleeps until the next release when it finishes early. Response
+    time is measured from release to the end of the list, a miss is a
+    response longer than the deadline (the period by default).
+
+    For every task the report gives the CPU share, response times, the time
+    spent blocked on mutexes and semaphores and the latency from becoming
+    ready (end of a sleep or block) to running. One task must always be
+    ready, as in rtos.c (Idle), so at least one task may only run and yield.
+*/
+#define SIM_TICK_US 1000
+#define SIM_MAX_ACTIONS 65536
+#define SIM_MAX_LINE 1024
+#define SIM_HIST_BUCKETS 1024
+#define SIM_HIST_PER_DEADLINE 256 // Histogram covers 4 deadlines
+#define SIM_DEFAULT_STACK 1024
+#define SIM_DEFAULT_TICKS 1000000
+#define SIM_DEFAULT_SVC_COST 2
+
+typedef enum _SIM_ACTION_TYPE
+{
+    SIM_RUN,
+    SIM_SLEEP,
+    SIM_YIELD,
+    SIM_LOCK,
+    SIM_UNLOCK,
+    SIM_WAIT,
+    SIM_POST,
+    SIM_UNTIL_RELEASE // End of a periodic job
+} SIM_ACTION_TYPE;
+
+typedef enum _SIM_DISTRIBUTION
+{
+    SIM_FIXED,
+    SIM_UNIFORM,
+    SIM_EXPONENTIAL
+} SIM_DISTRIBUTION;
+
+typedef struct _SIM_ACTION
+{
+    uint8_t type;
+    uint8_t distribution;
+    uint32_t a; // Time in us, ms or the mutex or semaphore
+    uint32_t b; // Upper bound of a uniform distribution
+} SIM_ACTION;
+
+typedef struct _SIM_TASK
+{
+    char name[16];
+    uint8_t priority;
+    uint32_t stack;
+    uint64_t period;   // us, 0 if the task is not periodic
+    uint64_t deadline; // us
+    SIM_ACTION *actions;
+    uint32_t actionCount;
+
+    // Run state
+    uint32_t next;              // Index of the next action
+    uint64_t remaining;         // us left of the current run, or of the service call entry
+    const SIM_ACTION *pending;  // Service call issued once remaining reaches 0
+    uint64_t rng;
+    uint64_t release;           // Release of the current job
+    uint8_t state;              // Last state seen in the statistics page
+    uint64_t stateSince;
+    bool readyPending;          // Became ready and has not run since
+
+    // Statistics
+    uint64_t cpuTime;
+    uint64_t jobs;
+    uint64_t misses;
+    uint64_t responseSum;
+    uint64_t responseMax;
+    uint64_t bucketWidth;
+    uint64_t histogram[SIM_HIST_BUCKETS];
+    uint64_t latencySum;
+    uint64_t latencyCount;
+    uint64_t latencyMax;
+    uint64_t blocked;
+    uint64_t blockedMax;
+} SIM_TASK;
+
+typedef struct _SIM_MODE
+{
+    const char *name;
+    bool priorityScheduler;
+    bool preemption;
+} SIM_MODE;
+
+typedef struct _SIM_NAME
+{
+    const char *name;
+    uint8_t index;
+} SIM_NAME;
+
+extern uint8_t taskCurrent;
+
+static const SIM_MODE simModes[] =
+    {
+        {"prio", true, true},
+        {"rr", false, true},
+        {"prio-coop", true, false},
+        {"rr-coop", false, false}};
+
+// Names from kernel.h
+static const SIM_NAME simMutexNames[] = {{"resource", resource}};
+static const SIM_NAME simSemaphoreNames[] = {{"keyPressed", keyPressed}, {"keyReleased", keyReleased}, {"flashReq", flashReq}};
+
+static SIM_TASK simTasks[MAX_TASKS];
+static uint8_t simTaskCount = 0;
+static bool simMutexes[MAX_MUTEXES];
+static int16_t simSemaphores[MAX_SEMAPHORES]; // Initial count, -1 if not declared
+static uint8_t simPids[MAX_TASKS];            // Distinct addresses for the task PIDs
+static uint64_t simNow = 0;
+static uint64_t simNextTick = SIM_TICK_US;
+static uint64_t simSwitches = 0;
+static uint32_t simSvcCost = SIM_DEFAULT_SVC_COST;
+static const char *simFile;
+static uint32_t simLine;
+
+//-----------------------------------------------------------------------------
+// Memory
+//-----------------------------------------------------------------------------
+
+/**
+ * @brief
+ * Maps plain memory where the kernel expects SRAM and the private
+ * peripheral bus (DWT to SCS). Nothing is trapped, the registers are only storage
+ */
+__attribute__((constructor)) static void simMapMemory(void)
+{
+    if (mmap((void *)0x20000000, 0x8000, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0) == MAP_FAILED ||
+        mmap((void *)0xE0001000, 0xE000, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0) == MAP_FAILED)
+    {
+        perror("sim: mmap");
+        exit(1);
+    }
+}
+
+//-----------------------------------------------------------------------------
+// Workload
+//-----------------------------------------------------------------------------
+
+static void simError(const char *message, const char *detail)
+{
+    fprintf(stderr, "sim: %s:%u: %s%s%s\n", simFile, simLine, message, detail ? ": " : "", detail ? detail : "");
+    exit(1);
+}
+
+static uint32_t simNumber(const char *str)
+{
+    char *end;
+    unsigned long value = strtoul(str, &end, 10);
+
+    if (end == str || *end != '\0' || value > UINT32_MAX)
+        simError("bad number", str);
+    return value;
+}
+
+static uint8_t simIndex(const char *str, const SIM_NAME names[], uint8_t count, uint8_t limit)
+{
+    uint8_t i;
+    uint32_t index;
+
+    for (i = 0; i < count; i++)
+    {
+        if (strcmp(str, names[i].name) == 0)
+            return names[i].index;
+    }
+    index = simNumber(str);
+    if (index >= limit)
+        simError("index out of range", str);
+    return index;
+}
+
+static SIM_ACTION *simAddAction(SIM_TASK *task)
+{
+    if (task->actionCount == SIM_MAX_ACTIONS)
+        simError("too many actions", task->name);
+    if ((task->actionCount & (task->actionCount - 1)) == 0)
+    {
+        task->actions = realloc(task->actions, (task->actionCount ? task->actionCount * 2 : 1) * sizeof(SIM_ACTION));
+        if (task->actions == NULL)
+            simError("out of memory", NULL);
+    }
+    return memset(&task->actions[task->actionCount++], 0, sizeof(SIM_ACTION));
+}
+
+static void simParseAction(SIM_TASK *task, char *word)
+{
+    char *verb = strtok(word, " \t");
+    char *argument = strtok(NULL, " \t");
+    SIM_ACTION *action;
+    char *dots;
+
+    if (verb == NULL)
+        return;
+    if (strtok(NULL, " \t") != NULL)
+        simError("extra argument", verb);
+    if ((strcmp(verb, "yield") == 0) != (argument == NULL))
+        simError("wrong number of arguments", verb);
+
+    action = simAddAction(task);
+    if (strcmp(verb, "run") == 0)
+    {
+        action->type = SIM_RUN;
+        if (strncmp(argument, "exp:", 4) == 0)
+        {
+            action->distribution = SIM_EXPONENTIAL;
+            action->a = simNumber(argument + 4);
+        }
+        else if ((dots = strstr(argument, "..")) != NULL)
+        {
+            *dots = '\0';
+            action->distribution = SIM_UNIFORM;
+            action->a = simNumber(argument);
+            action->b = simNumber(dots + 2);
+            if (action->b < action->a)
+                simError("empty range", verb);
+        }
+        else
+            action->a = simNumber(argument);
+        if (action->a == 0 && action->b == 0)
+            simError("run time must not be 0", task->name);
+    }
+    else if (strcmp(verb, "sleep") == 0)
+    {
+        action->type = SIM_SLEEP;
+        action->a = simNumber(argument);
+        if (action->a == 0)
+            simError("sleep 0 never wakes up", task->name);
+    }
+    else if (strcmp(verb, "yield") == 0)
+        action->type = SIM_YIELD;
+    else if (strcmp(verb, "lock") == 0 || strcmp(verb, "unlock") == 0)
+    {
+        action->type = verb[0] == 'l' ? SIM_LOCK : SIM_UNLOCK;
+        action->a = simIndex(argument, simMutexNames, sizeof(simMutexNames) / sizeof(simMutexNames[0]), MAX_MUTEXES);
+        if (!simMutexes[action->a])
+            simError("mutex not declared", argument);
+    }
+    else if (strcmp(verb, "wait") == 0 || strcmp(verb, "post") == 0)
+    {
+        action->type = verb[0] == 'w' ? SIM_WAIT : SIM_POST;
+        action->a = simIndex(argument, simSemaphoreNames, sizeof(simSemaphoreNames) / sizeof(simSemaphoreNames[0]), MAX_SEMAPHORES);
+        if (simSemaphores[action->a] < 0)
+            simError("semaphore not declared", argument);
+    }
+    else
+        simError("unknown action", verb);
+}
+
+/**
+ * @brief
+ * Parses actions up to the end of the line or a closing bracket
+ */
+static char *simParseActions(SIM_TASK *task, char *p)
+{
+    char *end;
+    uint32_t start, count, i;
+
+    while (true)
+    {
+        while (isspace((unsigned char)*p) || *p == ';')
+            p++;
+        if (*p == '\0' || *p == ']')
+            return p;
+
+        if (*p == '[')
+        {
+            start = task->actionCount;
+            p = simParseActions(task, p + 1);
+            if (*p != ']' || p[1] != '*')
+                simError("expected ]*<n>", task->name);
+            count = strtoul(p + 2, &end, 10);
+            if (end == p + 2 || count == 0)
+                simError("bad repeat count", task->name);
+            p = end;
+
+            // Unrolled, every iteration is part of the list
+            uint32_t length = task->actionCount - start;
+            while (--count > 0)
+            {
+                for (i = 0; i < length; i++)
+                    *simAddAction(task) = task->actions[start + i];
+            }
+            continue;
+        }
+
+        end = p + strcspn(p, ";[]");
+        char saved = *end;
+        *end = '\0';
+        simParseAction(task, p);
+        *end = saved;
+        p = end;
+    }
+}
+
+static void simParseTask(char *line)
+{
+    char *actions = strchr(line, ':');
+    char *name, *priority, *option;
+    SIM_TASK *task;
+
+    if (actions == NULL)
+        simError("expected ':' before the actions", NULL);
+    *actions++ = '\0';
+
+    strtok(line, " \t");
+    name = strtok(NULL, " \t");
+    priority = strtok(NULL, " \t");
+    if (name == NULL || priority == NULL)
+        simError("expected task <name> <priority>", NULL);
+    if (simTaskCount == MAX_TASKS)
+        simError("more than MAX_TASKS tasks", name);
+    if (strlen(name) >= sizeof(task->name))
+        simError("name too long", name);
+
+    task = &simTasks[simTaskCount++];
+    strcpy(task->name, name);
+    task->priority = simNumber(priority);
+    task->stack = SIM_DEFAULT_STACK;
+    if (task->priority > 15)
+        simError("priority out of range", priority);
+
+    while ((option = strtok(NULL, " \t")) != NULL)
+    {
+        char *value = strchr(option, '=');
+
+        if (value == NULL)
+            simError("expected <option>=<value>", option);
+        *value++ = '\0';
+        if (strcmp(option, "period") == 0)
+            task->period = (uint64_t)simNumber(value) * SIM_TICK_US;
+        else if (strcmp(option, "deadline") == 0)
+            task->deadline = (uint64_t)simNumber(value) * SIM_TICK_US;
+        else if (strcmp(option, "stack") == 0)
+            task->stack = simNumber(value);
+        else
+            simError("unknown option", option);
+    }
+    if (task->deadline == 0)
+        task->deadline = task->period;
+    if (task->deadline != 0 && task->period == 0)
+        simError("deadline= needs period=", name);
+
+    if (*simParseActions(task, actions) != '\0')
+        simError("unbalanced ]", name);
+    if (task->actionCount == 0)
+        simError("no actions", name);
+}
+
+static void simLoad(const char *path)
+{
+    char line[SIM_MAX_LINE];
+    FILE *file = fopen(path, "r");
+    uint8_t i;
+    uint32_t j;
+    bool alwaysReady = false;
+
+    simFile = path;
+    if (file == NULL)
+    {
+        perror(path);
+        exit(1);
+    }
+    for (i = 0; i < MAX_SEMAPHORES; i++)
+        simSemaphores[i] = -1;
+
+    while (fgets(line, sizeof(line), file) != NULL)
+    {
+        char *comment = strchr(line, '#');
+        char *keyword;
+
+        simLine++;
+        if (comment != NULL)
+            *comment = '\0';
+        line[strcspn(line, "\r\n")] = '\0';
+
+        if (strncmp(line, "task", 4) == 0 && isspace((unsigned char)line[4]))
+        {
+            simParseTask(line);
+            continue;
+        }
+
+        keyword = strtok(line, " \t");
+        if (keyword == NULL)
+            continue;
+        if (strcmp(keyword, "mutex") == 0)
+        {
+            char *index = strtok(NULL, " \t");
+
+            if (index == NULL)
+                simError("expected mutex <m>", NULL);
+            simMutexes[simIndex(index, simMutexNames, sizeof(simMutexNames) / sizeof(simMutexNames[0]), MAX_MUTEXES)] = true;
+        }
+        else if (strcmp(keyword, "semaphore") == 0)
+        {
+            char *index = strtok(NULL, " \t");
+            char *count = strtok(NULL, " \t");
+
+            if (index == NULL || count == NULL)
+                simError("expected semaphore <s> <count>", NULL);
+            simSemaphores[simIndex(index, simSemaphoreNames, sizeof(simSemaphoreNames) / sizeof(simSemaphoreNames[0]), MAX_SEMAPHORES)] = simNumber(count) & 0xFF;
+        }
+        else
+            simError("unknown directive", keyword);
+    }
+    fclose(file);
+
+    // Both schedulers spin forever when nothing is ready
+    for (i = 0; i < simTaskCount && !alwaysReady; i++)
+    {
+        alwaysReady = simTasks[i].period == 0;
+        for (j = 0; j < simTasks[i].actionCount; j++)
+            alwaysReady &= simTasks[i].actions[j].type == SIM_RUN || simTasks[i].actions[j].type == SIM_YIELD;
+    }
+    if (!alwaysReady)
+    {
+        simLine = 0;
+        simError("no task that is always ready (only run and yield, no period)", NULL);
+    }
+}
+
+//-----------------------------------------------------------------------------
+// Simulation
+//-----------------------------------------------------------------------------
+
+// xorshift64*, one generator per task so the samples do not depend on the schedule
+static uint64_t simRandom(SIM_TASK *task)
+{
+    task->rng ^= task->rng >> 12;
+    task->rng ^= task->rng << 25;
+    task->rng ^= task->rng >> 27;
+    return task->rng * 0x2545F4914F6CDD1DULL;
+}
+
+static uint64_t simSample(SIM_TASK *task, const SIM_ACTION *action)
+{
+    uint64_t sample;
+
+    switch (action->distribution)
+    {
+        case SIM_UNIFORM:
+            sample = action->a + simRandom(task) % (action->b - action->a + 1);
+            break;
+        case SIM_EXPONENTIAL:
+        {
+            // Inverse transform of a uniform in (0, 1]
+            double u = ((simRandom(task) >> 11) + 1) * (1.0 / 9007199254740992.0);
+            sample = (uint64_t)(-log(u) * action->a + 0.5);
+            break;
+        }
+        default:
+            sample = action->a;
+    }
+    return sample ? sample : 1;
+}
+
+/**
+ * @brief
+ * Picks up the state changes made by the last kernel entry from the
+ * statistics page, and the task it dispatched
+ */
+static void simObserve(uint8_t previous)
+{
+    uint8_t i;
+
+    updateKernelStats();
+    for (i = 0; i < simTaskCount; i++)
+    {
+        SIM_TASK *task = &simTasks[i];
+        uint8_t state = kernelStats.stats.tasks[i].state;
+
+        if (state == task->state)
+            continue;
+
+        if (task->state == STATE_BLOCKED_MUTEX || task->state == STATE_BLOCKED_SEMAPHORE)
+        {
+            uint64_t blocked = simNow - task->stateSince;
+
+            task->blocked += blocked;
+            if (blocked > task->blockedMax)
+                task->blockedMax = blocked;
+        }
+        if (state == STATE_READY)
+            task->readyPending = true;
+
+        task->state = state;
+        task->stateSince = simNow;
+    }
+
+    if (taskCurrent != previous)
+        simSwitches++;
+
+    SIM_TASK *current = &simTasks[taskCurrent];
+    if (current->readyPending)
+    {
+        uint64_t latency = simNow - current->stateSince;
+
+        current->readyPending = false;
+        current->latencySum += latency;
+        current->latencyCount++;
+        if (latency > current->latencyMax)
+            current->latencyMax = latency;
+    }
+}
+
+/**
+ * @brief
+ * Exception return: runs a pending PendSV
+ */
+static void simExceptionReturn(uint8_t previous)
+{
+    if (NVIC_INT_CTRL_R & NVIC_INT_CTRL_PEND_SV)
+    {
+        NVIC_INT_CTRL_R &= ~NVIC_INT_CTRL_PEND_SV;
+        pendSvIsr();
+    }
+    simObserve(previous);
+}
+
+static void simServiceCall(uint32_t number, uint32_t r0)
+{
+    SVC_FRAME frame = {r0, 0, 0, 0, number, 0, 0, 0};
+    uint8_t previous = taskCurrent;
+
+    svcDispatch(&frame);
+    simExceptionReturn(previous);
+}
+
+static void simSystick(void)
+{
+    uint8_t previous = taskCurrent;
+
+    systickIsr();
+    simExceptionReturn(previous);
+}
+
+/**
+ * @brief
+ * Runs the service call of an action once its entry cost has elapsed
+ */
+static void simIssue(SIM_TASK *task, const SIM_ACTION *action)
+{
+    static const uint8_t numbers[] =
+        {
+            [SIM_SLEEP] = SVC_SLEEP,
+            [SIM_YIELD] = SVC_YIELD,
+            [SIM_LOCK] = SVC_LOCK,
+            [SIM_UNLOCK] = SVC_UNLOCK,
+            [SIM_WAIT] = SVC_WAIT,
+            [SIM_POST] = SVC_POST};
+    uint64_t lastTick = simNextTick - SIM_TICK_US;
+
+    if (action->type != SIM_UNTIL_RELEASE)
+        simServiceCall(numbers[action->type], action->a);
+    // Releases are on tick boundaries, sleep(n) wakes up on the n-th tick
+    else if (task->release > lastTick)
+        simServiceCall(SVC_SLEEP, (task->release - lastTick) / SIM_TICK_US);
+    else
+        simServiceCall(SVC_YIELD, 0); // Overrun, the next job is already released
+}
+
+/**
+ * @brief
+ * Records the response time of the job that just finished
+ */
+static void simJobDone(SIM_TASK *task)
+{
+    uint64_t response = simNow - task->release;
+    uint64_t bucket = response / task->bucketWidth;
+
+    task->jobs++;
+    task->responseSum += response;
+    if (response > task->responseMax)
+        task->responseMax = response;
+    if (response > task->deadline)
+        task->misses++;
+    task->histogram[bucket < SIM_HIST_BUCKETS ? bucket : SIM_HIST_BUCKETS - 1]++;
+
+    task->release += task->period;
+}
+
+/**
+ * @brief
+ * Starts the next action of the running task, zero simulated time
+ */
+static void simStep(SIM_TASK *task)
+{
+    static const SIM_ACTION untilRelease = {SIM_UNTIL_RELEASE, SIM_FIXED, 0, 0};
+    const SIM_ACTION *action;
+
+    if (task->next == task->actionCount)
+    {
+        task->next = 0;
+        if (task->period != 0)
+        {
+            simJobDone(task);
+            task->remaining = simSvcCost;
+            task->pending = &untilRelease;
+            return;
+        }
+    }
+
+    action = &task->actions[task->next++];
+    if (action->type == SIM_RUN)
+        task->remaining = simSample(task, action);
+    else
+    {
+        task->remaining = simSvcCost;
+        task->pending = action;
+    }
+}
+
+static uint64_t simPercentile(const SIM_TASK *task, uint32_t permille)
+{
+    uint64_t target = (task->jobs * permille + 999) / 1000;
+    uint64_t seen = 0;
+    uint32_t i;
+
+    for (i = 0; i < SIM_HIST_BUCKETS - 1; i++)
+    {
+        seen += task->histogram[i];
+        if (seen >= target)
+            return (i + 1) * task->bucketWidth < task->responseMax ? (i + 1) * task->bucketWidth : task->responseMax;
+    }
+    return task->responseMax;
+}
+
+static void simReport(const SIM_MODE *mode, uint64_t ticks)
+{
+    uint8_t i;
+
+    printf("mode %s: %llu ticks, %.3f s simulated, %llu context switches\n", mode->name,
+           (unsigned long long)ticks, simNow / 1e6, (unsigned long long)simSwitches);
+    printf("%-15s %3s %6s %8s %6s %10s %10s %10s %9s %9s %10s %9s\n", "Task", "Pri", "CPU%", "Jobs", "Miss",
+           "Resp avg", "Resp p99", "Resp max", "Lat avg", "Lat max", "Blocked", "Blk max");
+    for (i = 0; i < simTaskCount; i++)
+    {
+        const SIM_TASK *task = &simTasks[i];
+
+        printf("%-15s %3u %6.2f ", task->name, task->priority, task->cpuTime * 100.0 / simNow);
+        if (task->period != 0 && task->jobs != 0)
+            printf("%8llu %6llu %10.3f %10.3f %10.3f ", (unsigned long long)task->jobs, (unsigned long long)task->misses,
+                   task->responseSum / 1e3 / task->jobs, simPercentile(task, 990) / 1e3, task->responseMax / 1e3);
+        else
+            printf("%8s %6s %10s %10s %10s ", "-", "-", "-", "-", "-");
+        printf("%9.3f %9.3f %10.3f %9.3f\n", task->latencyCount ? task->latencySum / 1e3 / task->latencyCount : 0.0,
+               task->latencyMax / 1e3, task->blocked / 1e3, task->blockedMax / 1e3);
+    }
+    printf("times in ms\n\n");
+}
+
+/**
+ * @brief
+ * One run from a fresh kernel, in a child process
+ */
+static void simRun(const SIM_MODE *mode, uint64_t ticks, uint64_t seed)
+{
+    uint64_t end = ticks * SIM_TICK_US;
+    uint8_t i;
+
+    initRtos();
+    for (i = 0; i < MAX_MUTEXES; i++)
+    {
+        if (simMutexes[i])
+            initMutex(i);
+    }
+    for (i = 0; i < MAX_SEMAPHORES; i++)
+    {
+        if (simSemaphores[i] >= 0)
+            initSemaphore(i, simSemaphores[i]);
+    }
+    for (i = 0; i < simTaskCount; i++)
+    {
+        SIM_TASK *task = &simTasks[i];
+
+        if (!createThread((_fn)&simPids[i], task->name, task->priority, task->stack))
+        {
+            fprintf(stderr, "sim: no room for the stack of %s\n", task->name);
+            exit(1);
+        }
+        task->rng = (seed + i + 1) * 0x9E3779B97F4A7C15ULL;
+        task->bucketWidth = task->deadline ? (task->deadline + SIM_HIST_PER_DEADLINE - 1) / SIM_HIST_PER_DEADLINE : 1;
+        task->state = STATE_READY;
+    }
+
+    simServiceCall(SVC_SCHED, mode->priorityScheduler);
+    simServiceCall(SVC_PREEMPT, mode->preemption);
+    simServiceCall(SVC_START_R, 0);
+
+    while (simNow < end)
+    {
+        SIM_TASK *task = &simTasks[taskCurrent];
+        uint64_t slice;
+
+        if (task->remaining == 0)
+        {
+            simStep(task);
+            continue;
+        }
+
+        slice = simNextTick - simNow;
+        if (task->remaining < slice)
+            slice = task->remaining;
+        simNow += slice;
+        task->remaining -= slice;
+        task->cpuTime += slice;
+
+        if (task->remaining == 0 && task->pending != NULL)
+        {
+            const SIM_ACTION *action = task->pending;
+
+            task->pending = NULL;
+            simIssue(task, action);
+        }
+        if (simNow == simNextTick)
+        {
+            simNextTick += SIM_TICK_US;
+            simSystick();
+        }
+    }
+    simReport(mode, ticks);
+}
+
+static void simUsage(void)
+{
+    fprintf(stderr, "usage: sim [-m prio,rr,prio-coop,rr-coop] [-t ticks] [-s seed] [-c svc_us] workload\n");
+    exit(2);
+}
+
+//-----------------------------------------------------------------------------
+// Host hooks
+//-----------------------------------------------------------------------------
+
+// The kernel is entered directly, never through the wrappers
+uint64_t hostSvCall(uint64_t r0, uint64_t r1, uint64_t r2, uint64_t r3, uint64_t number)
+{
+    fprintf(stderr, "sim: unexpected service call %llu\n", (unsigned long long)number);
+    exit(1);
+}
+
+bool hostIsTaskStack(uint8_t task, const void *address, uint32_t size)
+{
+    return false;
+}
+
+bool hostIsReadOnly(const void *address, uint32_t size)
+{
+    return false;
+}
+
+// Fault handlers print through UART0, stderr here
+void putcUart0(char c)
+{
+    fputc(c, stderr);
+}
+
+void putsUart0(const char *str)
+{
+    fputs(str, stderr);
+}
+
+char getcUart0()
+{
+    return 0;
+}
+
+bool kbhitUart0()
+{
+    return false;
+}
+
+//-----------------------------------------------------------------------------
+// Main
+//-----------------------------------------------------------------------------
+
+int main(int argc, char *argv[])
+{
+    char modes[64] = "prio,rr";
+    uint64_t ticks = SIM_DEFAULT_TICKS;
+    uint64_t seed = 1;
+    char *name;
+    int option;
+    bool ok = true;
+
+    while ((option = getopt(argc, argv, "m:t:s:c:")) != -1)
+    {
+        switch (option)
+        {
+            case 'm':
+                snprintf(modes, sizeof(modes), "%s", optarg);
+                break;
+            case 't':
+                ticks = strtoull(optarg, NULL, 10);
+                break;
+            case 's':
+                seed = strtoull(optarg, NULL, 10);
+                break;
+            case 'c':
+                simSvcCost = strtoul(optarg, NULL, 10);
+                break;
+            default:
+                simUsage();
+        }
+    }
+    if (optind != argc - 1 || simSvcCost == 0)
+        simUsage();
+
+    simLoad(argv[optind]);
+
+    for (name = strtok(modes, ","); name != NULL; name = strtok(NULL, ","))
+    {
+        const SIM_MODE *mode = NULL;
+        uint8_t i;
+        int status;
+        pid_t child;
+
+        for (i = 0; i < sizeof(simModes) / sizeof(simModes[0]); i++)
+        {
+            if (strcmp(name, simModes[i].name) == 0)
+                mode = &simModes[i];
+        }
+        if (mode == NULL)
+            simUsage();
+
+        // The kernel's state, including the scheduler's statics, starts fresh in every mode
+        fflush(stdout);
+        child = fork();
+        if (child == 0)
+        {
+            simRun(mode, ticks, seed);
+            fflush(stdout);
+            _exit(0);
+        }
+        if (child < 0 || waitpid(child, &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+            ok = false;
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,38 @@
+// Host port stress suite hooks
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target:          Linux process, built by host/Makefile
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include "stress.h"
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+// The scenario is the HOST_STRESS environment variable, see stress.h
+bool stressGetConfig(char config[], uint32_t size)
+{
+    const char *scenario = getenv("HOST_STRESS");
+
+    if (scenario == NULL || strlen(scenario) >= size)
+        return false;
+    strcpy(config, scenario);
+    return true;
+}
+
+// The verdict is the exit status of the process
+void stressExit(bool ok)
+{
+    exit(ok ? EXIT_SUCCESS : EXIT_FAILURE);
+}
@@ -0,0 +1,30 @@
+// Host port wait functions
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target:          Linux process, built by host/Makefile
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#include <stdint.h>
+#include <errno.h>
+#include <time.h>
+#include "wait.h"
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+// Approximate busy waiting (in units of microseconds). The host sleeps
+// instead of spinning, a SysTick that lands in the middle still switches tasks
+void waitMicrosecond(uint32_t us)
+{
+    struct timespec remaining = {us / 1000000, (us % 1000000) * 1000};
+
+    while (nanosleep(&remaining, &remaining) != 0 && errno == EINTR)
+        ;
+}
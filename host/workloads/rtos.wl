@@ -0,0 +1,22 @@
+# The task set of rtos.c for the scheduling simulator (host/sim.c)
+#
+#   ./sim -m prio,rr,prio-coop,rr-coop workloads/rtos.wl
+#
+# Times are estimates of the task bodies in tasks.c. A button press is
+# modelled as ReadKeys polling 200 times before it sees one.
+
+mutex resource
+semaphore keyPressed 1
+semaphore keyReleased 0
+semaphore flashReq 5
+
+task Idle        15 stack=512  : run 1000; yield
+task LengthyFn   12 stack=1024 : lock resource; [run 990; yield]*5000; unlock resource
+task Flash4Hz     8 stack=512 period=125 : run 20
+task OneShot      4 stack=1536 : wait flashReq; run 10; sleep 1000
+task ReadKeys    12 stack=1024 : wait keyReleased; [run 5; yield]*200; post keyPressed; post flashReq; yield
+task Debounce    12 stack=1024 : wait keyPressed; [sleep 10; run 5]*10; post keyReleased
+task Important    0 stack=1024 : lock resource; run 10; sleep 1000; unlock resource
+task Uncoop      12 stack=1024 : run 5..50; yield
+task Errant      12 stack=512  : run 5..50; yield
+task Shell       12 stack=4096 : run exp:50; yield
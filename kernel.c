@@ -23,36 +23,14 @@
 #include "shell_auxiliary.h"
 #include "CortexM4Registers.h"
 #include "faults.h"
+#include "telemetry.h"
+#include "syscalls.h"
+#include "shell_commands.h"
+#include "kstats.h"
+#include "ktrace.h"
+#include "hal.h"
 #define EXC_RETURN_THREAD_PSP 0xFFFFFFFD
 
-//-----------------------------------------------------------------------------
-// Macros for the SVC calls
-//-----------------------------------------------------------------------------
-#define SVC_START_R 0
-#define SVC_YIELD 1
-#define SVC_RESTART_T 2
-#define SVC_STOP_T 3
-#define SVC_SET_PRIORITY_T 4
-#define SVC_SLEEP 5
-#define SVC_LOCK 6
-#define SVC_UNLOCK 7
-#define SVC_WAIT 8
-#define SVC_POST 9
-#define SVC_MALLOC_WRAPPER 10
-#define SVC_FREE_WRAPPER 11
-
-#define SVC_REBOOT 12
-#define SVC_PS 13
-#define SVC_IPCS 14
-#define SVC_KILL 15
-#define SVC_PKILL 16
-#define SVC_PI 17
-#define SVC_PREEMPT 18
-#define SVC_SCHED 19
-#define SVC_PIDOF 20
-#define SVC_MEMINFO 21
-#define SVC_GET_PROCESSES 22
-
 /*
     The PSR is a combination of the following:
     - APSR: Application Program Status Register
@@ -83,17 +61,11 @@ typedef struct _semaphore
 } semaphore;
 semaphore semaphores[MAX_SEMAPHORES];
 
-// task states
-#define STATE_INVALID 0           // no task
-#define STATE_STOPPED 1           // stopped, all memory freed
-#define STATE_READY 2             // has run, can resume at any time
-#define STATE_DELAYED 3           // has run, but now awaiting timer
-#define STATE_BLOCKED_MUTEX 4     // has run, but now blocked by semaphore
-#define STATE_BLOCKED_SEMAPHORE 5 // has run, but now blocked by semaphore
-
 // task
+#define IDLE_TASK 0 // main() creates the idle task first, it must always be ready
 uint8_t taskCurrent = 0; // index of last dispatched task
 uint8_t taskCount = 0;   // total number of valid tasks
+uint32_t systemTicks = 0; // number of 1ms ticks since the RTOS started
 
 // control
 bool priorityScheduler = PRIORITY_SCHEDULER; // priority (true) or round-robin (false)
@@ -102,23 +74,49 @@ bool preemption = PREEMPTIVE;                // preemption (true) or cooperative
 
 // tcb
 #define NUM_PRIORITIES 16
+// The byte fields are kept together, tcb[] lives in the 4 KiB of OS SRAM (see mm.h)
 struct _tcb
 {
     uint8_t state;           // see STATE_ values above
+    uint8_t priority;        // 0=highest
+    uint8_t currentPriority; // 0=highest (needed for pi)
+    uint8_t mutex;           // index of the mutex in use or blocking the thread
+    uint8_t semaphore;       // index of the semaphore that is blocking the thread
+    bool woken;              // made ready by a tick, post or unlock and not dispatched yet
     void *pid;               // used to uniquely identify thread (add of task fn)
     void *spInit;            // original top of stack
     void *sp;                // current stack pointer
-    uint8_t priority;        // 0=highest
-    uint8_t currentPriority; // 0=highest (needed for pi)
     uint32_t ticks;          // ticks until sleep complete
     uint64_t srd;            // MPU subregion disable bits
+    STACK_WINDOW stackWindow; // MPU region 6, covers the stack
     char name[16];           // name of task used in ps command
-    uint8_t mutex;           // index of the mutex in use or blocking the thread
-    uint8_t semaphore;       // index of the semaphore that is blocking the thread
     uint32_t sizeOfStack;    // size of the stack
     uint32_t baseAdress;     // Base adress
+    uint32_t cpuTicks;       // ticks the task was running when systick fired
+    uint32_t wokenAt;        // cycle count when it was made ready
+    uint32_t wakeups;        // wake-ups that were dispatched
+    uint32_t wakeLatencyMax; // cycles from ready to running, worst
+    uint64_t wakeLatencyTotal;
+    uint32_t arg;            // passed to the task function in R0, see spawnThread()
 } tcb[MAX_TASKS];
 
+// statistics page, read only for tasks (see kstats.h)
+#pragma DATA_SECTION(kernelStats, ".kstats")
+#pragma DATA_ALIGN(kernelStats, 1024)
+volatile KSTATS_PAGE kernelStats;
+
+// Compile time check that the statistics still fit in the page
+typedef char kstatsFitInPage[(sizeof(KSTATS) <= KSTATS_PAGE_SIZE) ? 1 : -1];
+
+#ifdef KERNEL_TRACE
+// Ring of the last events, see ktrace.h
+KTRACE_RECORD kernelTrace[KTRACE_SIZE];
+uint8_t kernelTraceNext = 0;  // Record written next
+uint8_t kernelTraceCount = 0; // Records not read yet
+uint32_t kernelTraceDropped = 0;
+uint8_t kernelTraceMask = 0;  // KTRACE_MASK() of the events recorded, 0 when stopped
+#endif
+
 //-----------------------------------------------------------------------------
 // Subroutines
 //-----------------------------------------------------------------------------
@@ -168,10 +166,17 @@ void initRtos(void)
     NVIC_ST_CTRL_R |= NVIC_ST_CTRL_INTEN; // TICKINT
 
     // Set the reload value
-    NVIC_ST_RELOAD_R = 40000 - 1;
+    NVIC_ST_RELOAD_R = SYSTEM_CLOCK_HZ / 1000 - 1;
 
     // Enable the SysTick timer
     NVIC_ST_CTRL_R |= NVIC_ST_CTRL_ENABLE;
+
+#ifndef QEMU_MPS2
+    // Start the DWT cycle counter read by getCycleCount()
+    NVIC_DBG_INT_R |= NVIC_DBG_INT_TRCENA;
+    DWT_CYCCNT_R = 0;
+    DWT_CTRL_R |= DWT_CTRL_CYCCNTENA;
+#endif
 }
 
 // REQUIRED: Implement prioritization to NUM_PRIORITIES
@@ -207,62 +212,70 @@ uint8_t rtosScheduler(void)
         static int64_t nextTaskWithSamePriority[NUM_PRIORITIES] =
             {-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1};
 
-        uint8_t x = 0, i = 0;
-        bool found = false;
+        uint8_t nextTask;
 
-        // If there is a -1 then go fill the queue for that prio
-        // else dispatch the task at the current priority
-
-        if (nextTaskWithSamePriority[currentPriority] == -1)
+        // A task queued in a ring may have stopped, slept or blocked since the ring
+        // was filled, so it is skipped and the next one is taken
+        do
         {
-            // First time in answer one question only; Who is the highest priority and is ready
-            for (i = currentPriority; i < NUM_PRIORITIES; i++)
+            uint8_t x = 0, i = 0;
+            bool found = false;
+            highestPrioAndReadyTask = 0xFF;
+
+            // If there is a -1 then go fill the queue for that prio
+            // else dispatch the task at the current priority
+
+            if (nextTaskWithSamePriority[currentPriority] == -1)
             {
-                for (x = 0; x < taskCount; x++)
+                // First time in answer one question only; Who is the highest priority and is ready
+                for (i = currentPriority; i < NUM_PRIORITIES; i++)
                 {
-                    if (tcb[x].state == STATE_READY && tcb[x].priority == currentPriority)
+                    for (x = 0; x < taskCount; x++)
                     {
-                        highestPrioAndReadyTask = x;
-                        nextTaskWithSamePriority[currentPriority] = highestPrioAndReadyTask;
-                        // The bottom retain 6 in the  queue and sign extended
-                        nextTaskWithSamePriority[currentPriority] = (nextTaskWithSamePriority[currentPriority] & 0xF) | ~0xF;
-                        found = true;
-                        break;
+                        if (tcb[x].state == STATE_READY && tcb[x].priority == currentPriority)
+                        {
+                            highestPrioAndReadyTask = x;
+                            nextTaskWithSamePriority[currentPriority] = highestPrioAndReadyTask;
+                            // The bottom retain 6 in the  queue and sign extended
+                            nextTaskWithSamePriority[currentPriority] = (nextTaskWithSamePriority[currentPriority] & 0xF) | ~0xF;
+                            found = true;
+                            break;
+                        }
                     }
+                    if (found)
+                        break;
+                    currentPriority++;
                 }
-                if (found)
-                    break;
-                currentPriority++;
-            }
-
-            // See if there are tasks that are ready and have the same priority within the same priority ring
-            // Will execute if it finds an index of a task that is ready and has the same priority
-            // Checking if it is not the default priority
-            if (highestPrioAndReadyTask != 0xFF)
-            {
-                uint8_t j = 0;
-                uint8_t iterator = 1; // Cannot start at zero. Only reason it is here is cause it there is someone in the queue
 
-                // Find the task with same priority and is STATE_READY
-                for (j = x + 1; j < taskCount; j++) // Don't bother checking the rest. So set to x. From where I am. Current prio
+                // See if there are tasks that are ready and have the same priority within the same priority ring
+                // Will execute if it finds an index of a task that is ready and has the same priority
+                // Checking if it is not the default priority
+                if (highestPrioAndReadyTask != 0xFF)
                 {
-                    if (tcb[j].priority == (currentPriority) && tcb[j].state == STATE_READY)
+                    uint8_t j = 0;
+                    uint8_t iterator = 1; // Cannot start at zero. Only reason it is here is cause it there is someone in the queue
+
+                    // Find the task with same priority and is STATE_READY
+                    for (j = x + 1; j < taskCount; j++) // Don't bother checking the rest. So set to x. From where I am. Current prio
                     {
-                        // j represents the idx of the tcb of the next task to run in the prio ring
-                        // Perform left shift to store the index of the next task with the same priority
-                        nextTaskWithSamePriority[currentPriority] &= ~(0xF << (iterator * 4)); // Clear the bit field
-                        nextTaskWithSamePriority[currentPriority] |= (j << (iterator++ * 4));
+                        if (tcb[j].priority == (currentPriority) && tcb[j].state == STATE_READY)
+                        {
+                            // j represents the idx of the tcb of the next task to run in the prio ring
+                            // Perform left shift to store the index of the next task with the same priority
+                            nextTaskWithSamePriority[currentPriority] &= ~((int64_t)0xF << (iterator * 4)); // Clear the bit field
+                            nextTaskWithSamePriority[currentPriority] |= ((int64_t)j << (iterator++ * 4));
+                        }
                     }
                 }
             }
-        }
 
-        // Would need to see the next task with the prior priority
-        uint8_t nextTask = nextTaskWithSamePriority[currentPriority] & 0x0F;
-        nextTaskWithSamePriority[currentPriority] >>= 4; // This will mark it as -1 when there is only one task
+            // Would need to see the next task with the prior priority
+            nextTask = nextTaskWithSamePriority[currentPriority] & 0x0F;
+            nextTaskWithSamePriority[currentPriority] >>= 4; // This will mark it as -1 when there is only one task
 
-        // If it is not empty stay at same level and rr
-        currentPriority = nextTaskWithSamePriority[currentPriority] != -1 ? currentPriority : 0x00;
+            // If it is not empty stay at same level and rr
+            currentPriority = nextTaskWithSamePriority[currentPriority] != -1 ? currentPriority : 0x00;
+        } while (tcb[nextTask].state != STATE_READY);
 
         task = nextTask; // Faulting here due to being assigned the default value when nothing is found
     }
@@ -270,11 +283,6 @@ uint8_t rtosScheduler(void)
     return task;
 }
 
-void launchTask()
-{
-    __asm(" SVC #0");
-}
-
 // REQUIRED: modify this function to start the operating system
 // by calling scheduler, set srd bits, setting PSP, ASP bit, call fn with fn add in R0
 // fn set TMPL bit, and PC <= fn
@@ -287,6 +295,75 @@ void startRtos(void)
     launchTask(); // Does a service call (Goes to privileged mode)
 }
 
+/**
+ * @brief
+ * Makes a new stack look like the thread has run before so that
+ * the first task switch to it pops a valid frame and jumps to its function
+ */
+static void initThreadStack(uint8_t task)
+{
+    tcb[task].sp = tcb[task].spInit;
+
+    uint32_t *psp = (uint32_t *)tcb[task].sp;
+
+    *(psp - 1) = EPSR_THUMB_MASK;       // Set the Thumb bit in the EPSR
+    *(psp - 2) = (uint32_t)tcb[task].pid; // Set the PC to the function address
+    *(psp - 3) = EXC_RETURN_THREAD_PSP; // Set the LR to thread mode and use the PSP
+    *(psp - 4) = 0x00000000;            // Zero out R12
+    *(psp - 5) = 0x00000000;            // Zero out R3
+    *(psp - 6) = 0x00000000;            // Zero out R2
+    *(psp - 7) = 0x00000000;            // Zero out R1
+    *(psp - 8) = tcb[task].arg;         // R0: argument of the task function
+    /*
+        Page 152 ARM Optimizing C/C++ Compiler User Guide:
+        Preserve any dedicated registers
+        - Save-on-reentry registers (R4-R11, LR)
+        - SP R13
+    */
+    // Simulate the pushing of the registers
+    *(psp - 9) = EXC_RETURN_THREAD_PSP; // Set the LR to thread mode and use the PSP
+    *(psp - 10) = 0x44444444;           // Zero out R11
+    *(psp - 11) = 0x00000000;           // Zero out R10
+    *(psp - 12) = 0x00000000;           // Zero out R9
+    *(psp - 13) = 0x00000000;           // Zero out R8
+    *(psp - 14) = 0x00000000;           // Zero out R7
+    *(psp - 15) = 0x00000000;           // Zero out R6
+    *(psp - 16) = 0x00000000;           // Zero out R5
+    *(psp - 17) = 0x00000000;           // Zero out R4 (Lowest numbered register using the lowest memory address)
+
+    psp -= 17; // Move the stack pointer to the next available memory location
+    tcb[task].sp = (void *)psp;
+    /*
+        Page 41 of the Cortex-M4 Generic User Guide
+
+        Exception return
+        Occurs when the processor is in handler mode and executes
+        one of the following instructions to load EXC_RETURN into the PC:
+        - LDM or POP with the PC in the list
+        - LDR with PC as the destination register
+        - BX instruction using any register
+
+        IMPORTANT:
+        EXC_RETURN is the value loaded on to LR on exception entry.
+        When it is loaded to PC it indicates to the processor that the
+        exception is complete.
+    */
+}
+
+/**
+ * @brief
+ * Gives the task access to its stack, through region 6 when it can cover
+ * the stack exactly, else through the SRD bits (large stacks only).
+ * Resets the SRD window, the task has no other memory at this point
+ */
+static void initStackAccess(uint8_t task)
+{
+    tcb[task].srd = createNoSramAccessMask();
+
+    if (!createStackWindow(&tcb[task].stackWindow, tcb[task].baseAdress, tcb[task].sizeOfStack))
+        addSramAccessWindow(&tcb[task].srd, (uint32_t *)tcb[task].baseAdress, tcb[task].sizeOfStack);
+}
+
 // REQUIRED:
 // add task if room in task list
 // store the thread name
@@ -317,9 +394,11 @@ bool createThread(_fn fn, const char name[], uint8_t priority, uint32_t stackByt
             {
                 i++;
             }
-            uint32_t size = ALIGN_SIZE(stackBytes);
+            uint32_t size = getStackSize(stackBytes);
             // 1. Create a void pointer. Preallocate memory for the thread
-            void *ptr = mallocFromHeap(size);
+            void *ptr = mallocStack(size, i);
+            if (ptr == NULL)
+                return false;
 
             tcb[i].baseAdress = (uint32_t)ptr;
 
@@ -334,56 +413,13 @@ bool createThread(_fn fn, const char name[], uint8_t priority, uint32_t stackByt
             tcb[i].sp = (void *)((uint32_t)ptr + size);
             tcb[i].spInit = (void *)((uint32_t)ptr + size); // May not need this as mentioned in class
             tcb[i].priority = priority;                     //
-            tcb[i].srd = createNoSramAccessMask();
 
-            // 3.  Configure/Modify the srd bit mask
-            addSramAccessWindow(&tcb[i].srd, ptr, size);
+            // 3. Configure the stack window and the srd bit mask
+            initStackAccess(i);
 
             // 4. Make the thread appea as if it has run before
-            uint32_t *psp = (uint32_t *)tcb[i].sp;
-
-            *(psp - 1) = EPSR_THUMB_MASK;       // Set the Thumb bit in the EPSR
-            *(psp - 2) = (uint32_t)tcb[i].pid;  // Set the PC to the function address
-            *(psp - 3) = EXC_RETURN_THREAD_PSP; // Set the LR to thread mode and use the PSP
-            *(psp - 4) = 0x00000000;            // Zero out R12
-            *(psp - 5) = 0x00000000;            // Zero out R3
-            *(psp - 6) = 0x00000000;            // Zero out R2
-            *(psp - 7) = 0x00000000;            // Zero out R1
-            *(psp - 8) = 0x00000000;            // Zero out R0
-            /*
-                Page 152 ARM Optimizing C/C++ Compiler User Guide:
-                Preserve any dedicated registers
-                - Save-on-reentry registers (R4-R11, LR)
-                - SP R13
-            */
-            // Simulate the pushing of the registers
-            *(psp - 9) = EXC_RETURN_THREAD_PSP; // Set the LR to thread mode and use the PSP
-            *(psp - 10) = 0x44444444;           // Zero out R11
-            *(psp - 11) = 0x00000000;           // Zero out R10
-            *(psp - 12) = 0x00000000;           // Zero out R9
-            *(psp - 13) = 0x00000000;           // Zero out R8
-            *(psp - 14) = 0x00000000;           // Zero out R7
-            *(psp - 15) = 0x00000000;           // Zero out R6
-            *(psp - 16) = 0x00000000;           // Zero out R5
-            *(psp - 17) = 0x00000000;           // Zero out R4 (Lowest numbered register using the lowest memory address)
-
-            psp -= 17; // Move the stack pointer to the next available memory location
-            tcb[i].sp = (void *)psp;
-            /*
-                Page 41 of the Cortex-M4 Generic User Guide
-
-                Exception return
-                Occurs when the processor is in handler mode and executes
-                one of the following instructions to load EXC_RETURN into the PC:
-                - LDM or POP with the PC in the list
-                - LDR with PC as the destination register
-                - BX instruction using any register
-
-                IMPORTANT:
-                EXC_RETURN is the value loaded on to LR on exception entry.
-                When it is loaded to PC it indicates to the processor that the
-                exception is complete.
-            */
+            initThreadStack(i);
+
             // increment task count
             taskCount++;
             ok = true;
@@ -392,89 +428,107 @@ bool createThread(_fn fn, const char name[], uint8_t priority, uint32_t stackByt
     return ok;
 }
 
-// REQUIRED: modify this function to restart a thread
-void restartThread(_fn fn)
-{
-    __asm(" SVC #2");
-}
+//-----------------------------------------------------------------------------
+// Service call wrappers
+//-----------------------------------------------------------------------------
 
-// REQUIRED: modify this function to stop a thread
-// REQUIRED: remove any pending semaphore waiting, unlock any mutexes
-void stopThread(_fn fn)
-{
-    __asm(" SVC #3");
-}
+// Generated from SYSCALL_LIST in syscalls.h
+SYSCALL_LIST(SYSCALL_STUB)
 
-// REQUIRED: modify this function to set a thread priority
-void setThreadPriority(_fn fn, uint8_t priority)
+// REQUIRED: modify this function to add support for the system timer
+// REQUIRED: in preemptive code, add code to request task switch
+/**
+ * @brief
+ * CPU cycles from the DWT cycle counter
+ */
+static uint32_t readCycleCounter(void)
 {
-    uint8_t i = 0;
-    for (i = 0; i < taskCount; i++)
+#ifdef QEMU_MPS2
+    // No DWT under QEMU, count in SysTick periods instead (exact with -icount).
+    // A tick pending behind the caller has not been counted by systickIsr() yet
+    uint32_t period = NVIC_ST_RELOAD_R + 1;
+    uint32_t ticks = systemTicks;
+    uint32_t current = NVIC_ST_CURRENT_R;
+
+    if (NVIC_INT_CTRL_R & NVIC_INT_CTRL_PENDSTSET)
     {
-        if (tcb[i].pid == fn)
-        {
-            tcb[i].priority = priority;
-            break;
-        }
+        ticks++;
+        current = NVIC_ST_CURRENT_R;
     }
+    return ticks * period + (period - 1 - current);
+#else
+    return DWT_CYCCNT_R;
+#endif
 }
 
-// REQUIRED: modify this function to yield execution back to scheduler using pendsv
-void yield(void)
-{
-    __asm(" SVC #1 "); // PC 0x00002328 -> DFFE
-                       // SP 0x20007FF8
-}
-
-// REQUIRED: modify this function to support 1ms system timer
-// execution yielded back to scheduler until time elapses using pendsv
-void sleep(uint32_t tick)
+#ifdef KERNEL_TRACE
+/**
+ * @brief
+ * Adds an event to the trace ring if its class is recorded, overwriting
+ * the oldest record
+ */
+static void traceKernel(uint8_t event, uint8_t task, uint8_t arg, uint8_t detail)
 {
-    /*
-        Will mark the task as delayed and save the context necessary
-        for resuming the task later.
-
-        The task is then delayed until a kernel determines that a
-        period of time_ms has expired.
-
-        Once the time has expired, the task that called sleep() will be
-        marked as ready so that the scheduler can resume the task later.
-    */
-
-    __asm(" SVC #5");
-}
-
-// REQUIRED: modify this function to lock a mutex using pendsv
-void lock(int8_t mutex)
-{
-    __asm(" SVC #6");
+    KTRACE_RECORD *record;
+
+    if (!(kernelTraceMask & KTRACE_MASK(event)))
+        return;
+
+    record = &kernelTrace[kernelTraceNext];
+    record->time = readCycleCounter();
+    record->event = event;
+    record->task = task;
+    record->arg = arg;
+    record->detail = detail;
+    kernelTraceNext = (kernelTraceNext + 1) % KTRACE_SIZE;
+    if (kernelTraceCount < KTRACE_SIZE)
+        kernelTraceCount++;
+    else
+        kernelTraceDropped++;
 }
-
-// REQUIRED: modify this function to unlock a mutex using pendsv
-void unlock(int8_t mutex)
+#define TRACE_KERNEL(event, task, arg, detail) traceKernel(event, task, arg, detail)
+#else
+#define TRACE_KERNEL(event, task, arg, detail) ((void)0)
+#endif
+
+/**
+ * @brief
+ * Records a fault of the current task, called first by the fault handlers
+ */
+void traceFault(uint8_t fault)
 {
-    __asm(" SVC #7");
+    TRACE_KERNEL(KTRACE_FAULT, taskCurrent, fault, 0);
 }
 
-// REQUIRED: modify this function to wait a semaphore using pendsv
-void wait(int8_t semaphore)
+/**
+ * @brief
+ * Makes a delayed or blocked task ready and starts timing its wake-up latency.
+ * source is a KTRACE_BY_ value, index the mutex or semaphore
+ */
+static void wakeTask(uint8_t task, uint8_t source, uint8_t index)
 {
-    __asm(" SVC #8");
+    TRACE_KERNEL(KTRACE_WAKE, task, source, index);
+    tcb[task].state = STATE_READY;
+    tcb[task].woken = true;
+    tcb[task].wokenAt = readCycleCounter();
 }
 
-// REQUIRED: modify this function to signal a semaphore is available using pendsv
-void post(int8_t semaphore)
+/**
+ * @brief
+ * Wake-up latency of a woken task that is being dispatched, the time
+ * it spent ready waiting for the processor
+ */
+static void recordWakeLatency(uint8_t task)
 {
-    __asm(" SVC #9");
-}
+    uint32_t latency = readCycleCounter() - tcb[task].wokenAt;
 
-void *malloc_from_heap_wrapper(uint32_t size)
-{
-    __asm(" SVC #10");
+    tcb[task].woken = false;
+    tcb[task].wakeups++;
+    tcb[task].wakeLatencyTotal += latency;
+    if (latency > tcb[task].wakeLatencyMax)
+        tcb[task].wakeLatencyMax = latency;
 }
 
-// REQUIRED: modify this function to add support for the system timer
-// REQUIRED: in preemptive code, add code to request task switch
 void systickIsr(void)
 {
     /*
@@ -485,6 +539,10 @@ void systickIsr(void)
 
     uint8_t i;
 
+    systemTicks++;
+    tcb[taskCurrent].cpuTicks++;
+    TRACE_KERNEL(KTRACE_TICK, taskCurrent, 0, 0);
+
     for (i = 0; i < taskCount; i++)
     {
         if (tcb[i].state == STATE_DELAYED)
@@ -492,18 +550,34 @@ void systickIsr(void)
             tcb[i].ticks--;
             if (tcb[i].ticks == 0)
             {
-                tcb[i].state = STATE_READY;
+                wakeTask(i, KTRACE_BY_TICK, 0);
             }
         }
     }
 
+    updateKernelStats();
+
     if (preemption)
         setPendSV();
 }
 
 // REQUIRED: in coop and preemptive, modify this function to add support for task switching
 // REQUIRED: process UNRUN and READY tasks differently
-__attribute__((naked)) void pendSvIsr(void)
+/**
+ * @brief
+ * Runs the scheduler and traces the switch. Apart from pendSvIsr(), which
+ * is naked on the target and has no frame for locals
+ */
+static uint8_t nextTask(void)
+{
+    uint8_t task = rtosScheduler();
+
+    if (task != taskCurrent)
+        TRACE_KERNEL(KTRACE_SWITCH, task, taskCurrent, 0);
+    return task;
+}
+
+PENDSV_ENTRY void pendSvIsr(void)
 {
     // ALL TASK SWITCHING WILL BE DONE HERE
     /*
@@ -543,13 +617,16 @@ __attribute__((naked)) void pendSvIsr(void)
         NVIC_FAULT_STAT_R &= ~NVIC_FAULT_STAT_DERR;
     }
 
-    __asm(" mov r12, lr");
+    SAVE_EXC_RETURN();
     pushR4R11(); // Saving the registers
 
     tcb[taskCurrent].sp = getPSP();            // Save the stack pointer
-    taskCurrent = rtosScheduler();             // Call the scheduler
+    taskCurrent = nextTask();                  // Call the scheduler
+    if (tcb[taskCurrent].woken)
+        recordWakeLatency(taskCurrent);
     setPSP(tcb[taskCurrent].sp);               // Restore the stack pointer
     applySramAccessMask(tcb[taskCurrent].srd); // Restore the SRD bits
+    applyStackWindow(&tcb[taskCurrent].stackWindow); // Move region 6 to the stack
 
     // Pop the registers from the stack (R4-R11)
     popR4R11(); // Restoring the registers
@@ -558,311 +635,929 @@ __attribute__((naked)) void pendSvIsr(void)
     // R0-R3, R12, LR, PC, xPSR
 }
 
-// REQUIRED: in preemptive code, add code to handle synchronization primitives
-void svCallIsr(void)
-{
-    /*
-        Is an exception that is triggered by the SVC instruction.
-        In an OS environment applications can use SVC instructions to
-        access kernel functions and device drivers
-
-        *  Page 106 ARM Optimizing C/C++ Compiler User Guide:
-           Cortex-M architecutres, C SWI handlers cannot return values.
-    */
-    /*
-         - Will do switch case statement
-         - Unprivileged code can call SVC instructions to access kernel functions
-    */
-    uint32_t svcNum;
-    uint32_t *pc = getPSP();
+//-----------------------------------------------------------------------------
+// Service call handlers
+//-----------------------------------------------------------------------------
 
-    svcNum = *(pc + 6);
-    svcNum -= 2;
-    svcNum = *(uint32_t *)svcNum & 0xFF;
+/*
+    One handler per service call, indexed by number in svcTable.
+    Each handler receives the caller's stacked frame (R0-R3 are the arguments)
+    and its return value is written back to the stacked R0.
+*/
+SYSCALL_LIST(SYSCALL_HANDLER_PROTOTYPE)
 
-    switch (svcNum)
+const _svcHandler svcTable[NUM_SVCS] =
     {
-    case SVC_START_R:
-        // Step 5: startRTOS() to call the scheduler and
-        // then switch to privileged mode when launching the first task
-        taskCurrent = rtosScheduler();
-        applySramAccessMask(tcb[taskCurrent].srd);
-        setPSP(tcb[taskCurrent].sp);
-        popR4R11();
+        SYSCALL_LIST(SYSCALL_TABLE_ENTRY)};
+
+/**
+ * @brief
+ * True if the current task may write size bytes at address
+ * i.e. the range is inside the task's SRD window
+ */
+bool isTaskWritable(const void *address, uint32_t size)
+{
+    uint32_t offset = (uint32_t)address - tcb[taskCurrent].baseAdress;
 
-        break;
+    // The stack is reached through region 6, not the SRD bits
+    if (offset < tcb[taskCurrent].sizeOfStack && size <= tcb[taskCurrent].sizeOfStack - offset)
+        return true;
 
-    case SVC_YIELD:
-        setPendSV(); // Does the task switching
-        break;
+    if (HAL_IS_TASK_STACK(taskCurrent, address, size))
+        return true;
 
-    case SVC_SLEEP:
-        /*
-            - Set state to delayed
-            - Set the ticks
-            - pendSV
-        */
-        tcb[taskCurrent].ticks = *(getPSP()); // Set the ticks
-        tcb[taskCurrent].state = STATE_DELAYED;
+    return isSramAccessAllowed(tcb[taskCurrent].srd, (uint32_t)address, size);
+}
 
-        setPendSV(); // Does the task switching
-        break;
+/**
+ * @brief
+ * True if the current task may read size bytes at address.
+ * Read only arguments (e.g. string literals) may also live in flash
+ */
+bool isTaskReadable(const void *address, uint32_t size)
+{
+    return HAL_IS_READ_ONLY(address, size) || isTaskWritable(address, size);
+}
 
-    case SVC_LOCK:
+/**
+ * @brief
+ * Validates a null terminated string of at most maxLength characters
+ */
+bool isTaskString(const char *str, uint32_t maxLength)
+{
+    uint32_t i;
+    for (i = 0; i <= maxLength; i++)
     {
-        /*
-            - Locks the mutex
-            - Returns if a resource is available
-            - Marks the task as blocked on a mutex
-            - Records the task in the mutex process queue
-        */
+        if (!isTaskReadable(&str[i], 1))
+            return false;
+        if (str[i] == 0)
+            return true;
+    }
+    return false;
+}
 
-        // Need to grab the parameter which will represent the mutex
-        uint8_t mutexIdx;
-        mutexIdx = *(getPSP());
+static uint32_t svcStartRtos(SVC_FRAME *frame)
+{
+    // Step 5: startRTOS() to call the scheduler and
+    // then switch to privileged mode when launching the first task
+    uint32_t r0 = frame->r0;
+
+    taskCurrent = rtosScheduler();
+    applySramAccessMask(tcb[taskCurrent].srd);
+    applyStackWindow(&tcb[taskCurrent].stackWindow);
+    setPSP(tcb[taskCurrent].sp);
+    popR4R11();
+
+    // The frame belongs to startRtos() and is abandoned, leave it untouched
+    return r0;
+}
 
-        if (!mutexes[mutexIdx].lock) // Checking if we are free
-        {
-            mutexes[mutexIdx].lock = true;            // Lock the mutex
-            mutexes[mutexIdx].lockedBy = taskCurrent; // Record the task that locked the mutex
-        }
-        else if (mutexes[mutexIdx].lockedBy != taskCurrent) // Check that the task that is trying to lock it has done it in the past
+// REQUIRED: modify this function to yield execution back to scheduler using pendsv
+static uint32_t svcYield(SVC_FRAME *frame)
+{
+    setPendSV(); // Does the task switching
+    return 0;
+}
+
+/**
+ * @brief
+ * Releases a mutex held by its owner and hands it to the first task in its queue
+ */
+static void releaseMutex(uint8_t mutexIdx)
+{
+    mutexes[mutexIdx].lock = false; // Unlock the mutex
+    // Check if there are any tasks in the queue
+    if (mutexes[mutexIdx].queueSize > 0)
+    {
+        mutexes[mutexIdx].lockedBy = mutexes[mutexIdx].processQueue[0]; // Set the lockedBy to the next task in the queue
+        mutexes[mutexIdx].lock = true;                                  // Added according to Leo
+        // Mark the task in queue as ready
+        wakeTask(mutexes[mutexIdx].lockedBy, KTRACE_BY_UNLOCK, mutexIdx);
+
+        // Move the tasks in the queue
+        int i;
+        for (i = 0; i < mutexes[mutexIdx].queueSize - 1; i++)
         {
-            /// Mark the task as blocked  will be important in the ipcs command
-            tcb[taskCurrent].state = STATE_BLOCKED_MUTEX;                              // Set the state to blocked
-            mutexes[mutexIdx].processQueue[mutexes[mutexIdx].queueSize] = taskCurrent; // The processQueue is up to 2 tasks
-            mutexes[mutexIdx].queueSize++;
+            mutexes[mutexIdx].processQueue[i] = mutexes[mutexIdx].processQueue[i + 1];
         }
+        mutexes[mutexIdx].queueSize--; // Decrement the queue size
+    }
+}
 
-        setPendSV(); // Does the task switching
+/**
+ * @brief
+ * Removes a task from a mutex or semaphore process queue
+ */
+static void removeFromQueue(uint8_t queue[], uint8_t *queueSize, uint8_t task)
+{
+    uint8_t i, j = 0;
 
-        break;
+    for (i = 0; i < *queueSize; i++)
+    {
+        if (queue[i] != task)
+            queue[j++] = queue[i];
     }
-    case SVC_UNLOCK:
+    *queueSize = j;
+}
+
+/**
+ * @brief
+ * Index of the task with the given PID, -1 if there is none
+ */
+static int8_t findTask(_fn fn)
+{
+    uint8_t i;
+
+    for (i = 0; i < taskCount; i++)
     {
-        /*
-            - Only the thread that locked the mutex can unlock it
-        */
-        // Need to grab the paramter which will represent the mutex
-        uint8_t mutexIdx;
-        mutexIdx = *(getPSP());
+        if (tcb[i].pid == fn && tcb[i].state != STATE_INVALID)
+            return i;
+    }
+    return -1;
+}
 
-        // If the task that locked the mutex is the one trying to unlock it
-        if (mutexes[mutexIdx].lockedBy == taskCurrent)
-        {
-            mutexes[mutexIdx].lock = false; // Unlock the mutex
-            // Check if there are any tasks in the queue
-            if (mutexes[mutexIdx].queueSize > 0)
-            {
-                mutexes[mutexIdx].lockedBy = mutexes[mutexIdx].processQueue[0]; // Set the lockedBy to the next task in the queue
-                mutexes[mutexIdx].lock = true;                                  // Added according to Leo
-                // Mark the task in queue as ready
-                tcb[mutexes[0].lockedBy].state = STATE_READY;
-
-                // Move the tasks in the queue
-                int i;
-                for (i = 0; i < mutexes[mutexIdx].queueSize; i++)
-                {
-                    mutexes[mutexIdx].processQueue[i] = mutexes[mutexIdx].processQueue[i + 1]; // mutexIdx used to be zero
-                }
-                mutexes[mutexIdx].queueSize--; // Decrement the queue size
-            }
-        }
-        // TBD: else -> delete the thread
+/**
+ * @brief
+ * Gives a stopped task a new stack and makes it ready, the tcb kept
+ * its name, priority, stack size and argument when it was stopped
+ */
+static bool restartTask(uint8_t task)
+{
+    void *ptr = mallocStack(tcb[task].sizeOfStack, task);
+
+    if (ptr == NULL)
+        return false;
+
+    tcb[task].baseAdress = (uint32_t)ptr;
+    tcb[task].spInit = (void *)((uint32_t)ptr + tcb[task].sizeOfStack);
+    initStackAccess(task);
+    initThreadStack(task);
+
+    tcb[task].currentPriority = tcb[task].priority;
+    tcb[task].mutex = 0;
+    tcb[task].semaphore = 0;
+    tcb[task].ticks = 0;
+    tcb[task].cpuTicks = 0;
+    tcb[task].woken = false;
+    tcb[task].wakeups = 0;
+    tcb[task].wakeLatencyMax = 0;
+    tcb[task].wakeLatencyTotal = 0;
+    tcb[task].state = STATE_READY;
+    TRACE_KERNEL(KTRACE_WAKE, task, KTRACE_BY_RESTART, 0);
+    return true;
+}
+
+// REQUIRED: modify this function to restart a thread
+static uint32_t svcRestartThread(SVC_FRAME *frame)
+{
+    // R0: pid
+    int8_t task = findTask((_fn)frame->r0);
+
+    if (task < 0 || tcb[task].state != STATE_STOPPED)
+        return false;
+    return restartTask(task);
+}
 
-        break;
+static uint32_t svcSpawnThread(SVC_FRAME *frame)
+{
+    // R0: Address of the THREAD_SPEC
+    // Creates the thread at run time, or restarts it with the new name,
+    // priority and argument if it exists and is stopped (its tcb and stack
+    // size are kept, tasks are never removed from the list)
+    const THREAD_SPEC *spec = (const THREAD_SPEC *)frame->r0;
+    int8_t task;
+
+    if (!isTaskReadable(spec, sizeof(THREAD_SPEC)) || !isTaskString(spec->name, MAX_SPAWN_NAME) ||
+        spec->priority >= NUM_PRIORITIES)
+        return false;
+
+    task = findTask(spec->fn);
+    if (task >= 0)
+    {
+        if (tcb[task].state != STATE_STOPPED)
+            return false;
+        strCopy(tcb[task].name, spec->name);
+        tcb[task].priority = spec->priority;
+        tcb[task].arg = spec->arg;
+        return restartTask(task);
     }
-    case SVC_WAIT:
+
+    if (!createThread(spec->fn, spec->name, spec->priority, spec->stackBytes))
+        return false;
+
+    // The new stack was built before the argument was known
+    task = findTask(spec->fn);
+    tcb[task].arg = spec->arg;
+    initThreadStack(task);
+    return true;
+}
+
+// REQUIRED: modify this function to stop a thread
+// REQUIRED: remove any pending semaphore waiting, unlock any mutexes
+static uint32_t svcStopThread(SVC_FRAME *frame)
+{
+    // R0: pid
+    int8_t task = findTask((_fn)frame->r0);
+    uint8_t i;
+
+    if (task < 0 || task == IDLE_TASK || tcb[task].state == STATE_STOPPED)
+        return false;
+
+    // Leave every queue and pass on the mutexes the task holds
+    for (i = 0; i < MAX_MUTEXES; i++)
     {
-        /*
-            - Decrements the semaphore count and
-              returns if a resource is available.
+        removeFromQueue(mutexes[i].processQueue, &mutexes[i].queueSize, task);
+        if (mutexes[i].lock && mutexes[i].lockedBy == task)
+            releaseMutex(i);
+    }
+    for (i = 0; i < MAX_SEMAPHORES; i++)
+        removeFromQueue(semaphores[i].processQueue, &semaphores[i].queueSize, task);
+
+    // Reclaim the stack and every block the task allocated
+    freeStack((void *)tcb[task].baseAdress, tcb[task].sizeOfStack);
+    freeAllOfOwner(task);
+    dynamicMemoryOfEachTask[task] = 0;
+    tcb[task].baseAdress = 0;
+    tcb[task].srd = createNoSramAccessMask();
+    createStackWindow(&tcb[task].stackWindow, 0, 0); // Region 6 disabled
+    tcb[task].state = STATE_STOPPED;
+    TRACE_KERNEL(KTRACE_BLOCK, task, KTRACE_ON_STOP, 0);
+
+    // The stack is no longer ours but nothing can allocate it before
+    // PendSV has saved the last registers on it and switched away
+    if (task == taskCurrent)
+        setPendSV();
+    return true;
+}
 
-            - If not available marks the task as blocked on a semaphore, and
-              records the task in the semaphore process queue
-        */
+// REQUIRED: modify this function to set a thread priority
+static uint32_t svcSetThreadPriority(SVC_FRAME *frame)
+{
+    // R0: pid, R1: priority
+    _fn fn = (_fn)frame->r0;
+    uint8_t i = 0;
 
-        // Grab the semaphore index from the parameter
-        uint8_t semaphoreIdx;
-        semaphoreIdx = *(getPSP());
+    // The priority scheduler indexes its rings by priority
+    if (frame->r1 >= NUM_PRIORITIES)
+        return 0;
 
-        if (semaphores[semaphoreIdx].count > 0)
-        {
-            semaphores[semaphoreIdx].count--; // Equivalent to CONSUMING a resource?
-            return;
-        }
-        else
+    for (i = 0; i < taskCount; i++)
+    {
+        if (tcb[i].pid == fn)
         {
-            // Place in the processQueue by setting the index to queueSize
-            semaphores[semaphoreIdx].processQueue[semaphores[semaphoreIdx].queueSize] = taskCurrent;
-            semaphores[semaphoreIdx].queueSize++;
-            tcb[taskCurrent].state = STATE_BLOCKED_SEMAPHORE;
-            tcb[taskCurrent].semaphore = semaphoreIdx;
-            setPendSV();
+            tcb[i].priority = frame->r1;
+            break;
         }
-        break;
     }
-    case SVC_POST:
-    {
-        /*
-            Increases the semaphore count.
-            If a process is waiting in the queue, decrement the count and mark the task as ready
-        */
+    return 0;
+}
 
-        // Grab the semaphore index from the parameter
-        uint8_t semaphoreIdx = *(getPSP());
+// REQUIRED: modify this function to support 1ms system timer
+// execution yielded back to scheduler until time elapses using pendsv
+static uint32_t svcSleep(SVC_FRAME *frame)
+{
+    /*
+        Will mark the task as delayed and save the context necessary
+        for resuming the task later.
 
-        // Increment the semaphore count for posting
-        // For that specific semaphore
-        semaphores[semaphoreIdx].count++; // Equivalent to PRODUCING a resource?
+        The task is then delayed until a kernel determines that a
+        period of time_ms has expired.
 
-        // Check if there are any tasks in the queue
-        if (semaphores[semaphoreIdx].queueSize > 0)
-        {
-            semaphores[semaphoreIdx].count--; // Decrement the count
+        Once the time has expired, the task that called sleep() will be
+        marked as ready so that the scheduler can resume the task later.
 
-            // Set the task in the queue as ready
-            tcb[semaphores[semaphoreIdx].processQueue[0]].state = STATE_READY;
+        - Set state to delayed
+        - Set the ticks
+        - pendSV
 
-            // Move the tasks in the queue
-            uint8_t i;
-            for (i = 0; i < semaphores[semaphoreIdx].queueSize; i++)
-            {
-                semaphores[semaphoreIdx].processQueue[i] = semaphores[semaphoreIdx].processQueue[i + 1];
-            }
-            semaphores[semaphoreIdx].queueSize--; // Decrement the queue size
-        }
+        sleep(0) only gives up the processor: a delay of 0 ticks would
+        wrap in systickIsr() and never expire
+    */
+    if (frame->r0 > 0)
+    {
+        tcb[taskCurrent].ticks = frame->r0; // Set the ticks
+        tcb[taskCurrent].state = STATE_DELAYED;
+        TRACE_KERNEL(KTRACE_BLOCK, taskCurrent, KTRACE_ON_SLEEP, 0);
+    }
+
+    setPendSV(); // Does the task switching
+    return 0;
+}
+
+// REQUIRED: modify this function to lock a mutex using pendsv
+static uint32_t svcLock(SVC_FRAME *frame)
+{
+    /*
+        - Locks the mutex
+        - Returns if a resource is available
+        - Marks the task as blocked on a mutex
+        - Records the task in the mutex process queue
+    */
+
+    // R0 represents the mutex
+    // False if the mutex is invalid or its queue is full
+    uint8_t mutexIdx = frame->r0;
 
-        break;
+    if (mutexIdx >= MAX_MUTEXES)
+        return false;
+
+    if (!mutexes[mutexIdx].lock) // Checking if we are free
+    {
+        mutexes[mutexIdx].lock = true;            // Lock the mutex
+        mutexes[mutexIdx].lockedBy = taskCurrent; // Record the task that locked the mutex
     }
-    case SVC_MALLOC_WRAPPER:
+    else if (mutexes[mutexIdx].lockedBy != taskCurrent) // Check that the task that is trying to lock it has done it in the past
     {
-        // This function will be called within unprivileged tasks
+        if (mutexes[mutexIdx].queueSize >= MAX_MUTEX_QUEUE_SIZE)
+            return false;
+
+        /// Mark the task as blocked  will be important in the ipcs command
+        tcb[taskCurrent].state = STATE_BLOCKED_MUTEX;                              // Set the state to blocked
+        tcb[taskCurrent].mutex = mutexIdx;
+        TRACE_KERNEL(KTRACE_BLOCK, taskCurrent, KTRACE_ON_MUTEX, mutexIdx);
+        mutexes[mutexIdx].processQueue[mutexes[mutexIdx].queueSize] = taskCurrent; // The processQueue is up to 2 tasks
+        mutexes[mutexIdx].queueSize++;
+    }
+
+    setPendSV(); // Does the task switching
+    return true;
+}
 
-        // Get the size of the memory to allocate from R0
-        uint32_t size = *(getPSP());
-        size = ALIGN_SIZE(size);
+// REQUIRED: modify this function to unlock a mutex using pendsv
+static uint32_t svcUnlock(SVC_FRAME *frame)
+{
+    /*
+        - Only the thread that locked the mutex can unlock it
+    */
+    // R0 represents the mutex
+    uint8_t mutexIdx = frame->r0;
 
-        void *ptr = mallocFromHeap(size);
+    if (mutexIdx >= MAX_MUTEXES)
+        return 0;
 
-        dynamicMemoryOfEachTask[taskCurrent] += size;
+    // If the task that locked the mutex is the one trying to unlock it
+    if (mutexes[mutexIdx].lock && mutexes[mutexIdx].lockedBy == taskCurrent)
+        releaseMutex(mutexIdx);
+    // TBD: else -> delete the thread
 
-        addSramAccessWindow(&tcb[taskCurrent].srd, (uint32_t *)ptr, size);
-        // Apply the current task's SRD bits
-        applySramAccessMask(tcb[taskCurrent].srd);
+    return 0;
+}
+
+// REQUIRED: modify this function to wait a semaphore using pendsv
+static uint32_t svcWait(SVC_FRAME *frame)
+{
+    /*
+        - Decrements the semaphore count and
+          returns if a resource is available.
 
-        // Write the memory allocated to R0
-        *(getPSP()) = (uint32_t)ptr;
+        - If not available marks the task as blocked on a semaphore, and
+          records the task in the semaphore process queue
+    */
 
-        break;
+    // R0 represents the semaphore
+    // False if the semaphore is invalid or its queue is full
+    uint8_t semaphoreIdx = frame->r0;
+
+    if (semaphoreIdx >= MAX_SEMAPHORES)
+        return false;
+
+    if (semaphores[semaphoreIdx].count > 0)
+    {
+        semaphores[semaphoreIdx].count--; // Equivalent to CONSUMING a resource?
     }
-    case SVC_REBOOT:
+    else if (semaphores[semaphoreIdx].queueSize >= MAX_SEMAPHORE_QUEUE_SIZE)
     {
-        NVIC_APINT_R = NVIC_APINT_VECTKEY | NVIC_APINT_SYSRESETREQ;
-        break;
+        return false;
     }
-    case SVC_PS:
+    else
     {
-        // R0: Address to an array of char
-        // R1: Address to an array of uint32_t
-        // R2: Address to an array of uint32_t for the sizes of each task
-        // R3: Pointer to the task count
-        uint32_t *pidsArray = (uint32_t *)*((getPSP()));
-        char(*namesOfTasks)[10] = (char(*)[10]) * (getPSP() + 1);
-        uint32_t *statesArray = (uint32_t *)*((getPSP()) + 2);
-        uint8_t *mutex_semaphore_array = (uint8_t *)*((getPSP()) + 3); // Dereference to access the address of the parameter
+        // Place in the processQueue by setting the index to queueSize
+        semaphores[semaphoreIdx].processQueue[semaphores[semaphoreIdx].queueSize] = taskCurrent;
+        semaphores[semaphoreIdx].queueSize++;
+        tcb[taskCurrent].state = STATE_BLOCKED_SEMAPHORE;
+        tcb[taskCurrent].semaphore = semaphoreIdx;
+        TRACE_KERNEL(KTRACE_BLOCK, taskCurrent, KTRACE_ON_SEMAPHORE, semaphoreIdx);
+        setPendSV();
+    }
+    return true;
+}
 
+// REQUIRED: modify this function to signal a semaphore is available using pendsv
+static uint32_t svcPost(SVC_FRAME *frame)
+{
+    /*
+        Increases the semaphore count.
+        If a process is waiting in the queue, decrement the count and mark the task as ready
+    */
+
+    // R0 represents the semaphore
+    uint8_t semaphoreIdx = frame->r0;
+
+    if (semaphoreIdx >= MAX_SEMAPHORES)
+        return 0;
+
+    // Increment the semaphore count for posting
+    // For that specific semaphore
+    semaphores[semaphoreIdx].count++; // Equivalent to PRODUCING a resource?
+
+    // Check if there are any tasks in the queue
+    if (semaphores[semaphoreIdx].queueSize > 0)
+    {
+        semaphores[semaphoreIdx].count--; // Decrement the count
+
+        // Set the task in the queue as ready
+        wakeTask(semaphores[semaphoreIdx].processQueue[0], KTRACE_BY_POST, semaphoreIdx);
+
+        // Move the tasks in the queue
         uint8_t i;
-        for (i = 0; i < taskCount; i++)
+        for (i = 0; i < semaphores[semaphoreIdx].queueSize - 1; i++)
         {
-            pidsArray[i] = (uint32_t)tcb[i].pid;
-            strCopy(namesOfTasks[i], tcb[i].name);
-            statesArray[i] = tcb[i].state;
-
-            mutex_semaphore_array[i] = tcb[i].mutex != 0 ? tcb[i].mutex : tcb[i].semaphore;
+            semaphores[semaphoreIdx].processQueue[i] = semaphores[semaphoreIdx].processQueue[i + 1];
         }
-        break;
+        semaphores[semaphoreIdx].queueSize--; // Decrement the queue size
     }
-    case SVC_PREEMPT:
+
+    return 0;
+}
+
+static uint32_t svcMalloc(SVC_FRAME *frame)
+{
+    // This function will be called within unprivileged tasks
+
+    // Get the size of the memory to allocate from R0
+    // The allocator rounds it up for the allocation policy in use
+    uint32_t size = frame->r0;
+
+    void *ptr = mallocFromHeap(size, taskCurrent);
+    if (ptr == NULL)
+        return 0;
+
+    // The size actually allocated (e.g. a run of 512 B subregions)
+    size = getAllocationSize(ptr);
+    dynamicMemoryOfEachTask[taskCurrent] += size;
+
+    addSramAccessWindow(&tcb[taskCurrent].srd, (uint32_t *)ptr, size);
+    // Apply the current task's SRD bits
+    applySramAccessMask(tcb[taskCurrent].srd);
+
+    // The pointer goes back to the task in R0
+    return (uint32_t)ptr;
+}
+
+static uint32_t svcFree(SVC_FRAME *frame)
+{
+    // R0: Address returned by malloc_from_heap_wrapper()
+    // Only blocks the calling task allocated can be freed, not its stack
+    void *ptr = (void *)frame->r0;
+    uint32_t size;
+
+    if (getAllocationOwner(ptr) != taskCurrent || (uint32_t)ptr == tcb[taskCurrent].baseAdress || isHandleBlock(ptr))
+        return false;
+
+    size = getAllocationSize(ptr);
+    freeToHeap(ptr);
+    dynamicMemoryOfEachTask[taskCurrent] -= size;
+
+    // Revoke the task's access to the freed subregions
+    removeSramAccessWindow(&tcb[taskCurrent].srd, ptr, size);
+    applySramAccessMask(tcb[taskCurrent].srd);
+    return true;
+}
+
+static uint32_t svcRealloc(SVC_FRAME *frame)
+{
+    // R0: Address returned by malloc_from_heap_wrapper() or NULL, R1: new size
+    // Same rules as malloc (NULL) and free (size 0) otherwise only blocks the
+    // calling task allocated can be resized
+    void *ptr = (void *)frame->r0;
+    uint32_t size = frame->r1;
+    uint32_t oldSize;
+    void *newPtr;
+
+    if (ptr == NULL)
     {
-        bool status = *getPSP();
-        preemption = status;
+        frame->r0 = size;
+        return svcMalloc(frame);
+    }
 
-        break;
+    if (size == 0)
+    {
+        svcFree(frame);
+        return 0;
     }
-    case SVC_SCHED:
+
+    if (getAllocationOwner(ptr) != taskCurrent || (uint32_t)ptr == tcb[taskCurrent].baseAdress || isHandleBlock(ptr))
+        return 0;
+
+    oldSize = getAllocationSize(ptr);
+    newPtr = reallocFromHeap(ptr, size);
+    if (newPtr == NULL)
+        return 0;
+
+    size = getAllocationSize(newPtr);
+    dynamicMemoryOfEachTask[taskCurrent] += size - oldSize;
+
+    // Move the task's window from the old subregions to the new ones
+    removeSramAccessWindow(&tcb[taskCurrent].srd, ptr, oldSize);
+    addSramAccessWindow(&tcb[taskCurrent].srd, newPtr, size);
+    applySramAccessMask(tcb[taskCurrent].srd);
+
+    // The new address goes back to the task in R0
+    return (uint32_t)newPtr;
+}
+
+static uint32_t svcHandleMalloc(SVC_FRAME *frame)
+{
+    // R0: size, the handle goes back in R0 (0 if the heap is full)
+    // The block stays out of the task's window until it is locked
+    HANDLE handle = mallocHandle(frame->r0, taskCurrent);
+
+    if (handle != 0)
+        dynamicMemoryOfEachTask[taskCurrent] += getAllocationSize(getHandle(handle, taskCurrent)->block);
+    return handle;
+}
+
+static uint32_t svcHandleLock(SVC_FRAME *frame)
+{
+    // R0: handle, the address of the block goes back in R0 (NULL if invalid)
+    HANDLE_ENTRY *entry = getHandle(frame->r0, taskCurrent);
+
+    if (entry == NULL || entry->lockCount == 0xFF)
+        return 0;
+
+    // First lock opens the window, the block cannot move until the last unlock
+    if (entry->lockCount++ == 0)
     {
-        bool prio_status = *(getPSP());
+        addSramAccessWindow(&tcb[taskCurrent].srd, entry->block, getAllocationSize(entry->block));
+        applySramAccessMask(tcb[taskCurrent].srd);
+    }
+    return (uint32_t)entry->block;
+}
+
+static uint32_t svcHandleUnlock(SVC_FRAME *frame)
+{
+    // R0: handle
+    HANDLE_ENTRY *entry = getHandle(frame->r0, taskCurrent);
 
-        // Set the priority scheduler
-        priorityScheduler = prio_status;
+    if (entry == NULL || entry->lockCount == 0)
+        return false;
 
-        break;
+    // Last unlock closes the window, the block may move from now on
+    if (--entry->lockCount == 0)
+    {
+        removeSramAccessWindow(&tcb[taskCurrent].srd, entry->block, getAllocationSize(entry->block));
+        applySramAccessMask(tcb[taskCurrent].srd);
     }
-    case SVC_PIDOF:
+    return true;
+}
+
+static uint32_t svcHandleFree(SVC_FRAME *frame)
+{
+    // R0: handle, locked or not
+    HANDLE_ENTRY *entry = getHandle(frame->r0, taskCurrent);
+    uint32_t size;
+
+    if (entry == NULL)
+        return false;
+
+    size = getAllocationSize(entry->block);
+    if (entry->lockCount != 0)
     {
-        // R0: Process name
-        // R1: Address to a uint32_t variable
-        uint8_t i;
-        for (i = 0; i < taskCount; i++)
-        {
-            if (strCmp(tcb[i].name, (char *)*(getPSP())))
-            {
-                // Write to R1 the PID of the task
-                uint32_t *psp = getPSP(); // Getting R0. const char []
-                uint32_t *r1 = (psp + 1); // Getting R1. address of uint32_t
+        removeSramAccessWindow(&tcb[taskCurrent].srd, entry->block, size);
+        applySramAccessMask(tcb[taskCurrent].srd);
+    }
 
-                uint32_t *pid = (uint32_t *)*r1; // Dereferencing R1 to access the address of the parameter and casting to pointer type
-                *pid = (uint32_t)tcb[i].pid;     // Dereferencing the adress to store the value
+    dynamicMemoryOfEachTask[taskCurrent] -= size;
+    freeHandle(frame->r0);
+    return true;
+}
 
-                break;
-            }
-        }
-        break;
+static uint32_t svcCompact(SVC_FRAME *frame)
+{
+    // Moves at most one unlocked handle block, true if one moved
+    return compactHeapStep();
+}
+
+static uint32_t svcCycleCount(SVC_FRAME *frame)
+{
+    // The cycle count goes back to the task in R0
+    return readCycleCounter();
+}
+
+static uint32_t svcResetWakeStats(SVC_FRAME *frame)
+{
+    // Starts a new measurement window for the wake-up counters of every task
+    uint8_t i;
+
+    for (i = 0; i < taskCount; i++)
+    {
+        tcb[i].wakeups = 0;
+        tcb[i].wakeLatencyMax = 0;
+        tcb[i].wakeLatencyTotal = 0;
     }
-    case SVC_MEMINFO:
+    return 0;
+}
+
+static uint32_t svcHeapMap(SVC_FRAME *frame)
+{
+    // R0: Address of the HEAP_MAP to fill
+    HEAP_MAP *map = (HEAP_MAP *)frame->r0;
+
+    if (isTaskWritable(map, sizeof(HEAP_MAP)))
+        readHeapMap(map);
+    return 0;
+}
+
+static uint32_t svcHeapTrace(SVC_FRAME *frame)
+{
+    // R0: Address of the records, R1: number of records, R2: address of the dropped count
+    HEAP_TRACE_RECORD *records = (HEAP_TRACE_RECORD *)frame->r0;
+    uint32_t count = frame->r1;
+    uint32_t *dropped = (uint32_t *)frame->r2;
+
+    if (count > HEAP_TRACE_SIZE || !isTaskWritable(records, count * sizeof(HEAP_TRACE_RECORD)) ||
+        !isTaskWritable(dropped, sizeof(uint32_t)))
+        return 0;
+    return readHeapTrace(records, count, dropped);
+}
+
+static uint32_t svcTraceControl(SVC_FRAME *frame)
+{
+    // R0: KTRACE_MASK() of the events to record, 0 stops
+    // false goes back without KERNEL_TRACE
+#ifdef KERNEL_TRACE
+    if (frame->r0 != 0)
     {
-        // R0: Address to an array of char
-        // R1: Address to an array of uint32_t
-        // R2: Address to an array of uint32_t for the sizes of each task
-        // R3: Pointer to the task count
-        // Let shell know how many tasks are running i.e. taskCount (global variable in kernel.c)
+        kernelTraceNext = 0;
+        kernelTraceCount = 0;
+        kernelTraceDropped = 0;
+    }
+    kernelTraceMask = frame->r0;
+    return true;
+#else
+    return false;
+#endif
+}
 
-        char(*namesOfTasks)[10] = (char(*)[10]) * (getPSP());
-        uint32_t *baseAddress = (uint32_t *)*((getPSP()) + 1);
-        uint32_t *sizeOfTask = (uint32_t *)*((getPSP()) + 2);
-        uint8_t *taskCountToShell = (uint8_t *)*((getPSP()) + 3); // Dereference to access the address of the parameter
-        uint32_t *dynamicMemOfEachTask = (uint32_t *)(*(getPSP()) - MAX_TASKS * 4);
-        uint8_t i;
-        for (i = 0; i < taskCount; i++)
-        {
-            strCopy(namesOfTasks[i], tcb[i].name);
-            baseAddress[i] = (uint32_t)tcb[i].baseAdress;
-            sizeOfTask[i] = tcb[i].sizeOfStack;
-            dynamicMemOfEachTask[i] = dynamicMemoryOfEachTask[i] != 0 ? dynamicMemoryOfEachTask[i] : 0;
-        }
-        *taskCountToShell = taskCount;
-        break;
+static uint32_t svcKernelTrace(SVC_FRAME *frame)
+{
+    // R0: Address of the records, R1: number of records, R2: address of the dropped count
+    // The number of records copied goes back in R0, oldest first
+    KTRACE_RECORD *records = (KTRACE_RECORD *)frame->r0;
+    uint32_t count = frame->r1;
+    uint32_t *dropped = (uint32_t *)frame->r2;
+    uint32_t copied = 0;
+
+    if (count > KTRACE_SIZE || !isTaskWritable(records, count * sizeof(KTRACE_RECORD)) ||
+        !isTaskWritable(dropped, sizeof(uint32_t)))
+        return 0;
+
+    *dropped = 0;
+#ifdef KERNEL_TRACE
+    *dropped = kernelTraceDropped;
+    kernelTraceDropped = 0;
+    while (copied < count && kernelTraceCount > 0)
+    {
+        records[copied++] = kernelTrace[(kernelTraceNext + KTRACE_SIZE - kernelTraceCount) % KTRACE_SIZE];
+        kernelTraceCount--;
     }
-    case SVC_GET_PROCESSES:
+#endif
+    return copied;
+}
+
+static uint32_t svcAllocPolicy(SVC_FRAME *frame)
+{
+    // R0: ALLOC_ policy, false goes back if it does not exist
+    return setAllocationPolicy(frame->r0);
+}
+
+static uint32_t svcReboot(SVC_FRAME *frame)
+{
+    NVIC_APINT_R = NVIC_APINT_VECTKEY | NVIC_APINT_SYSRESETREQ;
+    return 0;
+}
+
+static uint32_t svcPs(SVC_FRAME *frame)
+{
+    // R0: Address to an array of uint32_t for the PIDs
+    // R1: Address to an array of char for the names
+    // R2: Address to an array of uint32_t for the states
+    // R3: Address to an array of uint8_t for the mutex or semaphore
+    uint32_t *pidsArray = (uint32_t *)frame->r0;
+    char(*namesOfTasks)[10] = (char(*)[10])frame->r1;
+    uint32_t *statesArray = (uint32_t *)frame->r2;
+    uint8_t *mutex_semaphore_array = (uint8_t *)frame->r3;
+
+    if (!isTaskWritable(pidsArray, MAX_TASKS * sizeof(uint32_t)) ||
+        !isTaskWritable(namesOfTasks, MAX_TASKS * 10) ||
+        !isTaskWritable(statesArray, MAX_TASKS * sizeof(uint32_t)) ||
+        !isTaskWritable(mutex_semaphore_array, MAX_TASKS))
+        return 0;
+
+    uint8_t i;
+    for (i = 0; i < taskCount; i++)
     {
-        // R0: Address to an array of char
-        char(*namesOfTasks)[10] = (char(*)[10]) * (getPSP());
-        // R1: Pointer to the current task count
-        // Dereference to access the address of the parameter
-        // and recast to uint32_t pointer type to store the value
-        uint32_t *taskCountToShell = (uint32_t *)*((getPSP()) + 1);
+        pidsArray[i] = (uint32_t)tcb[i].pid;
+        strCopy(namesOfTasks[i], tcb[i].name);
+        statesArray[i] = tcb[i].state;
 
-        *taskCountToShell = taskCount;
+        mutex_semaphore_array[i] = tcb[i].mutex != 0 ? tcb[i].mutex : tcb[i].semaphore;
+    }
+    return 0;
+}
 
-        uint8_t i;
-        for (i = 0; i < taskCount; i++)
+static uint32_t svcPreempt(SVC_FRAME *frame)
+{
+    preemption = frame->r0;
+    return 0;
+}
+
+static uint32_t svcSched(SVC_FRAME *frame)
+{
+    // Set the priority scheduler
+    priorityScheduler = frame->r0;
+    return 0;
+}
+
+static uint32_t svcPidof(SVC_FRAME *frame)
+{
+    // R0: Process name
+    // The PID goes back to the task in R0, 0 if not found
+    const char *name = (const char *)frame->r0;
+    uint8_t i;
+
+    if (!isTaskString(name, sizeof(tcb[0].name)))
+        return 0;
+
+    for (i = 0; i < taskCount; i++)
+    {
+        if (strCmp(tcb[i].name, name))
+            return (uint32_t)tcb[i].pid;
+    }
+    return 0;
+}
+
+static uint32_t svcMeminfo(SVC_FRAME *frame)
+{
+    // R0: Address to an array of char
+    // R1: Address to an array of uint32_t for the base addresses
+    // R2: Address to an array of uint32_t for the sizes of each task
+    // R3: Address to an array of uint32_t for the dynamic memory of each task
+    // The task count goes back to the shell in R0
+    char(*namesOfTasks)[10] = (char(*)[10])frame->r0;
+    uint32_t *baseAddress = (uint32_t *)frame->r1;
+    uint32_t *sizeOfTask = (uint32_t *)frame->r2;
+    uint32_t *dynamicMemOfEachTask = (uint32_t *)frame->r3;
+
+    if (!isTaskWritable(namesOfTasks, MAX_TASKS * 10) ||
+        !isTaskWritable(baseAddress, MAX_TASKS * sizeof(uint32_t)) ||
+        !isTaskWritable(sizeOfTask, MAX_TASKS * sizeof(uint32_t)) ||
+        !isTaskWritable(dynamicMemOfEachTask, MAX_TASKS * sizeof(uint32_t)))
+        return 0;
+
+    uint8_t i;
+    for (i = 0; i < taskCount; i++)
+    {
+        strCopy(namesOfTasks[i], tcb[i].name);
+        baseAddress[i] = (uint32_t)tcb[i].baseAdress;
+        sizeOfTask[i] = tcb[i].sizeOfStack;
+        dynamicMemOfEachTask[i] = dynamicMemoryOfEachTask[i];
+    }
+    return taskCount;
+}
+
+static uint32_t svcGetProcesses(SVC_FRAME *frame)
+{
+    // R0: Address to an array of char
+    // The task count goes back to the shell in R0
+    char(*namesOfTasks)[10] = (char(*)[10])frame->r0;
+
+    if (!isTaskWritable(namesOfTasks, MAX_TASKS * 10))
+        return 0;
+
+    uint8_t i;
+    for (i = 0; i < taskCount; i++)
+    {
+        strCopy(namesOfTasks[i], tcb[i].name);
+    }
+    return taskCount;
+}
+
+static uint32_t svcTelemetry(SVC_FRAME *frame)
+{
+    // R0: Address of the TELEMETRY_SNAPSHOT to fill
+    TELEMETRY_SNAPSHOT *snapshot = (TELEMETRY_SNAPSHOT *)frame->r0;
+    uint8_t i, j;
+
+    if (!isTaskWritable(snapshot, sizeof(TELEMETRY_SNAPSHOT)))
+        return 0;
+
+    snapshot->systemTicks = systemTicks;
+    snapshot->taskCount = taskCount;
+    for (i = 0; i < taskCount; i++)
+    {
+        snapshot->tasks[i].pid = (uint32_t)tcb[i].pid;
+        snapshot->tasks[i].cpuTicks = tcb[i].cpuTicks;
+        snapshot->tasks[i].state = tcb[i].state;
+        snapshot->tasks[i].priority = tcb[i].priority;
+        snapshot->tasks[i].currentPriority = tcb[i].currentPriority;
+        snapshot->tasks[i].blockedOn = tcb[i].state == STATE_BLOCKED_MUTEX ? tcb[i].mutex : tcb[i].semaphore;
+        strCopy(snapshot->tasks[i].name, tcb[i].name);
+    }
+
+    getHeapBitmap(snapshot->heapBitmap);
+
+    for (i = 0; i < MAX_MUTEXES; i++)
+    {
+        snapshot->mutexes[i].lock = mutexes[i].lock;
+        snapshot->mutexes[i].lockedBy = mutexes[i].lockedBy;
+        snapshot->mutexes[i].queueSize = mutexes[i].queueSize;
+        for (j = 0; j < MAX_MUTEX_QUEUE_SIZE; j++)
+            snapshot->mutexes[i].processQueue[j] = mutexes[i].processQueue[j];
+    }
+
+    for (i = 0; i < MAX_SEMAPHORES; i++)
+    {
+        snapshot->semaphores[i].count = semaphores[i].count;
+        snapshot->semaphores[i].queueSize = semaphores[i].queueSize;
+        for (j = 0; j < MAX_SEMAPHORE_QUEUE_SIZE; j++)
+            snapshot->semaphores[i].processQueue[j] = semaphores[i].processQueue[j];
+    }
+    return 0;
+}
+
+static uint32_t svcBatch(SVC_FRAME *frame)
+{
+    // R0: Address of the SYSCALL_RECORD array
+    // R1: Number of records
+    // The number of records executed goes back to the task in R0
+    SYSCALL_RECORD *records = (SYSCALL_RECORD *)frame->r0;
+    uint32_t count = frame->r1;
+    SVC_FRAME opFrame = {0};
+    uint32_t i;
+
+    if (count > MAX_BATCH_OPS || !isTaskWritable(records, count * sizeof(SYSCALL_RECORD)))
+        return 0;
+
+    for (i = 0; i < count; i++)
+    {
+        uint32_t op = records[i].op;
+
+        if (op >= NUM_SVCS || op == SVC_START_R || op == SVC_BATCH || svcTable[op] == NULL)
         {
-            strCopy(namesOfTasks[i], tcb[i].name);
+            records[i].result = 0;
+            continue;
         }
-        break;
-    }
+
+        // Same view of the arguments as the single call
+        opFrame.r0 = records[i].args[0];
+        opFrame.r1 = records[i].args[1];
+        opFrame.r2 = records[i].args[2];
+        opFrame.r3 = records[i].args[3];
+        opFrame.r12 = op;
+        TRACE_KERNEL(KTRACE_SVC, taskCurrent, op, 0);
+        records[i].result = svcTable[op](&opFrame);
+
+        // A blocked or sleeping task must not keep issuing calls
+        if (tcb[taskCurrent].state != STATE_READY)
+            return i + 1;
     }
+    return count;
+}
+
+/**
+ * @brief
+ * Runs the handler for the service number in the stacked R12
+ * and returns its result in the stacked R0.
+ * Kept apart from svCallIsr() so it does not depend on how the frame was found
+ */
+void svcDispatch(SVC_FRAME *frame)
+{
+    uint32_t svcNum = frame->r12;
+
+    // Draining the trace is not traced, it would refill the ring as it empties
+    if (svcNum != SVC_KERNEL_TRACE)
+        TRACE_KERNEL(KTRACE_SVC, taskCurrent, svcNum, 0);
+
+    if (svcNum < NUM_SVCS && svcTable[svcNum] != NULL)
+        frame->r0 = svcTable[svcNum](frame);
+    else
+        frame->r0 = 0;
+}
+
+// REQUIRED: in preemptive code, add code to handle synchronization primitives
+void svCallIsr(void)
+{
+    /*
+        Is an exception that is triggered by the SVC instruction.
+        In an OS environment applications can use SVC instructions to
+        access kernel functions and device drivers
+
+        *  Page 106 ARM Optimizing C/C++ Compiler User Guide:
+           Cortex-M architecutres, C SWI handlers cannot return values.
+           Results are written to the stacked R0 instead (see syscalls.h)
+    */
+    svcDispatch((SVC_FRAME *)getPSP());
 }
 
 void *getPID(void)
@@ -870,6 +1565,64 @@ void *getPID(void)
     return tcb[taskCurrent].pid;
 }
 
+/**
+ * @brief
+ * Copies the kernel state into the statistics page.
+ * Called from the systick ISR, it is the only writer of the page
+ */
+void updateKernelStats(void)
+{
+    volatile KSTATS *stats = &kernelStats.stats;
+    uint8_t i, j;
+
+    stats->sequence++; // Odd: update in progress
+
+    stats->systemTicks = systemTicks;
+    stats->taskCount = taskCount;
+    stats->priorityScheduler = priorityScheduler;
+    stats->preemption = preemption;
+    stats->priorityInheritance = priorityInheritance;
+    getHeapBitmap((uint8_t *)stats->heapBitmap);
+
+    for (i = 0; i < taskCount; i++)
+    {
+        stats->tasks[i].pid = (uint32_t)tcb[i].pid;
+        stats->tasks[i].cpuTicks = tcb[i].cpuTicks;
+        stats->tasks[i].stackBase = tcb[i].baseAdress;
+        stats->tasks[i].stackSize = tcb[i].sizeOfStack;
+        stats->tasks[i].dynamicMemory = dynamicMemoryOfEachTask[i];
+        stats->tasks[i].wakeups = tcb[i].wakeups;
+        stats->tasks[i].wakeLatencyMax = tcb[i].wakeLatencyMax;
+        stats->tasks[i].wakeLatencyAvg = tcb[i].wakeups ? tcb[i].wakeLatencyTotal / tcb[i].wakeups : 0;
+        stats->tasks[i].arg = tcb[i].arg;
+        stats->tasks[i].state = tcb[i].state;
+        stats->tasks[i].priority = tcb[i].priority;
+        stats->tasks[i].currentPriority = tcb[i].currentPriority;
+        stats->tasks[i].blockedOn = tcb[i].state == STATE_BLOCKED_MUTEX ? tcb[i].mutex : tcb[i].semaphore;
+        for (j = 0; j < sizeof(stats->tasks[i].name); j++)
+            stats->tasks[i].name[j] = tcb[i].name[j];
+    }
+
+    stats->sequence++; // Even: page is consistent
+}
+
+/**
+ * @brief
+ * Takes a consistent copy of the statistics page.
+ * Runs in the calling task without a service call, it retries when
+ * the systick ISR updated the page while it was being copied
+ */
+void readKernelStats(KSTATS *stats)
+{
+    uint32_t sequence;
+
+    do
+    {
+        sequence = kernelStats.stats.sequence;
+        *stats = kernelStats.stats;
+    } while ((sequence & 1) || sequence != kernelStats.stats.sequence);
+}
+
 //-----------------------------------------------------------------------------
 // Glossary
 //-----------------------------------------------------------------------------
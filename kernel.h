@@ -25,20 +25,71 @@
 // function pointer
 typedef void (*_fn)();  // Returns void, pointer to function, no parameters
 
-// mutex
-#define MAX_MUTEXES 1
+// relocatable heap block, see mm.h
+typedef uint32_t HANDLE;
+
+// thread created at run time with spawnThread(), the function receives arg
+// as its first parameter e.g. void worker(uint32_t arg)
+typedef struct _THREAD_SPEC
+{
+    _fn fn;
+    const char *name; // at most MAX_SPAWN_NAME characters
+    uint32_t stackBytes;
+    uint32_t arg;
+    uint8_t priority;
+} THREAD_SPEC;
+#define MAX_SPAWN_NAME 9 // ps(), meminfo() and getListOfProcesses() copy the names into 10 byte slots
+
+// mutex, the bench and stress objects are only built with BENCH and STRESS defined
 #define MAX_MUTEX_QUEUE_SIZE 2
 #define resource 0
+#ifdef BENCH
+#define benchMutex 1 // bench.c
+#define BENCH_MUTEXES 1
+#else
+#define BENCH_MUTEXES 0
+#endif
+#ifdef STRESS
+#define stressMutex (1 + BENCH_MUTEXES) // stress.c
+#define STRESS_MUTEXES 1
+#else
+#define STRESS_MUTEXES 0
+#endif
+#define MAX_MUTEXES (1 + BENCH_MUTEXES + STRESS_MUTEXES)
 
 // semaphore
-#define MAX_SEMAPHORES 3
 #define MAX_SEMAPHORE_QUEUE_SIZE 2
 #define keyPressed 0
 #define keyReleased 1
 #define flashReq 2
+#ifdef BENCH
+#define benchPing 3  // bench.c
+#define benchPong 4
+#define benchHold 5
+#define benchSwitch 6
+#define BENCH_SEMAPHORES 4
+#else
+#define BENCH_SEMAPHORES 0
+#endif
+#ifdef STRESS
+#define stressChain (3 + BENCH_SEMAPHORES) // stress.c, request and acknowledge of each chain
+#define stressFail (stressChain + 4)
+#define STRESS_SEMAPHORES 5
+#else
+#define STRESS_SEMAPHORES 0
+#endif
+#define MAX_SEMAPHORES (3 + BENCH_SEMAPHORES + STRESS_SEMAPHORES)
 
 // tasks
-#define MAX_TASKS 12
+#define MAX_TASKS 15 // The priority rings of rtosScheduler() hold 4 bit indices, 0xF means empty
+
+// task states
+#define STATE_INVALID 0           // no task
+#define STATE_STOPPED 1           // stopped, all memory freed
+#define STATE_READY 2             // has run, can resume at any time
+#define STATE_DELAYED 3           // has run, but now awaiting timer
+#define STATE_BLOCKED_MUTEX 4     // has run, but now blocked by semaphore
+#define STATE_BLOCKED_SEMAPHORE 5 // has run, but now blocked by semaphore
 
 // control
 #define PREEMPTIVE 1
@@ -57,15 +108,16 @@ void initRtos(void);
 void startRtos(void);
 
 bool createThread(_fn fn, const char name[], uint8_t priority, uint32_t stackBytes);
+bool spawnThread(const THREAD_SPEC *spec);
 void restartThread(_fn fn);
-void stopThread(_fn fn);
+bool stopThread(_fn fn);
 void setThreadPriority(_fn fn, uint8_t priority);
 
 void yield(void);
 void sleep(uint32_t tick);
-void lock(int8_t mutex);
+bool lock(int8_t mutex);
 void unlock(int8_t mutex);
-void wait(int8_t semaphore);
+bool wait(int8_t semaphore);
 void post(int8_t semaphore);
 
 void systickIsr(void);
@@ -77,6 +129,18 @@ void svCallIsr(void);   // This function takes care of the SVC calls
 //-----------------------------------------------------------------------------
 void launchTask(void);
 void *malloc_from_heap_wrapper(uint32_t size);
+bool free_to_heap_wrapper(void *pMemory);
+void *realloc_from_heap_wrapper(void *pMemory, uint32_t size);
+HANDLE hmalloc(uint32_t size);
+void *hlock(HANDLE handle);
+bool hunlock(HANDLE handle);
+bool hfree(HANDLE handle);
+bool compactHeap(void);
+uint32_t getCycleCount(void);
+void resetWakeStats(void);
 void* getPID(void);
+bool isTaskWritable(const void *address, uint32_t size);
+bool isTaskReadable(const void *address, uint32_t size);
+bool isTaskString(const char *str, uint32_t maxLength);
 
 #endif
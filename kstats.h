@@ -0,0 +1,87 @@
+// Kernel statistics page
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target uC:       TM4C123GH6PM
+// System Clock:    40 MHz
+
+#ifndef KSTATS_H_
+#define KSTATS_H_
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "kernel.h"
+#include "mm.h"
+
+/*
+    The kernel copies its task and heap state into kernelStats on every
+    systick. The page lives in its own 1 KiB aligned section (.kstats), the
+    linker command file puts it in the last 1 KiB of the OS SRAM so the
+    alignment costs no padding. MPU region 7 maps it RW for privileged code
+    and read only for tasks, so any task can read it without a service call.
+
+    The page is protected with a sequence counter (seqlock):
+    - the writer makes sequence odd, updates the page, then makes it even
+    - readKernelStats() copies the page and retries if sequence was odd
+      or changed while it was copying
+
+    Task code must use readKernelStats() rather than reading fields directly,
+    otherwise fields may come from different ticks.
+*/
+#define KSTATS_PAGE_SIZE 1024   // MPU region size and alignment of the page
+#define KSTATS_REGION_SIZE 9    // 2^(9 + 1) = 1 KiB
+#define KSTATS_REGION_IDX 7
+
+typedef struct _KSTATS_TASK
+{
+    uint32_t pid;
+    uint32_t cpuTicks;      // systick interrupts that landed while the task was running
+    uint32_t stackBase;
+    uint32_t stackSize;
+    uint32_t dynamicMemory; // bytes allocated with malloc_from_heap_wrapper
+    uint32_t wakeups;       // times it was dispatched after a tick, post or unlock made it ready
+    uint32_t wakeLatencyMax; // cycles it then waited for the processor
+    uint32_t wakeLatencyAvg; // cycles, the average
+    uint32_t arg;           // argument of the task function, see spawnThread()
+    uint8_t state;
+    uint8_t priority;
+    uint8_t currentPriority;
+    uint8_t blockedOn;      // index of the mutex or semaphore
+    char name[16];
+} KSTATS_TASK;
+
+typedef struct _KSTATS
+{
+    uint32_t sequence;      // odd while the kernel is updating the page
+    uint32_t systemTicks;
+    uint8_t taskCount;
+    bool priorityScheduler;
+    bool preemption;
+    bool priorityInheritance;
+    uint8_t heapBitmap[NUM_SRAM_REGIONS]; // bit set = subregion allocated
+    KSTATS_TASK tasks[MAX_TASKS];
+} KSTATS;
+
+// Padded to the MPU region so nothing else shares the read only aperture
+typedef union _KSTATS_PAGE
+{
+    KSTATS stats;
+    uint8_t page[KSTATS_PAGE_SIZE];
+} KSTATS_PAGE;
+
+extern volatile KSTATS_PAGE kernelStats;
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+void updateKernelStats(void);
+void readKernelStats(KSTATS *stats);
+
+#endif
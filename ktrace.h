@@ -0,0 +1,88 @@
+// Kernel trace
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target uC:       TM4C123GH6PM
+// System Clock:    40 MHz
+
+#ifndef KTRACE_H_
+#define KTRACE_H_
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+    Kernel trace, built in with KERNEL_TRACE defined
+
+    The kernel adds a timestamped record to a ring of the last KTRACE_SIZE
+    events: task switches (pendSvIsr()), service calls (svCallIsr(), each op
+    of a batch too), blocking and wake-ups, ticks (systickIsr()) and faults.
+    traceControl(mask) empties the ring and records the event classes in mask
+    from then on, 0 stops recording and keeps the ring. getKernelTrace()
+    drains it oldest first. The shell's trace command prints it as text and
+    tools/ktrace_export.py turns that into Chrome trace / Perfetto JSON.
+
+    No lock: the writers are the SVCall, SysTick, PendSV and fault handlers,
+    which all run at the reset priority and cannot preempt each other (a
+    fault inside one escalates to the hard fault, which does not return),
+    and the reader is a service call. A record is 8 bytes, the timestamp is
+    the cycle count of getCycleCount().
+*/
+#define KTRACE_SIZE 32 // 256 B of the 4 KiB of OS SRAM (see mm.h)
+
+// Events, record fields:     task                    arg                 detail
+#define KTRACE_SWITCH 1    // task switched in        task switched out   -
+#define KTRACE_BLOCK 2     // task that blocked       KTRACE_ON_ reason   mutex or semaphore
+#define KTRACE_WAKE 3      // task made ready         KTRACE_BY_ source   mutex or semaphore
+#define KTRACE_SVC 4       // caller                  service number      -
+#define KTRACE_TICK 5      // task interrupted        -                   -
+#define KTRACE_FAULT 6     // task that faulted       KTRACE_FAULT_ kind  -
+
+// Mask of traceControl(), one bit per event
+#define KTRACE_MASK(event) (1 << (event))
+#define KTRACE_DEFAULT_MASK (KTRACE_MASK(KTRACE_SWITCH) | KTRACE_MASK(KTRACE_BLOCK) | KTRACE_MASK(KTRACE_WAKE) | \
+                             KTRACE_MASK(KTRACE_SVC) | KTRACE_MASK(KTRACE_FAULT)) // Ticks fill the ring in KTRACE_SIZE ms
+
+// Block reasons
+#define KTRACE_ON_SLEEP 1
+#define KTRACE_ON_MUTEX 2
+#define KTRACE_ON_SEMAPHORE 3
+#define KTRACE_ON_STOP 4
+
+// Wake-up sources
+#define KTRACE_BY_TICK 1
+#define KTRACE_BY_UNLOCK 2
+#define KTRACE_BY_POST 3
+#define KTRACE_BY_RESTART 4
+
+// Faults
+#define KTRACE_FAULT_MPU 1
+#define KTRACE_FAULT_HARD 2
+#define KTRACE_FAULT_BUS 3
+#define KTRACE_FAULT_USAGE 4
+
+typedef struct _KTRACE_RECORD
+{
+    uint32_t time; // cycle count
+    uint8_t event;
+    uint8_t task;  // tcb index
+    uint8_t arg;
+    uint8_t detail;
+} KTRACE_RECORD;
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+void traceFault(uint8_t fault);
+
+bool traceControl(uint8_t mask);
+uint32_t getKernelTrace(KTRACE_RECORD *records, uint32_t count, uint32_t *dropped);
+
+#endif
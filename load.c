@@ -0,0 +1,483 @@
+// Load injection functions
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target uC:       TM4C123GH6PM
+// System Clock:    40 MHz
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#include <stdint.h>
+#include "hal.h"
+#include "load.h"
+#include "uart0.h"
+#include "shell_commands.h"
+#include "kstats.h"
+
+#define LOAD_CYCLES_PER_MS (SYSTEM_CLOCK_HZ / 1000)
+#define LOAD_CYCLES_PER_US (SYSTEM_CLOCK_HZ / 1000000)
+#define LOAD_MAX_PRIORITY 15
+#define LOAD_MAX_DIGITS 6
+
+// Task names by kind, the slot number is appended
+static const char *const loadTaskNames[] = {"", "Cpu", "Lock", "Alloc"};
+
+// One task function per slot, the kernel tells tasks apart by function
+void loadWorker0(uint32_t arg);
+void loadWorker1(uint32_t arg);
+void loadWorker2(uint32_t arg);
+void loadWorker3(uint32_t arg);
+
+static const _fn loadWorkers[LOAD_MAX_TASKS] = {
+    loadWorker0, loadWorker1, loadWorker2, loadWorker3,
+};
+
+//-----------------------------------------------------------------------------
+// Load tasks
+//-----------------------------------------------------------------------------
+
+/**
+ * @brief
+ * True if cycle count a comes before b, across a wrap of the counter
+ */
+static bool before(uint32_t a, uint32_t b)
+{
+    return (int32_t)(a - b) < 0;
+}
+
+/**
+ * @brief
+ * Sleeps until the cycle count reaches time, returns at once if it has
+ */
+static void sleepUntil(uint32_t time)
+{
+    uint32_t now = getCycleCount();
+
+    if (before(now, time))
+        sleep((time - now + LOAD_CYCLES_PER_MS - 1) / LOAD_CYCLES_PER_MS);
+}
+
+/**
+ * @brief
+ * Keeps the processor until the cycle count reaches time
+ */
+static void busyUntil(uint32_t time)
+{
+    while (before(getCycleCount(), time));
+}
+
+/**
+ * @brief
+ * Body of every load task, arg is its LOAD_ARG. Never returns, the shell
+ * stops the task
+ */
+static void loadRun(uint32_t arg)
+{
+    void *blocks[LOAD_ALLOC_BLOCKS] = {NULL};
+    uint32_t period, work, release, now;
+    uint8_t oldest = 0;
+
+    switch (LOAD_KIND(arg))
+    {
+    case LOAD_CPU:
+        period = LOAD_A(arg) * LOAD_CYCLES_PER_MS;
+        work = period / 100 * LOAD_B(arg);
+        break;
+    case LOAD_LOCK:
+        period = LOAD_A(arg) * LOAD_CYCLES_PER_MS;
+        work = LOAD_B(arg) * LOAD_CYCLES_PER_MS;
+        break;
+    default:
+        period = SYSTEM_CLOCK_HZ / LOAD_A(arg);
+        work = 0;
+        break;
+    }
+
+    release = getCycleCount();
+    while (true)
+    {
+        sleepUntil(release);
+        switch (LOAD_KIND(arg))
+        {
+        case LOAD_CPU:
+            // Wall time, the share is smaller when higher priorities preempt it
+            busyUntil(release + work);
+            break;
+        case LOAD_LOCK:
+            // A full wait queue fails the lock, the job is skipped
+            if (lock(LOAD_MUTEX(arg)))
+            {
+                busyUntil(getCycleCount() + work);
+                unlock(LOAD_MUTEX(arg));
+            }
+            break;
+        case LOAD_ALLOC:
+            if (blocks[oldest] != NULL)
+                free_to_heap_wrapper(blocks[oldest]);
+            blocks[oldest] = malloc_from_heap_wrapper(LOAD_B(arg));
+            oldest = (oldest + 1) % LOAD_ALLOC_BLOCKS;
+            break;
+        }
+
+        // Releases whose whole period went by during the job are skipped
+        release += period;
+        now = getCycleCount();
+        while (!before(now, release + period))
+            release += period;
+    }
+}
+
+void loadWorker0(uint32_t arg) { loadRun(arg); }
+void loadWorker1(uint32_t arg) { loadRun(arg); }
+void loadWorker2(uint32_t arg) { loadRun(arg); }
+void loadWorker3(uint32_t arg) { loadRun(arg); }
+
+//-----------------------------------------------------------------------------
+// Shell command
+//-----------------------------------------------------------------------------
+
+/**
+ * @brief
+ * Reads a decimal number followed by unit or by nothing, e.g. "5ms"
+ *
+ * @return False if field is missing or is not such a number
+ */
+static bool parseValue(const char *field, const char unit[], uint32_t *value)
+{
+    const char *c = field;
+    uint32_t n = 0;
+
+    if (field == NULL)
+        return false;
+    while (*c >= ASCII_0 && *c <= ASCII_9 && c - field < LOAD_MAX_DIGITS)
+        n = n * 10 + *c++ - ASCII_0;
+    if (c == field || (*c != '\0' && !strCmp(c, unit)))
+        return false;
+    *value = n;
+    return true;
+}
+
+/**
+ * @brief
+ * Reads the options from field first on: "prio <p>" and, when period is
+ * not NULL, "every <period>ms"
+ */
+static bool parseOptions(USER_DATA *data, uint8_t first, uint32_t *period, uint8_t *priority)
+{
+    uint32_t value;
+    char *option;
+    uint8_t i;
+
+    for (i = first; i < data->fieldCount; i += 2)
+    {
+        option = getFieldString(data, i);
+        if (strCmp(option, "prio") && parseValue(getFieldString(data, i + 1), "", &value) && value <= LOAD_MAX_PRIORITY)
+            *priority = value;
+        else if (period != NULL && strCmp(option, "every") && parseValue(getFieldString(data, i + 1), "ms", &value))
+            *period = value;
+        else
+            return false;
+    }
+    return true;
+}
+
+/**
+ * @brief
+ * Index of the task of a load slot in the statistics, -1 if it was never started
+ */
+static int8_t findLoad(const KSTATS *stats, uint8_t slot)
+{
+    uint8_t i;
+
+    for (i = 0; i < stats->taskCount; i++)
+    {
+        if (stats->tasks[i].pid == (uint32_t)loadWorkers[slot])
+            return i;
+    }
+    return -1;
+}
+
+static bool isRunning(const KSTATS *stats, int8_t task)
+{
+    return task >= 0 && stats->tasks[task].state != STATE_STOPPED;
+}
+
+/**
+ * @brief
+ * Prints what a load does, e.g. "lock resource 5ms every 50ms"
+ */
+static void putLoad(uint32_t arg)
+{
+    switch (LOAD_KIND(arg))
+    {
+    case LOAD_CPU:
+        putsUart0("cpu ");
+        putPadded(LOAD_B(arg), 0);
+        putsUart0("% of every ");
+        putPadded(LOAD_A(arg), 0);
+        putsUart0("ms");
+        break;
+    case LOAD_LOCK:
+        putsUart0("lock ");
+        if (LOAD_MUTEX(arg) == resource)
+            putsUart0("resource");
+        else
+            putPadded(LOAD_MUTEX(arg), 0);
+        putcUart0(' ');
+        putPadded(LOAD_B(arg), 0);
+        putsUart0("ms every ");
+        putPadded(LOAD_A(arg), 0);
+        putsUart0("ms");
+        break;
+    case LOAD_ALLOC:
+        putsUart0("alloc ");
+        putPadded(LOAD_B(arg), 0);
+        putsUart0(" bytes ");
+        putPadded(LOAD_A(arg), 0);
+        putsUart0("/s");
+        break;
+    }
+}
+
+static void listLoads(void)
+{
+    KSTATS stats;
+    int8_t task;
+    uint8_t slot, i;
+    bool found = false;
+
+    readKernelStats(&stats);
+    for (slot = 0; slot < LOAD_MAX_TASKS; slot++)
+    {
+        task = findLoad(&stats, slot);
+        if (!isRunning(&stats, task))
+            continue;
+        if (!found)
+        {
+            putsUart0("\nLoad  Task      Prio  Workload\n");
+            putsUart0("------------------------------------------------\n");
+            found = true;
+        }
+        putPadded(slot, 6);
+        putsUart0(stats.tasks[task].name);
+        for (i = stringLength(stats.tasks[task].name); i < 10; i++)
+            putcUart0(' ');
+        putPadded(stats.tasks[task].priority, 6);
+        putLoad(stats.tasks[task].arg);
+        putcUart0('\n');
+    }
+    putsUart0(found ? "\n" : "No loads\n\n");
+}
+
+/**
+ * @brief
+ * Starts a load in the first free slot
+ */
+static void startLoad(uint32_t arg, uint8_t priority)
+{
+    KSTATS stats;
+    THREAD_SPEC spec;
+    char name[MAX_SPAWN_NAME + 1];
+    int8_t task;
+    uint8_t slot, spare = LOAD_MAX_TASKS, length;
+
+    readKernelStats(&stats);
+    for (slot = 0; slot < LOAD_MAX_TASKS; slot++)
+    {
+        task = findLoad(&stats, slot);
+        if (!isRunning(&stats, task))
+        {
+            if (spare == LOAD_MAX_TASKS)
+                spare = slot;
+        }
+        else if (LOAD_KIND(arg) == LOAD_LOCK && LOAD_KIND(stats.tasks[task].arg) == LOAD_LOCK &&
+                 LOAD_MUTEX(stats.tasks[task].arg) == LOAD_MUTEX(arg))
+        {
+            putsUart0("Load ");
+            putPadded(slot, 0);
+            putsUart0(" already locks that mutex\n\n");
+            return;
+        }
+    }
+    if (spare == LOAD_MAX_TASKS)
+    {
+        putsUart0("All loads are running\n\n");
+        return;
+    }
+
+    strCopy(name, loadTaskNames[LOAD_KIND(arg)]);
+    length = stringLength(name);
+    name[length] = ASCII_0 + spare;
+    name[length + 1] = '\0';
+
+    spec.fn = loadWorkers[spare];
+    spec.name = name;
+    spec.stackBytes = LOAD_STACK_SIZE;
+    spec.arg = arg;
+    spec.priority = priority;
+    if (!spawnThread(&spec))
+    {
+        putsUart0("No free task or stack memory for the load\n\n");
+        return;
+    }
+
+    putsUart0("Load ");
+    putPadded(spare, 0);
+    putsUart0(" (");
+    putsUart0(name);
+    putsUart0("): ");
+    putLoad(arg);
+    putsUart0("\n\n");
+}
+
+static void stopLoads(const char *which)
+{
+    uint32_t slot;
+    bool all = which != NULL && strCmp(which, "all");
+
+    if (!all && (!parseValue(which, "", &slot) || slot >= LOAD_MAX_TASKS))
+    {
+        putsUart0("load stop <0-");
+        putPadded(LOAD_MAX_TASKS - 1, 0);
+        putsUart0("|all>\n\n");
+        return;
+    }
+
+    // The kernel releases the mutex and the blocks of a stopped task
+    if (!all)
+        stopThread(loadWorkers[slot]);
+    for (slot = 0; all && slot < LOAD_MAX_TASKS; slot++)
+        stopThread(loadWorkers[slot]);
+}
+
+/**
+ * @brief
+ * CPU share, wake-ups and wake-up latencies of every task over the next
+ * ms milliseconds, the wake-up counters of the kernel start again from 0
+ */
+static void report(uint32_t ms)
+{
+    KSTATS stats;
+    const KSTATS_TASK *task;
+    uint32_t pids[MAX_TASKS];
+    uint32_t cpuTicks[MAX_TASKS];
+    uint32_t ticks, start;
+    uint8_t count, i, j;
+
+    resetWakeStats();
+    readKernelStats(&stats);
+    count = stats.taskCount;
+    ticks = stats.systemTicks;
+    for (i = 0; i < count; i++)
+    {
+        pids[i] = stats.tasks[i].pid;
+        cpuTicks[i] = stats.tasks[i].cpuTicks;
+    }
+
+    sleep(ms);
+
+    readKernelStats(&stats);
+    ticks = stats.systemTicks - ticks;
+    if (ticks == 0)
+        ticks = 1;
+
+    putsUart0("\nTask       Prio  CPU%  Wakeups  Avg us  Max us\n");
+    putsUart0("------------------------------------------------\n");
+    for (i = 0; i < stats.taskCount; i++)
+    {
+        task = &stats.tasks[i];
+        if (task->state == STATE_STOPPED)
+            continue;
+
+        // A task started or restarted during the window counts from 0
+        start = i < count && pids[i] == task->pid && cpuTicks[i] <= task->cpuTicks ? cpuTicks[i] : 0;
+
+        putsUart0(task->name);
+        for (j = stringLength(task->name); j < 11; j++)
+            putcUart0(' ');
+        putPadded(task->priority, 6);
+        putPadded((task->cpuTicks - start) * 100 / ticks, 6);
+        putPadded(task->wakeups, 9);
+        putPadded(task->wakeLatencyAvg / LOAD_CYCLES_PER_US, 8);
+        putPadded(task->wakeLatencyMax / LOAD_CYCLES_PER_US, 0);
+        putcUart0('\n');
+    }
+    putPadded(ticks, 0);
+    putsUart0(" ms\n\n");
+}
+
+static void putUsage(void)
+{
+    putsUart0("load cpu <pct>% [prio <p>]\n");
+    putsUart0("load lock <resource|mutex> <hold>ms [every <period>ms] [prio <p>]\n");
+    putsUart0("load alloc <size> <rate>/s [prio <p>]\n");
+    putsUart0("load stop <n|all>\n");
+    putsUart0("load report [<ms>ms]\n\n");
+}
+
+/**
+ * @brief
+ * The shell's load command, see load.h.
+ * Runs in the shell (unprivileged), so every buffer lives on its stack
+ */
+void loadCommand(USER_DATA *data)
+{
+    char *kind = getFieldString(data, 1);
+    char *field;
+    uint32_t value, size, rate, hold, period = LOAD_LOCK_PERIOD;
+    uint8_t priority = LOAD_DEFAULT_PRIORITY, first;
+
+    if (kind == NULL)
+        listLoads();
+    else if (strCmp(kind, "stop"))
+        stopLoads(getFieldString(data, 2));
+    else if (strCmp(kind, "report"))
+    {
+        value = LOAD_REPORT_TIME;
+        if (data->fieldCount > 2 && (!parseValue(getFieldString(data, 2), "ms", &value) ||
+                                     value == 0 || value > LOAD_MAX_REPORT_TIME))
+            putUsage();
+        else
+            report(value);
+    }
+    else if (strCmp(kind, "cpu"))
+    {
+        if (parseValue(getFieldString(data, 2), "", &value) && value > 0 && value <= 100 &&
+            parseOptions(data, 3, NULL, &priority))
+            startLoad(LOAD_ARG(LOAD_CPU, 0, LOAD_CPU_PERIOD, value), priority);
+        else
+            putUsage();
+    }
+    else if (strCmp(kind, "lock"))
+    {
+        field = getFieldString(data, 2);
+        if (field != NULL && strCmp(field, "resource"))
+            value = resource;
+        else if (!parseValue(field, "", &value))
+            value = MAX_MUTEXES;
+
+        if (value < MAX_MUTEXES && parseValue(getFieldString(data, 3), "ms", &hold) &&
+            parseOptions(data, 4, &period, &priority) && hold > 0 && hold < period && period <= LOAD_FIELD_MAX)
+            startLoad(LOAD_ARG(LOAD_LOCK, value, period, hold), priority);
+        else
+            putUsage();
+    }
+    else if (strCmp(kind, "alloc"))
+    {
+        // "100/s" is two fields, the "s" is optional
+        field = getFieldString(data, 4);
+        first = field != NULL && strCmp(field, "s") ? 5 : 4;
+        if (parseValue(getFieldString(data, 2), "", &size) && size > 0 && size <= LOAD_FIELD_MAX &&
+            parseValue(getFieldString(data, 3), "", &rate) && rate > 0 && rate <= LOAD_MAX_RATE &&
+            parseOptions(data, first, NULL, &priority))
+            startLoad(LOAD_ARG(LOAD_ALLOC, 0, rate, size), priority);
+        else
+            putUsage();
+    }
+    else
+        putUsage();
+}
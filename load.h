@@ -0,0 +1,83 @@
+// Load injection functions
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target uC:       TM4C123GH6PM
+// System Clock:    40 MHz
+
+#ifndef LOAD_H_
+#define LOAD_H_
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "kernel.h"
+#include "shell_auxiliary.h"
+
+/*
+    Synthetic load from the shell
+
+    The shell's load command starts load tasks next to the running tasks with
+    spawnThread() and stops them with stopThread(), times in ms:
+        load cpu <pct>% [prio <p>]                          busy pct% of every LOAD_CPU_PERIOD
+        load lock <mutex> <hold>ms [every <period>ms] [prio <p>]
+                                                            locks the mutex (resource or its number)
+                                                            for hold every period (LOAD_LOCK_PERIOD)
+        load alloc <size> <rate>/s [prio <p>]               allocates a block of size bytes rate
+                                                            times a second and frees the oldest of
+                                                            the last LOAD_ALLOC_BLOCKS
+        load                                                lists the loads
+        load stop <n|all>                                   stops load n, its blocks and mutex are released
+        load report [<ms>ms]                                CPU share and wake-up latencies of every
+                                                            task over the next ms (LOAD_REPORT_TIME)
+
+    A load runs on an absolute release schedule and skips the releases it
+    overran. Each load task is a slot of loadWorkers[], its parameters are
+    the argument of the task function (LOAD_ARG) so they survive without
+    globals, which tasks cannot reach. A stopped slot keeps its place in the
+    task list and is reused by the next load, so at most the free task slots
+    (MAX_TASKS less the tasks of main()) can run at the same time.
+
+    One lock load per mutex: the owner and MAX_MUTEX_QUEUE_SIZE waiters is
+    all a mutex can hold, and resource already has LengthyFn and Important.
+*/
+#define LOAD_MAX_TASKS 4
+#define LOAD_STACK_SIZE 1024
+#define LOAD_DEFAULT_PRIORITY 12
+#define LOAD_CPU_PERIOD 10
+#define LOAD_LOCK_PERIOD 50
+#define LOAD_ALLOC_BLOCKS 4
+#define LOAD_MAX_RATE 1000
+#define LOAD_REPORT_TIME 1000
+#define LOAD_MAX_REPORT_TIME 60000
+
+// Workload kinds
+#define LOAD_CPU 1
+#define LOAD_LOCK 2
+#define LOAD_ALLOC 3
+
+/*
+    Argument of a load task: kind (4 bits), mutex (4 bits), a and b (12 bits each)
+        cpu     a = period in ms, b = percent
+        lock    a = period in ms, b = hold in ms
+        alloc   a = rate per second, b = size in bytes
+*/
+#define LOAD_FIELD_MAX 0xFFF
+#define LOAD_ARG(kind, mutex, a, b) (((uint32_t)(kind) << 28) | ((uint32_t)(mutex) << 24) | ((uint32_t)(a) << 12) | (uint32_t)(b))
+#define LOAD_KIND(arg) ((arg) >> 28)
+#define LOAD_MUTEX(arg) (((arg) >> 24) & 0xF)
+#define LOAD_A(arg) (((arg) >> 12) & LOAD_FIELD_MAX)
+#define LOAD_B(arg) ((arg) & LOAD_FIELD_MAX)
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+void loadCommand(USER_DATA *data);
+
+#endif
@@ -20,558 +20,1170 @@
 //-----------------------------------------------------------------------------
 #include "shell_auxiliary.h"
 #include "CortexM4Registers.h"
+#include "kstats.h"
 
 //-----------------------------------------------------------------------------
 // Global variables
 //-----------------------------------------------------------------------------
-MEM_REGION regions[TOTAL_REGIONS] =
+// Generated from HEAP_REGION_LIST in mm.h
+const MEM_REGION regions[TOTAL_REGIONS] =
     {
-        {BASE_R0, REGION_4KB, BLOCK_512, {FREE}, {0}},
-        {BASE_R1, REGION_8KB, BLOCK_1024, {FREE}, {0}},
-        {BASE_R2, REGION_8KB, BLOCK_1024, {FREE}, {0}},
-        {BASE_R3, REGION_4KB, BLOCK_512, {FREE}, {0}},
-        {BASE_R4, REGION_4KB, BLOCK_512, {FREE}, {0}},
-};
+        HEAP_REGION_LIST(MEM_REGION_ENTRY)};
+
+// Region index of every 4 KiB slot of the heap
+const uint8_t regionOfSlot[HEAP_SLOTS] =
+    {
+        HEAP_REGION_LIST(REGION_SLOT_ENTRY)};
+
+// Compile time checks of the layout
+typedef char heapRegionsFitMpu[(TOTAL_REGIONS <= FLASH_PERIPHERAL_REGION_IDX) ? 1 : -1];
+typedef char heapSubregionsFitSrdMask[(NUM_SUBREGIONS <= 64) ? 1 : -1];
+typedef char heapSlotsCoverHeap[(sizeof(regionOfSlot) == HEAP_SLOTS) ? 1 : -1];
+
+/*
+    One bit per subregion, same numbering as the SRD bit mask:
+    bit = region * 8 + subregion. A set bit means the subregion is free.
+    The 512 B and the 1 KiB subregions are searched as separate size
+    classes with SMALL_SUBREGIONS / LARGE_SUBREGIONS.
+*/
+uint64_t freeSubregions = ALL_SUBREGIONS;
+
+// Number of subregions of the allocation starting at each bit, 0 if none
+uint8_t allocationLength[NUM_SUBREGIONS] = {0};
+
+// Task that owns the allocation starting at each bit
+uint8_t allocationOwner[NUM_SUBREGIONS] = {0};
+
+// Handle entry of the allocation starting at each bit, NO_HANDLE for raw blocks
+uint8_t allocationHandle[NUM_SUBREGIONS] = {0};
+
+HANDLE_ENTRY handles[MAX_HANDLES] = {0};
+
+uint32_t dynamicMemoryOfEachTask[MAX_TASKS] = {0};
+
+uint8_t allocationPolicy = ALLOC_SEGREGATED;
+uint32_t failedAllocations = 0;
+
+// Heap blocks the stacks are packed in, see mallocStack()
+STACK_CHUNK stackChunks[MAX_STACK_CHUNKS] = {0};
+
+#ifdef HEAP_TRACE
+// Ring of the last operations, see readHeapTrace()
+HEAP_TRACE_RECORD heapTrace[HEAP_TRACE_SIZE];
+uint8_t heapTraceNext = 0;  // Record written next
+uint8_t heapTraceCount = 0; // Records not read yet
+uint32_t heapTraceDropped = 0;
+#define TRACE_HEAP(op, owner, address, result, size) traceHeap(op, owner, address, result, size)
+#else
+#define TRACE_HEAP(op, owner, address, result, size) ((void)0)
+#endif
 
 //-----------------------------------------------------------------------------
 // Subroutines
 //-----------------------------------------------------------------------------
 
-// REQUIRED: add your malloc code here and update the SRD bits for the current thread
-void *mallocFromHeap(uint32_t size_in_bytes)
+/**
+ * @brief
+ * Index of the lowest set bit, x must not be 0.
+ * x & -x isolates the bit, CLZ gives its position
+ */
+static uint8_t lowestSetBit(uint64_t x)
 {
-    uint32_t alignedSize = ALIGN_SIZE(size_in_bytes);
-    void *address = allocate_from_subregion(alignedSize);
+    uint32_t low = (uint32_t)x;
 
-    return address != NULL ? address : NULL;
+    if (low)
+        return 31 - CLZ(low & -low);
+
+    uint32_t high = (uint32_t)(x >> 32);
+    return 63 - CLZ(high & -high);
 }
 
-void *allocate_from_subregion(uint32_t size)
+/**
+ * @brief
+ * Finds the lowest run of count consecutive set bits in freeMap
+ *
+ * After the loop bit i of runs is set when bits i..i+length-1 are all set.
+ * length doubles on every step so a run of 16 subregions takes 4 steps
+ *
+ * @return Index of the first bit of the run or -1 if there is none
+ */
+static int8_t findFreeRun(uint64_t freeMap, uint8_t count)
 {
-    // Number of sections needed according to the section size
-    uint32_t neededSections = size / SECTION_SIZE(size);
-    uint32_t remainingSize = size;
-    uint32_t j = 0, eightKregionIdx = 1, fourKregionIdx = 0;
+    uint64_t runs = freeMap;
+    uint8_t length = 1;
 
-    void *ptrSubRegion = NULL;
-    if (size > BLOCK_512)
+    if (count == 0 || count > NUM_SUBREGIONS)
+        return -1;
+
+    while (length < count && runs)
     {
-        // First check 1KB sections
-        for (eightKregionIdx; eightKregionIdx <= TOTAL_8K_REGIONS; eightKregionIdx++)
-        {
-            // Once we have allocated exit and don't check the other regions
-            if (remainingSize <= 0)
-                break;
+        uint8_t shift = (count - length) < length ? (count - length) : length;
+        runs &= runs >> shift;
+        length += shift;
+    }
 
-            uint32_t sectionIdx = 0;
+    return runs ? lowestSetBit(runs) : -1;
+}
 
-            for (sectionIdx; sectionIdx <= SUBREGIONS_PER_REGION; sectionIdx++)
-            {
-                // Once we have allocated exit
-                if (!remainingSize)
-                    break;
-
-                /*
-                    Sweep
-                    For each needed section check if the section is allocated
-                */
-
-                for (j = 0; j < neededSections; j++)
-                {
-                    /*
-                        If the section is
-                        - allocated
-                        - or the remaining size is 0
-                        - or the section index is out of bounds
-                        then break
-                    */
-                    if (regions[eightKregionIdx].subRegionAllocated[sectionIdx + j] == ALLOCATED || remainingSize == FREE || (sectionIdx + j) >= SUBREGIONS_PER_REGION)
-                        break;
-
-                    else
-                    {
-                        if (ptrSubRegion == NULL)
-                        {
-                            ptrSubRegion = regions[eightKregionIdx].baseAddress + sectionIdx * BLOCK_1024;
-                            regions[eightKregionIdx].sizeOfAllocations[sectionIdx] = size;
-                        }
-
-                        regions[eightKregionIdx].subRegionAllocated[sectionIdx + j] = ALLOCATED;
-                        remainingSize -= BLOCK_1024;
-
-                        /*
-                            If we ran out of space in the 8K region
-                            check if there is space in the following
-                            4K region and set the 4K region index to R3
-
-                            IF the first index of the 4K region is not allocated
-                            then we can allocate in that region
-                        */
-                        fourKregionIdx = regions[R3_IDX].subRegionAllocated[0] == FREE ? R3_IDX : R0_IDX;
-                    }
-                }
-            }
+/**
+ * @brief
+ * Maps an heap address to its subregion bit.
+ * The 4 KiB slot gives the region, the offset in the region gives the subregion
+ *
+ * @return Subregion bit or -1 if the address is outside the heap
+ */
+int8_t getSubregionBit(uint32_t address)
+{
+    uint32_t offset = address - HEAP_START;
+    uint8_t regionIdx;
+
+    // Addresses below the heap wrap around to a large offset
+    if (offset >= HEAP_SIZE)
+        return -1;
+
+    regionIdx = regionOfSlot[offset >> HEAP_SLOT_SHIFT];
+    return regionIdx * SUBREGIONS_PER_REGION + ((address - regions[regionIdx].baseAddress) >> regions[regionIdx].subRegionShift);
+}
+
+/**
+ * @brief
+ * Start address of the subregion with the given bit
+ */
+uint32_t getSubregionAddress(uint8_t bit)
+{
+    const MEM_REGION *region = &regions[bit / SUBREGIONS_PER_REGION];
+    return region->baseAddress + ((bit % SUBREGIONS_PER_REGION) << region->subRegionShift);
+}
+
+/**
+ * @brief
+ * Size in bytes of the run of count subregions starting at bit.
+ * Runs are contiguous in memory even when they mix subregion sizes
+ */
+uint32_t getRunSize(uint8_t bit, uint8_t count)
+{
+    uint8_t last = bit + count - 1;
+
+    return getSubregionAddress(last) + regions[last / SUBREGIONS_PER_REGION].subRegionSize - getSubregionAddress(bit);
+}
+
+/**
+ * @brief
+ * Finds the lowest run of free subregions of at least size bytes, the run may
+ * cross from 512 B into 1 KiB subregions and back (e.g. R0 + R1 + R2)
+ *
+ * Sliding window over the subregions in address order
+ *
+ * @return Index of the first bit of the run or -1, count gets the run length
+ */
+static int8_t findSpanningRun(uint64_t freeMap, uint32_t size, uint8_t *count)
+{
+    uint8_t first = 0, bit;
+    uint32_t runSize = 0;
+
+    for (bit = 0; bit < NUM_SUBREGIONS; bit++)
+    {
+        if (!(freeMap & ((uint64_t)1 << bit)))
+        {
+            first = bit + 1;
+            runSize = 0;
+            continue;
+        }
+
+        runSize += regions[bit / SUBREGIONS_PER_REGION].subRegionSize;
+        if (runSize >= size)
+        {
+            *count = bit - first + 1;
+            return first;
         }
     }
+    return -1;
+}
 
-    /*
-        Need to recalculate the number of sections needed if
-        we ran out of space in the 8K regions
-    */
-    neededSections = remainingSize / BLOCK_512;
+/**
+ * @brief
+ * Finds the smallest free run (in bytes) of at least size bytes, the run
+ * may mix subregion sizes like findSpanningRun()
+ *
+ * @return Index of the first bit of the run or -1, count gets the number
+ * of subregions needed from it
+ */
+static int8_t findBestRun(uint64_t freeMap, uint32_t size, uint8_t *count)
+{
+    int8_t best = -1;
+    uint32_t bestSize = 0xFFFFFFFF, runSize = 0;
+    uint8_t first = 0, bit;
 
-    // Check 512B sections
-    for (fourKregionIdx; fourKregionIdx < TOTAL_REGIONS; fourKregionIdx++)
+    // One step past the last bit closes the last run
+    for (bit = 0; bit <= NUM_SUBREGIONS; bit++)
     {
-        if (regions[fourKregionIdx].subRegionSize == BLOCK_512)
+        if (bit < NUM_SUBREGIONS && (freeMap & ((uint64_t)1 << bit)))
         {
-            // Different counter used
-            uint32_t innerNeededSections = neededSections;
-
-            // Once we have allocated exit and don't check the other regions
-            if (remainingSize <= 0)
-                break;
-
-            uint32_t sectionIdx = 0;
-            /*
-                When I am in region 0 I need to sweep the region
-                to check that there is enough space to allocate.
-                Therefore in the for loop I need to check the difference
-                between the number of sections needed and the number of
-                sections in the region.
-                -> Momentarily I will set the needed sections to 0 if in region 0
-
-                When I am in region 3 and 4 I do not
-                need to stringently check the number of sections I need.
-            */
-            // Comment this out if you want the memory block to be allocated in the 4k region to be contiguous
-            if (fourKregionIdx != R0_IDX)
-                innerNeededSections = FREE;
-
-            for (sectionIdx; sectionIdx <= (SUBREGIONS_PER_REGION - innerNeededSections); sectionIdx++)
-            {
-                // Once we have allocated exit
-                if (!remainingSize)
-                    break;
-
-                // Sweep
-                for (j = 0; j < neededSections; j++)
-                {
-                    /*
-                    If the section is
-                    - allocated
-                    - or the remaining size is 0
-                    - or the section index is out of bounds
-                    then break
-                    */
-                    if (regions[fourKregionIdx].subRegionAllocated[sectionIdx + j] == ALLOCATED || remainingSize == FREE || (sectionIdx + j) >= SUBREGIONS_PER_REGION)
-                        break;
-
-                    else
-                    {
-                        if (ptrSubRegion == NULL)
-                        {
-                            ptrSubRegion = regions[fourKregionIdx].baseAddress + sectionIdx * BLOCK_512;
-                            regions[fourKregionIdx].sizeOfAllocations[sectionIdx] = size;
-                        }
-
-                        regions[fourKregionIdx].subRegionAllocated[sectionIdx + j] = ALLOCATED;
-                        remainingSize -= BLOCK_512;
-                    }
-                }
-            }
+            if (runSize == 0)
+                first = bit;
+            runSize += regions[bit / SUBREGIONS_PER_REGION].subRegionSize;
+            continue;
+        }
+
+        if (runSize >= size && runSize < bestSize)
+        {
+            best = first;
+            bestSize = runSize;
         }
+        runSize = 0;
     }
 
-    // Not enough space
-    if (remainingSize > 0)
+    if (best < 0)
+        return -1;
+
+    // The lowest run from best on that fits starts at best
+    return findSpanningRun(freeMap & ~SUBREGION_RUN(0, best), size, count);
+}
+
+/**
+ * @brief
+ * Bit mask of every subregion touched by [address, address + size_in_bytes)
+ *
+ * @return The mask or 0 if the range is empty or leaves the heap
+ */
+uint64_t getSubregionMask(uint32_t address, uint32_t size_in_bytes)
+{
+    uint32_t end = address + size_in_bytes;
+    int8_t first, last;
+
+    if (size_in_bytes == 0 || end < address)
+        return 0;
+
+    first = getSubregionBit(address);
+    last = getSubregionBit(end - 1);
+    if (first < 0 || last < 0)
+        return 0;
+
+    return SUBREGION_RUN(first, last - first + 1);
+}
+
+#ifdef HEAP_TRACE
+/**
+ * @brief
+ * Adds an operation to the trace ring, overwriting the oldest record
+ */
+static void traceHeap(uint8_t op, uint8_t owner, void *address, void *result, uint32_t size)
+{
+    HEAP_TRACE_RECORD *record = &heapTrace[heapTraceNext];
+
+    record->address = (uint32_t)address;
+    record->result = (uint32_t)result;
+    record->size = size < 0xFFFF ? size : 0xFFFF;
+    record->op = op;
+    record->owner = owner;
+
+    heapTraceNext = (heapTraceNext + 1) % HEAP_TRACE_SIZE;
+    if (heapTraceCount < HEAP_TRACE_SIZE)
+        heapTraceCount++;
+    else
+        heapTraceDropped++;
+}
+#endif
+
+// REQUIRED: add your malloc code here and update the SRD bits for the current thread
+/**
+ * @brief
+ * Allocates size_in_bytes from the heap on behalf of the owner task
+ *
+ * - Up to 512 B: one 512 B subregion (R0, R3, R4)
+ * - Larger: a run of 1 KiB subregions (R1, R2), and if there is no room a run
+ *   of 512 B subregions of the same size
+ * - If neither size class has room (e.g. more than 16 KiB), a run of mixed
+ *   subregions across region boundaries, up to the whole 28 KiB heap
+ *
+ * The whole heap is contiguous, so any run of subregions is contiguous memory
+ * and addSramAccessWindow() opens it in every region it covers
+ */
+static void *allocateRun(uint32_t size_in_bytes, uint8_t owner)
+{
+    uint32_t alignedSize = ALIGN_SIZE(size_in_bytes);
+    int8_t bit = -1;
+    uint8_t count = 0;
+
+    if (size_in_bytes == 0)
         return NULL;
+
+    // Checked before rounding, ALIGN_SIZE() wraps around for sizes near 4 GiB
+    if (size_in_bytes > MAX_SIZE)
+    {
+        failedAllocations++;
+        return NULL;
+    }
+
+    if (allocationPolicy == ALLOC_FIRST_FIT)
+        bit = findSpanningRun(freeSubregions, size_in_bytes, &count);
+    else if (allocationPolicy == ALLOC_BEST_FIT)
+        bit = findBestRun(freeSubregions, size_in_bytes, &count);
     else
-        return ptrSubRegion;
+    {
+        if (alignedSize > BLOCK_512)
+        {
+            count = alignedSize / BLOCK_1024;
+            bit = findFreeRun(freeSubregions & LARGE_SUBREGIONS, count);
+        }
+
+        if (bit < 0)
+        {
+            count = alignedSize / BLOCK_512;
+            bit = findFreeRun(freeSubregions & SMALL_SUBREGIONS, count);
+        }
+
+        if (bit < 0)
+            bit = findSpanningRun(freeSubregions, alignedSize, &count);
+    }
+
+    if (bit < 0)
+    {
+        failedAllocations++;
+        return NULL;
+    }
+
+    freeSubregions &= ~SUBREGION_RUN(bit, count);
+    allocationLength[bit] = count;
+    allocationOwner[bit] = owner;
+    allocationHandle[bit] = NO_HANDLE;
+
+    return (void *)getSubregionAddress(bit);
+}
+
+/**
+ * @brief
+ * allocateRun() for the owner task, traced
+ */
+void *mallocFromHeap(uint32_t size_in_bytes, uint8_t owner)
+{
+    void *block = allocateRun(size_in_bytes, owner);
+
+    TRACE_HEAP(HEAP_TRACE_MALLOC, owner, NULL, block, size_in_bytes);
+    return block;
 }
 
 // REQUIRED: add your free code here and update the SRD bits for the current thread
+/**
+ * @brief
+ * Returns an allocation made by mallocFromHeap() to the heap.
+ * Pointers that are not the start of an allocation are ignored
+ */
 void freeToHeap(void *pMemory)
 {
+    int8_t bit = getSubregionBit((uint32_t)pMemory);
 
-    // Number of sections needed according to the section size
-    uint8_t subRegionIdx = ((uint32_t)pMemory - FIND_PTR_BASE(pMemory)) / FIND_PTR_SUBREGION_SIZE(pMemory);
-    uint8_t regionIdx = FIND_PTR_REGION_IDX(pMemory);
-    uint8_t subRegionIdxToStart = subRegionIdx;
-    uint32_t sizeOfAllocation = regions[regionIdx].sizeOfAllocations[subRegionIdx];
-    /*
-        Check the accuracy of results of the operaion
-        below.
-        Let's say we allocated 4 KiB
-        I have to either free:
-        - 4 sections
-        - 8 sectinos (When both 8 KiB regions are exhausted)
+    if (bit < 0 || allocationLength[bit] == 0 || getSubregionAddress(bit) != (uint32_t)pMemory)
+        return;
 
-    */
-    uint8_t sectionToFree = sizeOfAllocation / SECTION_SIZE(sizeOfAllocation);
+    TRACE_HEAP(HEAP_TRACE_FREE, allocationOwner[bit], pMemory, NULL, 0);
+    freeSubregions |= SUBREGION_RUN(bit, allocationLength[bit]);
+    allocationLength[bit] = 0;
+}
 
-    int32_t remainingSize = sizeOfAllocation;
-    uint32_t j = 0, eightKregionIdx = regionIdx, fourKregionIdx = regionIdx;
+/**
+ * @brief
+ * Copies size_in_bytes (a multiple of 4) between word aligned blocks that
+ * may overlap, like memmove()
+ */
+static void moveWords(uint32_t *dst, const uint32_t *src, uint32_t size_in_bytes)
+{
+    uint32_t i, words = size_in_bytes / sizeof(uint32_t);
 
-    if (eightKregionIdx >= R1_IDX && eightKregionIdx <= R2_IDX)
+    if (dst < src)
     {
-        // First check 1KB sections
-        for (eightKregionIdx; eightKregionIdx <= TOTAL_8K_REGIONS; eightKregionIdx++)
-        {
-            // Sweep
-            for (j = 0; j < sectionToFree; j++)
-            {
-                /*
-                    If the section is
-                    - free
-                    - or the remaining size is less 0
-                    - or the section index is out of bounds
-                    then break
-                */
-                if (regions[eightKregionIdx].subRegionAllocated[subRegionIdx + j] == FREE || remainingSize <= FREE || (subRegionIdx + j) >= SUBREGIONS_PER_REGION)
-                {
-                    /*
-                     * Set subRegionIdx to zero so that when it goes to the next region it starts at idx = 0
-                     */
-                    subRegionIdx = 0;
-                    break;
-                }
-                else
-                {
-
-                    regions[eightKregionIdx].subRegionAllocated[subRegionIdx + j] = FREE;
-                    remainingSize -= BLOCK_1024;
-                }
-
-                /**
-                 * @brief
-                 *  In the case when we are in R2 and need to go to R3
-                 */
-                fourKregionIdx = regions[R3_IDX].subRegionAllocated[0] == ALLOCATED ? R3_IDX : regionIdx;
-            }
-            // Once we have freed everyting exit
-            if (!remainingSize)
-            {
-                regions[regionIdx].sizeOfAllocations[subRegionIdxToStart] = FREE;
-                break;
-            }
-        }
+        for (i = 0; i < words; i++)
+            dst[i] = src[i];
+    }
+    else if (dst > src)
+    {
+        for (i = words; i > 0; i--)
+            dst[i - 1] = src[i - 1];
     }
+}
 
-    sectionToFree = remainingSize / BLOCK_512;
-    // Check 512B sections
-    for (fourKregionIdx; fourKregionIdx < TOTAL_REGIONS; fourKregionIdx++)
+/**
+ * @brief
+ * Resizes the allocation starting at pMemory to at least size_in_bytes
+ *
+ * - Shrinking gives the subregions at the end back to the heap
+ * - Growing takes the free subregions right after the allocation when there
+ *   are enough of them, whatever their size (e.g. R0 into R1)
+ * - Otherwise the allocation moves: its subregions are freed, a new run is
+ *   allocated (it may overlap the old one) and the data is moved
+ *
+ * The owner is kept. The caller fixes the SRD windows.
+ *
+ * @return The new address or NULL, the allocation is unchanged on failure
+ */
+static void *resizeRun(void *pMemory, uint32_t size_in_bytes)
+{
+    int8_t bit = getSubregionBit((uint32_t)pMemory);
+    uint8_t length, count, owner;
+    uint32_t oldSize;
+    uint64_t oldRun;
+    void *moved;
+
+    if (bit < 0 || allocationLength[bit] == 0 || getSubregionAddress(bit) != (uint32_t)pMemory)
+        return NULL;
+    if (size_in_bytes == 0 || size_in_bytes > MAX_SIZE)
+        return NULL;
+
+    length = allocationLength[bit];
+    count = length;
+    owner = allocationOwner[bit];
+    oldSize = getRunSize(bit, length);
+
+    // Shrink in place
+    while (count > 1 && getRunSize(bit, count - 1) >= size_in_bytes)
+        count--;
+
+    // Grow in place over the free subregions that follow
+    while (getRunSize(bit, count) < size_in_bytes && bit + count < NUM_SUBREGIONS &&
+           (freeSubregions & ((uint64_t)1 << (bit + count))))
+        count++;
+
+    if (getRunSize(bit, count) >= size_in_bytes)
     {
-        if (regions[fourKregionIdx].subRegionSize == BLOCK_512)
-        {
+        freeSubregions |= SUBREGION_RUN(bit, length);
+        freeSubregions &= ~SUBREGION_RUN(bit, count);
+        allocationLength[bit] = count;
+        return pMemory;
+    }
 
-            // Sweep
-            for (j = 0; j < sectionToFree; j++)
-            {
-                /*
-                    If the section is
-                    - free
-                    - or the remaining size is 0
-                    - or the section index is out of bounds
-                    then break
-                */
-                if (regions[fourKregionIdx].subRegionAllocated[subRegionIdx + j] == FREE || remainingSize == FREE || (subRegionIdx + j) >= SUBREGIONS_PER_REGION)
-                {
-                    subRegionIdx = 0;
-                    break;
-                }
-                regions[fourKregionIdx].subRegionAllocated[subRegionIdx + j] = FREE;
-                remainingSize -= BLOCK_512;
-            }
+    // Move, the old subregions count as free so the new run may overlap them
+    oldRun = SUBREGION_RUN(bit, length);
+    freeSubregions |= oldRun;
+    allocationLength[bit] = 0;
 
-            // Once we have freed everything exit
-            if (!remainingSize)
-            {
-                regions[regionIdx].sizeOfAllocations[subRegionIdxToStart] = FREE;
-                break;
-            }
-        }
+    moved = allocateRun(size_in_bytes, owner);
+    if (moved == NULL)
+    {
+        freeSubregions &= ~oldRun;
+        allocationLength[bit] = length;
+        return NULL;
     }
+
+    moveWords(moved, pMemory, oldSize);
+    return moved;
 }
 
 /**
  * @brief
- * Create a full-access MPU aperture for flash
- * with the RWX access for both privileged and unprivileged access
+ * resizeRun(), traced
  */
-// REQUIRED: include your solution from the mini project
-void allowFlashAccess(void)
+void *reallocFromHeap(void *pMemory, uint32_t size_in_bytes)
 {
-    // Set the region number to 6
-    NVIC_MPU_NUMBER_R = 6;
-    // Set the base address to the start of the flash memory
-    NVIC_MPU_BASE_R = 0x00000000;
-    // Set the region size to 256 KiB
-    NVIC_MPU_ATTR_R |= 0b10001 << 1;
-    // Set the region to RWX
-    NVIC_MPU_ATTR_R |= FULL_ACCESS << 24;
-    // Enable the region
-    NVIC_MPU_ATTR_R |= 0b1 << 0;
+    void *block = resizeRun(pMemory, size_in_bytes);
+
+    TRACE_HEAP(HEAP_TRACE_REALLOC, getAllocationOwner(block), pMemory, block, size_in_bytes);
+    return block;
+}
+
+/**
+ * @brief
+ * Size in bytes of the allocation starting at pMemory, 0 if there is none
+ */
+uint32_t getAllocationSize(void *pMemory)
+{
+    int8_t bit = getSubregionBit((uint32_t)pMemory);
+
+    if (bit < 0 || getSubregionAddress(bit) != (uint32_t)pMemory)
+        return 0;
+
+    return allocationLength[bit] ? getRunSize(bit, allocationLength[bit]) : 0;
 }
 
 /**
  * @brief
- * Create a full-access MPU aperture to peripherals and peripheral bitbanded addresses
- * with RW access for both privileged and unprivileged access
+ * Task that owns the allocation starting at pMemory, NO_OWNER if there is none
+ */
+uint8_t getAllocationOwner(void *pMemory)
+{
+    int8_t bit = getSubregionBit((uint32_t)pMemory);
+
+    if (bit < 0 || allocationLength[bit] == 0 || getSubregionAddress(bit) != (uint32_t)pMemory)
+        return NO_OWNER;
+
+    return allocationOwner[bit];
+}
+
+/**
+ * @brief
+ * Frees every allocation and handle of the owner task. Its stack is not
+ * included: stacks live in chunks owned by STACK_CHUNK_OWNER, the caller
+ * frees it with freeStack()
  *
- * I chose the all access rule, this may not be needed
+ * @return Number of bytes returned to the heap
  */
-void allowPeripheralAccess(void)
+uint32_t freeAllOfOwner(uint8_t owner)
 {
-    // Set the region number to 5
-    NVIC_MPU_NUMBER_R = 5;
-    // Set the base address to the start of the peripherals
-    NVIC_MPU_BASE_R = 0x40000000;
-    // Set the region size to 64 MiB
-    NVIC_MPU_ATTR_R |= 25 << 1;
-    // Set the region to be rw
-    NVIC_MPU_ATTR_R |= FULL_ACCESS << 24;
-    // Set the Ins fetches to disable
-    NVIC_MPU_ATTR_R |= 0b001 << 28;
-    // Enable the region
-    NVIC_MPU_ATTR_R |= 0b1 << 0;
+    uint32_t freed = 0;
+    uint8_t bit, i;
+
+    for (i = 0; i < MAX_HANDLES; i++)
+    {
+        if (handles[i].block != NULL && handles[i].owner == owner)
+            freeHandle((handles[i].generation << HANDLE_GENERATION_SHIFT) | i);
+    }
+
+    for (bit = 0; bit < NUM_SUBREGIONS; bit++)
+    {
+        if (allocationLength[bit] != 0 && allocationOwner[bit] == owner)
+        {
+            TRACE_HEAP(HEAP_TRACE_FREE, owner, (void *)getSubregionAddress(bit), NULL, 0);
+            freed += getRunSize(bit, allocationLength[bit]);
+            freeSubregions |= SUBREGION_RUN(bit, allocationLength[bit]);
+            allocationLength[bit] = 0;
+        }
+    }
+    return freed;
 }
 
 /**
  * @brief
- * Creates multiple MPU regions to cover 32 KiB SRAM
- * Each MPU region covers 8 KiB or 4 KiB with regions
- * of 512B or 1 KiB each with RW access for privileged and no access for unprivileged
+ * Packs the allocation state of the heap into one byte per region.
+ * Bit n of bitmap[r] is set when subregion n of region r is allocated
+ */
+void getHeapBitmap(uint8_t bitmap[NUM_SRAM_REGIONS])
+{
+    uint8_t regionIdx;
+
+    for (regionIdx = 0; regionIdx < NUM_SRAM_REGIONS; regionIdx++)
+        bitmap[regionIdx] = ~(freeSubregions >> (regionIdx * SUBREGIONS_PER_REGION)) & 0xFF;
+}
+
+/**
+ * @brief
+ * Allocates a relocatable block of size_in_bytes for the owner task
  *
- * -> Disable the subregions to start
+ * @return The handle or 0 if the heap or the handle table is full
  */
-void setupSramAccess(void)
+HANDLE mallocHandle(uint32_t size_in_bytes, uint8_t owner)
 {
-    /*
-    Give rw to unpriv
-    */
-    /********************************************************************************/
-    // Set the region number to 0
-    NVIC_MPU_NUMBER_R = R0_IDX;
-    // Set the base address to the start of the SRAM
-    NVIC_MPU_BASE_R = 0x20001000;
+    uint8_t i;
+    int8_t bit;
+    void *block;
+
+    for (i = 0; i < MAX_HANDLES && handles[i].block != NULL; i++)
+        ;
+    if (i == MAX_HANDLES)
+        return 0;
+
+    block = mallocFromHeap(size_in_bytes, owner);
+    if (block == NULL)
+        return 0;
+
+    bit = getSubregionBit((uint32_t)block);
+    allocationHandle[bit] = i;
+
+    if (handles[i].generation == 0)
+        handles[i].generation = 1;
+    handles[i].block = block;
+    handles[i].owner = owner;
+    handles[i].lockCount = 0;
+    return (handles[i].generation << HANDLE_GENERATION_SHIFT) | i;
+}
 
-    // Every subregion is disabled
-    NVIC_MPU_ATTR_R = (SRD_DISABLE << 8);
+/**
+ * @brief
+ * Entry of a live handle of the owner task, NULL if the handle is stale,
+ * free or belongs to another task
+ */
+HANDLE_ENTRY *getHandle(HANDLE handle, uint8_t owner)
+{
+    HANDLE_ENTRY *entry;
 
-    // Set the region size to 4KiB
-    // Set to 11 for 4KB
-    // 2^(11 + 1) = 4KB
-    NVIC_MPU_ATTR_R |= 0b01011 << 1;
+    if (HANDLE_INDEX(handle) >= MAX_HANDLES)
+        return NULL;
 
-    // Set rw for unpriv
-    NVIC_MPU_ATTR_R |= FULL_ACCESS << 24;
+    entry = &handles[HANDLE_INDEX(handle)];
+    if (entry->block == NULL || entry->owner != owner || entry->generation != handle >> HANDLE_GENERATION_SHIFT)
+        return NULL;
+    return entry;
+}
 
-    // Enable the region
-    NVIC_MPU_ATTR_R |= 0b1 << 0;
+/**
+ * @brief
+ * Frees the block of a handle and retires the handle.
+ * The caller closes the SRD window if the handle was locked
+ */
+void freeHandle(HANDLE handle)
+{
+    HANDLE_ENTRY *entry = &handles[HANDLE_INDEX(handle)];
+
+    freeToHeap(entry->block);
+    entry->block = NULL;
+    entry->lockCount = 0;
+    entry->generation = (entry->generation + 1) & 0xFFFF;
+    if (entry->generation == 0)
+        entry->generation = 1;
+}
 
-    /********************************************************************************/
-    // Set the region number to 1
-    NVIC_MPU_NUMBER_R = R1_IDX;
+/**
+ * @brief
+ * True if pMemory is the start of a block allocated with mallocHandle(),
+ * those must go through the handle API
+ */
+bool isHandleBlock(void *pMemory)
+{
+    int8_t bit = getSubregionBit((uint32_t)pMemory);
 
-    // Set the base address to the start of the SRAM
-    NVIC_MPU_BASE_R = 0x20002000;
+    return bit >= 0 && allocationLength[bit] != 0 && allocationHandle[bit] != NO_HANDLE;
+}
 
-    // Set the region size to 8KiB
-    // Set to 12 for 8KB
-    // 2^(12 + 1) = 8KB
-    NVIC_MPU_ATTR_R |= 0b01100 << 1;
+/**
+ * @brief
+ * Moves the unlocked handle block starting at bit to the lowest free run
+ * of the same size below it
+ *
+ * @return false if there is no such run
+ */
+static bool relocateBlock(uint8_t bit)
+{
+    uint8_t length = allocationLength[bit];
+    uint8_t handleIdx = allocationHandle[bit];
+    uint32_t size = getRunSize(bit, length);
+    uint64_t run = SUBREGION_RUN(bit, length);
+    uint8_t count;
+    int8_t target;
+
+    // The block's own subregions count as free, the new place may overlap them
+    target = findSpanningRun(freeSubregions | run, size, &count);
+    if (target < 0 || target >= bit || getRunSize(target, count) != size)
+        return false;
+
+    freeSubregions |= run;
+    allocationLength[bit] = 0;
+
+    freeSubregions &= ~SUBREGION_RUN(target, count);
+    allocationLength[target] = count;
+    allocationOwner[target] = handles[handleIdx].owner;
+    allocationHandle[target] = handleIdx;
+
+    moveWords((uint32_t *)getSubregionAddress(target), (uint32_t *)getSubregionAddress(bit), size);
+    handles[handleIdx].block = (void *)getSubregionAddress(target);
+    TRACE_HEAP(HEAP_TRACE_MOVE, handles[handleIdx].owner, (void *)getSubregionAddress(bit), handles[handleIdx].block, size);
+    return true;
+}
 
-    // Set rw for unpriv
-    NVIC_MPU_ATTR_R |= FULL_ACCESS << 24;
+/**
+ * @brief
+ * One step of heap compaction: moves the lowest unlocked handle block that
+ * can go to a lower address. Short enough to run in a service call
+ *
+ * @return true if a block was moved, false once the heap is compact
+ */
+bool compactHeapStep(void)
+{
+    uint8_t bit;
 
-    // Enable the region
-    NVIC_MPU_ATTR_R |= 0b1 << 0;
+    for (bit = 0; bit < NUM_SUBREGIONS; bit++)
+    {
+        uint8_t handleIdx = allocationHandle[bit];
 
-    /********************************************************************************/
-    // Set the region number to 2
-    NVIC_MPU_NUMBER_R = R2_IDX;
+        if (allocationLength[bit] == 0 || handleIdx == NO_HANDLE || handles[handleIdx].lockCount != 0)
+            continue;
 
-    // Set the base address to the start of the SRAM
-    NVIC_MPU_BASE_R = 0x20004000;
+        if (relocateBlock(bit))
+            return true;
+    }
+    return false;
+}
 
-    // Set the region size to 8Kib
-    NVIC_MPU_ATTR_R |= 0b01100 << 1;
+/**
+ * @brief
+ * Selects the placement policy of the next allocations,
+ * the blocks already allocated stay where they are
+ */
+bool setAllocationPolicy(uint8_t policy)
+{
+    if (policy >= NUM_ALLOC_POLICIES)
+        return false;
 
-    // Set rw for unpriv
-    NVIC_MPU_ATTR_R |= FULL_ACCESS << 24;
+    allocationPolicy = policy;
+    return true;
+}
 
-    // Enable the region
-    NVIC_MPU_ATTR_R |= 0b1 << 0;
+/**
+ * @brief
+ * Copies the allocator state into map and computes the fragmentation
+ * metrics: free bytes, largest free run, histogram of the free runs
+ * and bytes used in each region
+ */
+void readHeapMap(HEAP_MAP *map)
+{
+    uint32_t runSize = 0;
+    uint8_t bit, i, owner = NO_OWNER, remaining = 0;
+
+    map->freeSubregions = freeSubregions;
+    map->allocationStarts = 0;
+    map->freeBytes = 0;
+    map->largestFreeRun = 0;
+    map->failedAllocations = failedAllocations;
+    map->policy = allocationPolicy;
+    for (i = 0; i < NUM_SRAM_REGIONS; i++)
+        map->regionUsed[i] = 0;
+    for (i = 0; i < FREE_RUN_BUCKETS; i++)
+        map->freeRuns[i] = 0;
+
+    // One step past the last bit closes the last free run
+    for (bit = 0; bit <= NUM_SUBREGIONS; bit++)
+    {
+        bool isFree = bit < NUM_SUBREGIONS && (freeSubregions & ((uint64_t)1 << bit));
 
-    /********************************************************************************/
-    // Set the region number to 3
-    NVIC_MPU_NUMBER_R = R3_IDX;
+        if (bit < NUM_SUBREGIONS)
+        {
+            uint16_t subRegionSize = regions[bit / SUBREGIONS_PER_REGION].subRegionSize;
 
-    // Set the base address to the start of the SRAM
-    NVIC_MPU_BASE_R = 0x20006000;
+            if (allocationLength[bit] != 0)
+            {
+                map->allocationStarts |= (uint64_t)1 << bit;
+                owner = allocationOwner[bit];
+                remaining = allocationLength[bit];
+            }
 
-    // Set the region size to 4KiB
-    // Set to 11 for 4KB
-    // 2^(11 + 1) = 4KB
-    NVIC_MPU_ATTR_R |= 0b01011 << 1;
+            if (isFree)
+            {
+                map->owner[bit] = NO_OWNER;
+                map->freeBytes += subRegionSize;
+                runSize += subRegionSize;
+            }
+            else
+            {
+                map->owner[bit] = remaining ? owner : NO_OWNER;
+                map->regionUsed[bit / SUBREGIONS_PER_REGION] += subRegionSize;
+            }
 
-    // Set rw for unpriv
-    NVIC_MPU_ATTR_R |= FULL_ACCESS << 24;
+            if (remaining)
+                remaining--;
+        }
 
-    // Enable the region
-    NVIC_MPU_ATTR_R |= 0b1 << 0;
+        if (!isFree && runSize != 0)
+        {
+            uint8_t bucket = 31 - CLZ(runSize >> FREE_RUN_MIN_SHIFT);
+
+            map->freeRuns[bucket < FREE_RUN_BUCKETS ? bucket : FREE_RUN_BUCKETS - 1]++;
+            if (runSize > map->largestFreeRun)
+                map->largestFreeRun = runSize;
+            runSize = 0;
+        }
+    }
+}
+
+/**
+ * @brief
+ * Moves up to count of the oldest trace records into records, they are
+ * not returned again. dropped gets the records lost since the last call
+ *
+ * @return Number of records copied, always 0 without HEAP_TRACE
+ */
+uint32_t readHeapTrace(HEAP_TRACE_RECORD records[], uint32_t count, uint32_t *dropped)
+{
+    uint32_t copied = 0;
 
-    /********************************************************************************/
-    // Set the region number to 4
-    NVIC_MPU_NUMBER_R = R4_IDX;
+    *dropped = 0;
+#ifdef HEAP_TRACE
+    *dropped = heapTraceDropped;
+    heapTraceDropped = 0;
+    while (copied < count && heapTraceCount > 0)
+    {
+        records[copied++] = heapTrace[(heapTraceNext + HEAP_TRACE_SIZE - heapTraceCount) % HEAP_TRACE_SIZE];
+        heapTraceCount--;
+    }
+#endif
+    return copied;
+}
 
-    // Set the base address to the start of the SRAM
-    NVIC_MPU_BASE_R = 0x20007000;
+/**
+ * @brief
+ * Rounds a requested stack size up to a size region 6 can cover exactly:
+ * a multiple of an eighth of the next power of two, at least STACK_GRANULE.
+ * Stacks larger than a chunk are rounded like any heap allocation
+ */
+uint32_t getStackSize(uint32_t stackBytes)
+{
+    uint32_t step;
 
-    // Set the region size to 4KiB
-    // Set to 11 for 4KB
-    // 2^(11 + 1) = 4KB
-    NVIC_MPU_ATTR_R |= 0b01011 << 1;
+    if (stackBytes > STACK_CHUNK_MAX_SIZE)
+        return ALIGN_SIZE(stackBytes);
 
-    // Set rw for unpriv
-    NVIC_MPU_ATTR_R |= FULL_ACCESS << 24;
+    if (stackBytes < STACK_MIN_SIZE)
+        stackBytes = STACK_MIN_SIZE;
 
-    // Enable the region
-    NVIC_MPU_ATTR_R |= 0b1 << 0;
+    step = (1ul << (32 - CLZ(stackBytes - 1))) / SUBREGIONS_PER_REGION;
+    if (step < STACK_GRANULE)
+        step = STACK_GRANULE;
+
+    return (stackBytes + step - 1) & ~(step - 1);
 }
 
-uint64_t createNoSramAccessMask(void)
+/**
+ * @brief
+ * Computes the region 6 registers that give access to exactly
+ * [baseAdd, baseAdd + size_in_bytes): the smallest aligned region holding
+ * the range, with the subregions outside the range disabled
+ *
+ * @return false if no region can cover the range exactly, the window is
+ * then left disabled
+ */
+bool createStackWindow(STACK_WINDOW *window, uint32_t baseAdd, uint32_t size_in_bytes)
 {
-    return 0x000000FFFFFFFFFF;
+    uint8_t sizeField;
+
+    window->base = 0;
+    window->attr = 0;
+
+    if (size_in_bytes == 0)
+        return false;
+
+    for (sizeField = MIN_SRD_REGION_SIZE; sizeField < ADDRESS_SPACE_SIZE; sizeField++)
+    {
+        uint32_t regionSize = REGION_BYTES(sizeField);
+        uint32_t regionBase = baseAdd & ~(regionSize - 1);
+        uint32_t subRegionSize = regionSize / SUBREGIONS_PER_REGION;
+        uint8_t first, count;
+
+        if (baseAdd + size_in_bytes > regionBase + regionSize)
+            continue;
+
+        // Larger regions only have larger subregions
+        if ((baseAdd | size_in_bytes) & (subRegionSize - 1))
+            return false;
+
+        first = (baseAdd - regionBase) / subRegionSize;
+        count = size_in_bytes / subRegionSize;
+
+        window->base = regionBase;
+        window->attr = ((SRD_DISABLE & ~(((1 << count) - 1) << first)) << 8) |
+                       (sizeField << 1) |
+                       (FULL_ACCESS << 24) |
+                       (0b001 << 28) | // Stacks are not executable
+                       0b1;
+        return true;
+    }
+    return false;
 }
 
 /**
  * @brief
- * Adds access to the requested SRAM adress range
+ * First fit of a stack of size_in_bytes in the chunk, at a place
+ * region 6 can cover exactly
+ *
+ * @return The base of the stack or NULL if it does not fit
  */
-void addSramAccessWindow(uint64_t *srdBitMask, uint32_t *baseAdd, uint32_t size_in_bytes)
+static void *placeStack(STACK_CHUNK *chunk, uint32_t size_in_bytes)
 {
-    /*
-        IMPORTANT:
-        Disabling a subregion means another region overlapping the disabled range
-        matches instead
-    *
-    /*
-        Create a function that adds access to the
-        requested SRAM address range
+    uint8_t count = size_in_bytes / STACK_GRANULE;
+    uint8_t bit;
+    STACK_WINDOW window;
 
-        We are going to assume that programmer does not surpass the
-        subregion disable bits
+    for (bit = 0; bit + count <= chunk->size / STACK_GRANULE; bit++)
+    {
+        uint64_t run = SUBREGION_RUN(bit, count);
+        uint32_t address = (uint32_t)chunk->base + bit * STACK_GRANULE;
 
-        What that means is that if the baseAdd is in R0, the parameter
-        size_in_bytes should not exceed 4096
-    */
+        if ((chunk->freeGranules & run) == run && createStackWindow(&window, address, size_in_bytes))
+        {
+            chunk->freeGranules &= ~run;
+            return (void *)address;
+        }
+    }
+    return NULL;
+}
 
-    uint32_t alignedSize = ALIGN_SIZE(size_in_bytes);
+/**
+ * @brief
+ * Allocates a stack of size_in_bytes (a size from getStackSize()) for the
+ * owner task. Stacks are packed in the stack chunks, a new chunk is taken
+ * from the heap when none has room
+ *
+ * @return The base of the stack or NULL if the heap is full
+ */
+void *mallocStack(uint32_t size_in_bytes, uint8_t owner)
+{
+    uint8_t chunkIdx, empty = MAX_STACK_CHUNKS;
+    STACK_CHUNK *chunk;
+    void *stack;
 
-    // Step 1: Determine base region
-    uint32_t baseRegion = FIND_PTR_BASE(baseAdd);
-    uint32_t startSubregion = ((uint32_t)baseAdd - baseRegion) / FIND_PTR_SUBREGION_SIZE(baseAdd); // Holds a value between 0 and 7
-    uint32_t mask = 0;
+    if (size_in_bytes > STACK_CHUNK_MAX_SIZE)
+        return mallocFromHeap(size_in_bytes, owner);
 
-    // Step 2: Calculate the appropriate mask for the given size
-    if (baseRegion != BASE_R1 && baseRegion != BASE_R2)
+    for (chunkIdx = 0; chunkIdx < MAX_STACK_CHUNKS; chunkIdx++)
     {
-        switch (alignedSize)
+        if (stackChunks[chunkIdx].base == NULL)
         {
-        case 512:
-            mask = 0x01;
-            break;
-        case 1024:
-            mask = 0x03;
-            break;
-        case 1536:
-            mask = 0x07;
-            break;
-        case 2048:
-            mask = 0x0F;
-            break;
-        case 2560:
-            mask = 0x1F;
-            break;
-        case 3072:
-            mask = 0x3F;
-            break;
-        case 3584:
-            mask = 0x7F;
-            break;
-        case 4096:
-            mask = 0xFF;
-            break;
-        default:
-            putsUart0("Error: Unsupported size\n");
-            return;
+            if (empty == MAX_STACK_CHUNKS)
+                empty = chunkIdx;
+            continue;
         }
+
+        stack = placeStack(&stackChunks[chunkIdx], size_in_bytes);
+        if (stack != NULL)
+            return stack;
     }
-    else // Base region is R1 or R2
+
+    if (empty == MAX_STACK_CHUNKS)
+        return NULL;
+
+    chunk = &stackChunks[empty];
+    chunk->base = mallocFromHeap(size_in_bytes, STACK_CHUNK_OWNER);
+    if (chunk->base == NULL)
+        return NULL;
+    chunk->size = getAllocationSize(chunk->base);
+    chunk->freeGranules = SUBREGION_RUN(0, chunk->size / STACK_GRANULE);
+
+    stack = placeStack(chunk, size_in_bytes);
+    if (stack != NULL)
+        return stack;
+
+    // A run across regions region 6 cannot cover, the stack gets the SRD window
+    freeToHeap(chunk->base);
+    chunk->base = NULL;
+    return mallocFromHeap(size_in_bytes, owner);
+}
+
+/**
+ * @brief
+ * Returns a stack allocated with mallocStack() and
+ * gives its chunk back to the heap once the chunk is empty
+ */
+void freeStack(void *stack, uint32_t size_in_bytes)
+{
+    uint8_t chunkIdx;
+
+    for (chunkIdx = 0; chunkIdx < MAX_STACK_CHUNKS; chunkIdx++)
     {
-        switch (alignedSize)
+        STACK_CHUNK *chunk = &stackChunks[chunkIdx];
+        uint32_t offset;
+
+        if (chunk->base == NULL)
+            continue;
+
+        offset = (uint8_t *)stack - chunk->base;
+        if (offset >= chunk->size)
+            continue;
+
+        chunk->freeGranules |= SUBREGION_RUN(offset / STACK_GRANULE, size_in_bytes / STACK_GRANULE);
+        if (chunk->freeGranules == SUBREGION_RUN(0, chunk->size / STACK_GRANULE))
         {
-        case 1024:
-            mask = 0x01;
-            break;
-        case 2048:
-            mask = 0x03;
-            break;
-        case 3072:
-            mask = 0x07;
-            break;
-        case 4096:
-            mask = 0x0F;
-            break;
-        case 5120:
-            mask = 0x1F;
-            break;
-        case 6144:
-            mask = 0x3F;
-            break;
-        case 7168:
-            mask = 0x7F;
-            break;
-        case 8192:
-            mask = 0xFF;
-            break;
-        default:
-            putsUart0("Error: Unsupported size\n");
-            return;
+            freeToHeap(chunk->base);
+            chunk->base = NULL;
         }
+        return;
     }
 
-    // Step 3: Shift the mask to the appropriate subregion position
-    // Again startSubregion is between 0 and 7
-    // Does not overflow because of the assumption that the programmer does not surpass the subregion disable bits
-    mask <<= startSubregion;
+    // Larger stacks are ordinary heap allocations
+    freeToHeap(stack);
+}
+
+/**
+ * @brief
+ * Splits memory into blocks of blockSize bytes and links them all on the free list
+ *
+ * @return false if not even one block fits
+ */
+bool poolInit(POOL *pool, void *memory, uint32_t memorySize, uint32_t blockSize)
+{
+    uint32_t i;
+
+    // Blocks must hold the free list link and stay word aligned
+    blockSize = (blockSize + 3) & ~3;
+    if (blockSize < sizeof(void *))
+        blockSize = sizeof(void *);
 
-    // Step 4: Apply the mask to the SRD bit mask based on the base region
-    switch (baseRegion)
+    pool->base = (uint8_t *)memory;
+    pool->blockSize = blockSize;
+    pool->blockCount = memory != NULL ? memorySize / blockSize : 0;
+    pool->freeList = NULL;
+
+    // Link from the last block so the list starts at the lowest address
+    for (i = pool->blockCount; i > 0; i--)
     {
-    case BASE_R0:
-        *srdBitMask &= ~(mask);
-        break;
-    case BASE_R1:
-        *srdBitMask &= ~(mask << 8);
-        break;
-    case BASE_R2:
-        *srdBitMask &= ~(mask << 16);
-        break;
-    case BASE_R3:
-        *srdBitMask &= ~(mask << 24);
-        break;
-    case BASE_R4:
-        *srdBitMask &= ~(mask << 32);
-        break;
-    default:
-        putsUart0("Error: Invalid base region\n");
+        void **block = (void **)(pool->base + (i - 1) * blockSize);
+        *block = pool->freeList;
+        pool->freeList = block;
+    }
+    return pool->blockCount > 0;
+}
+
+/**
+ * @brief
+ * True if block is the start of one of the pool's blocks
+ */
+static bool isPoolBlock(POOL *pool, void *block)
+{
+    uint32_t offset = (uint8_t *)block - pool->base;
+
+    return (uint8_t *)block >= pool->base && offset < pool->blockCount * pool->blockSize && offset % pool->blockSize == 0;
+}
+
+/**
+ * @brief
+ * Takes a block from the pool, NULL if the pool is empty
+ */
+void *poolAlloc(POOL *pool)
+{
+    void **block = (void **)pool->freeList;
+
+    if (block != NULL)
+        pool->freeList = *block;
+    return block;
+}
+
+/**
+ * @brief
+ * Returns a block to the pool, pointers outside the pool are ignored
+ */
+void poolFree(POOL *pool, void *block)
+{
+    if (!isPoolBlock(pool, block))
         return;
+
+    *(void **)block = pool->freeList;
+    pool->freeList = block;
+}
+
+/**
+ * @brief
+ * ISR safe poolAlloc()
+ */
+void *poolAllocAtomic(POOL *pool)
+{
+    return popFreeListAtomic(&pool->freeList);
+}
+
+/**
+ * @brief
+ * ISR safe poolFree()
+ */
+void poolFreeAtomic(POOL *pool, void *block)
+{
+    if (isPoolBlock(pool, block))
+        pushFreeListAtomic(&pool->freeList, block);
+}
+
+/**
+ * @brief
+ * Create a full-access MPU aperture for flash, the peripherals and the
+ * peripheral bitbanded addresses with RWX access for both privileged and
+ * unprivileged access
+ *
+ * One region covers both so region 6 is free for the stacks, the
+ * peripherals lose the instruction fetch disable they had on their own
+ */
+// REQUIRED: include your solution from the mini project
+void allowFlashAndPeripheralAccess(void)
+{
+    // Set the region number to 5
+    NVIC_MPU_NUMBER_R = FLASH_PERIPHERAL_REGION_IDX;
+    // Set the base address to the start of the address space
+    NVIC_MPU_BASE_R = 0x00000000;
+    // Only the code and the peripheral subregions are enabled
+    NVIC_MPU_ATTR_R = FLASH_PERIPHERAL_SRD << 8;
+    // Set the region size to 4 GiB
+    NVIC_MPU_ATTR_R |= ADDRESS_SPACE_SIZE << 1;
+    // Set the region to RWX
+    NVIC_MPU_ATTR_R |= FULL_ACCESS << 24;
+    // Enable the region
+    NVIC_MPU_ATTR_R |= 0b1 << 0;
+}
+
+/**
+ * @brief
+ * Maps the kernel statistics page with RW access for privileged
+ * and read only access for unprivileged code
+ */
+void allowKernelStatsAccess(void)
+{
+    // Set the region number to 7
+    NVIC_MPU_NUMBER_R = KSTATS_REGION_IDX;
+    // Set the base address to the page, it is aligned to its size
+    NVIC_MPU_BASE_R = (uint32_t)&kernelStats;
+    // Set the region size to 1 KiB
+    NVIC_MPU_ATTR_R = KSTATS_REGION_SIZE << 1;
+    // Set rw for priv and r for unpriv
+    NVIC_MPU_ATTR_R |= READ_ONLY_ACCESS << 24;
+    // Set the Ins fetches to disable
+    NVIC_MPU_ATTR_R |= 0b001 << 28;
+    // Enable the region
+    NVIC_MPU_ATTR_R |= 0b1 << 0;
+}
+
+/**
+ * @brief
+ * Creates one MPU region per entry of HEAP_REGION_LIST to cover the heap
+ * Each region is split in 8 subregions with RW access for privileged
+ * and no access for unprivileged
+ *
+ * -> Disable the subregions to start
+ */
+void setupSramAccess(void)
+{
+    uint8_t regionIdx;
+
+    for (regionIdx = 0; regionIdx < TOTAL_REGIONS; regionIdx++)
+    {
+        // Set the region number
+        NVIC_MPU_NUMBER_R = regionIdx;
+
+        // Set the base address of the region
+        NVIC_MPU_BASE_R = regions[regionIdx].baseAddress;
+
+        // Every subregion is disabled
+        NVIC_MPU_ATTR_R = (SRD_DISABLE << 8);
+
+        // Set the region size, 2^(SIZE + 1) bytes
+        NVIC_MPU_ATTR_R |= regions[regionIdx].sizeField << 1;
+
+        // Set rw for unpriv
+        NVIC_MPU_ATTR_R |= FULL_ACCESS << 24;
+
+        // Enable the region
+        NVIC_MPU_ATTR_R |= 0b1 << 0;
     }
 }
 
+uint64_t createNoSramAccessMask(void)
+{
+    return ALL_SUBREGIONS;
+}
+
+/**
+ * @brief
+ * Adds access to the requested SRAM adress range
+ *
+ * IMPORTANT:
+ * Disabling a subregion means another region overlapping the disabled range
+ * matches instead
+ */
+void addSramAccessWindow(uint64_t *srdBitMask, uint32_t *baseAdd, uint32_t size_in_bytes)
+{
+    // Enabling a subregion clears its SRD bit
+    *srdBitMask &= ~getSubregionMask((uint32_t)baseAdd, size_in_bytes);
+}
+
+/**
+ * @brief
+ * Removes access to the requested SRAM adress range
+ */
+void removeSramAccessWindow(uint64_t *srdBitMask, uint32_t *baseAdd, uint32_t size_in_bytes)
+{
+    *srdBitMask |= getSubregionMask((uint32_t)baseAdd, size_in_bytes);
+}
+
+/**
+ * @brief
+ * True if every subregion in [address, address + size_in_bytes) is enabled
+ * in the SRD bit mask, i.e. an unprivileged task with this mask may access it
+ */
+bool isSramAccessAllowed(uint64_t srdBitMask, uint32_t address, uint32_t size_in_bytes)
+{
+    uint64_t mask = getSubregionMask(address, size_in_bytes);
+
+    return mask != 0 && (srdBitMask & mask) == 0;
+}
+
 /**
  * @brief
  * Applies the SRD bits to the MPU regions.
@@ -586,31 +1198,27 @@ void applySramAccessMask(uint64_t srdBitMask)
         - By enabling the subregions we are adding RW access to
         unprivileged mode
     */
-    // example
-    NVIC_MPU_NUMBER_R = 0;
-    // Zero out SRD bits Easier to convert the SRDBITMASK
-    NVIC_MPU_ATTR_R &= ~(0x0FF << 8);
-    NVIC_MPU_ATTR_R |= (((srdBitMask >> 0) & 0xFF) << 8);
-
-    NVIC_MPU_NUMBER_R = 1;
-    // Zero out SRD bits Easier to convert the SRDBITMASK
-    NVIC_MPU_ATTR_R &= ~(0x0FF << 8);
-    NVIC_MPU_ATTR_R |= (((srdBitMask >> 8) & 0xFF) << 8);
-
-    NVIC_MPU_NUMBER_R = 2;
-    // Zero out SRD bits Easier to convert the SRDBITMASK
-    NVIC_MPU_ATTR_R &= ~(0x0FF << 8);
-    NVIC_MPU_ATTR_R |= (((srdBitMask >> 16) & 0xFF) << 8);
-
-    NVIC_MPU_NUMBER_R = 3;
-    // Zero out SRD bits Easier to convert the SRDBITMASK
-    NVIC_MPU_ATTR_R &= ~(0x0FF << 8);
-    NVIC_MPU_ATTR_R |= (((srdBitMask >> 24) & 0xFF) << 8);
-
-    NVIC_MPU_NUMBER_R = 4;
-    // Zero out SRD bits Easier to convert the SRDBITMASK
-    NVIC_MPU_ATTR_R &= ~(0x0FF << 8);
-    NVIC_MPU_ATTR_R |= (((srdBitMask >> 32) & 0xFF) << 8);
+    uint8_t regionIdx;
+
+    for (regionIdx = 0; regionIdx < TOTAL_REGIONS; regionIdx++)
+    {
+        NVIC_MPU_NUMBER_R = regionIdx;
+        // Zero out SRD bits Easier to convert the SRDBITMASK
+        NVIC_MPU_ATTR_R &= ~(0x0FF << 8);
+        NVIC_MPU_ATTR_R |= (((srdBitMask >> (regionIdx * SUBREGIONS_PER_REGION)) & 0xFF) << 8);
+    }
+}
+
+/**
+ * @brief
+ * Points region 6 at the stack of the task being switched in.
+ * Only called in handler mode, so no task runs with a half moved window
+ */
+void applyStackWindow(const STACK_WINDOW *window)
+{
+    NVIC_MPU_NUMBER_R = STACK_REGION_IDX;
+    NVIC_MPU_BASE_R = window->base;
+    NVIC_MPU_ATTR_R = window->attr;
 }
 
 /**
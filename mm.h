@@ -15,105 +15,342 @@
 
 #include "kernel.h"
 
-#define NUM_SRAM_REGIONS 5
+//-----------------------------------------------------------------------------
+// SRAM layout
+//-----------------------------------------------------------------------------
+/*
+    One line per MPU region covering the heap, in address order:
+        X(MPU region number, base address, MPU SIZE field)
+    The region is 2^(SIZE + 1) bytes split in 8 subregions. Regions must be
+    aligned to their size, contiguous, and between 4 KiB and 64 KiB.
+
+    Everything else (regions[], the address lookup table, the size class
+    masks, the MPU setup) is generated from this list, so moving to another
+    part means editing this list, HEAP_START / TOP_OF_HEAP and the linker
+    command file. At most 5 regions, MPU regions 5-7 are taken.
+
+    The 4 KiB of OS SRAM below the heap hold the kernel globals (tcb[], the
+    handle table, stackChunks: about 2.1 KiB), the statistics page in its
+    last 1 KiB and the 512 B MSP stack. What is left fits the ring of
+    KERNEL_TRACE or of HEAP_TRACE, not both.
+*/
+#define HEAP_REGION_LIST(X)                                               \
+    X(0, 0x20001000, 11) /* R0: 4 KiB, 512 B subregions */               \
+    X(1, 0x20002000, 12) /* R1: 8 KiB, 1 KiB subregions */               \
+    X(2, 0x20004000, 12) /* R2: 8 KiB, 1 KiB subregions */               \
+    X(3, 0x20006000, 11) /* R3: 4 KiB, 512 B subregions */               \
+    X(4, 0x20007000, 11) /* R4: 4 KiB, 512 B subregions */
 
 #define TOP_OF_HEAP 0x20008000
 #define HEAP_START 0x20001000 // Marks the start of the heap
 #define HEAP_END 0x20007FFF   // Marks the end of the heap.
+#define HEAP_SIZE (TOP_OF_HEAP - HEAP_START)
 
-#define MAX_NUM_ALLOCATIONS 40
-#define MAX_SIZE 0x2000
+#define FLASH_END 0x00040000 // 256 KiB of flash
+
+/*
+    Flash and the peripherals share one MPU region: the whole 4 GiB address
+    space in 512 MiB subregions with only the code (0x00000000) and the
+    peripheral (0x40000000) subregions enabled. SRAM and the private
+    peripheral bus fall through to the other regions as before.
+*/
+#define FLASH_PERIPHERAL_REGION_IDX 5
+#define STACK_REGION_IDX 6
+#define ADDRESS_SPACE_SIZE 31 // 2^(31 + 1) = 4 GiB
+#define CODE_SUBREGION 0
+#define PERIPHERAL_SUBREGION 2
+#define FLASH_PERIPHERAL_SRD ((uint8_t) ~((1 << CODE_SUBREGION) | (1 << PERIPHERAL_SUBREGION)))
+
+#define REGION_BYTES(sizeField) (1ul << ((sizeField) + 1))
 
-#define TOTAL_REGIONS 5
-#define TOTAL_8K_REGIONS 2
+#define REGION_COUNT_ONE(idx, base, sizeField) +1
+#define TOTAL_REGIONS (0 HEAP_REGION_LIST(REGION_COUNT_ONE))
+#define NUM_SRAM_REGIONS TOTAL_REGIONS
+
+#define MAX_NUM_ALLOCATIONS 40
+#define MAX_SIZE HEAP_SIZE // Allocations may span every region
 
 #define SUBREGIONS_PER_REGION 8
 
 #define FREE 0
 #define ALLOCATED 1
 
+#define NO_OWNER 0xFF // getAllocationOwner() of an address that is not an allocation
+#define STACK_CHUNK_OWNER 0xFE // Owner of the heap blocks stacks are packed in
+
 #define BLOCK_512 0x200
 #define BLOCK_1024 0x400
 
 #define REGION_8KB 0x2000
 #define REGION_4KB 0x1000
 
-/* 4KB region */
-#define BASE_OS 0x20000000
-#define END_OF_OS 0x20000FFF
-
-/* 4KB region */
-#define BASE_R0 0x20001000
-#define END_OF_R0 0x20001FFF
-
-/* 8KB region */
-#define BASE_R1 0x20002000
-#define END_OF_R1 0X20003FFF
-
-/* 8KB region */
-#define BASE_R2 0x20004000
-#define END_OF_R2 0x20005FFF
+#define ALIGN_SIZE(size) ((size <= BLOCK_512) ? (size + BLOCK_512 - 1) & ~(BLOCK_512 - 1) : (size + BLOCK_1024 - 1) & ~(BLOCK_1024 - 1))
 
-/* 4KB region */
-#define BASE_R3 0x20006000
-#define END_OF_R3 0x20006FFF
+/*
+    Address lookup: the heap is cut in 4 KiB slots (the smallest region) and
+    regionOfSlot[] gives the region of each slot, so an address maps to its
+    subregion with a table read and a shift
+*/
+#define HEAP_SLOT_SHIFT 12
+#define HEAP_SLOTS (HEAP_SIZE >> HEAP_SLOT_SHIFT)
 
-/* 4KB region */
-#define BASE_R4 0x20007000
-#define END_OF_R4 0x20007FFF
+#define REGION_SLOTS_11(idx) idx,
+#define REGION_SLOTS_12(idx) idx, idx,
+#define REGION_SLOTS_13(idx) REGION_SLOTS_12(idx) REGION_SLOTS_12(idx)
+#define REGION_SLOTS_14(idx) REGION_SLOTS_13(idx) REGION_SLOTS_13(idx)
+#define REGION_SLOTS_15(idx) REGION_SLOTS_14(idx) REGION_SLOTS_14(idx)
+#define REGION_SLOT_ENTRY(idx, base, sizeField) REGION_SLOTS_##sizeField(idx)
 
-#define SECTION_SIZE(size) ((size <= BLOCK_512) ? BLOCK_512 : BLOCK_1024)
-#define ALIGN_SIZE(size) ((size <= BLOCK_512) ? (size + BLOCK_512 - 1) & ~(BLOCK_512 - 1) : (size + BLOCK_1024 - 1) & ~(BLOCK_1024 - 1))
+//-----------------------------------------------------------------------------
+// Subregion bitmap
+//-----------------------------------------------------------------------------
+// Bit = region * 8 + subregion, the same numbering as the SRD bit mask
+#define NUM_SUBREGIONS (TOTAL_REGIONS * SUBREGIONS_PER_REGION)
+#define REGION_SUBREGIONS(idx) (0xFFull << ((idx) * SUBREGIONS_PER_REGION))
 
-#define FIND_PTR_BASE(ptr) ((ptr >= BASE_R0 && ptr < END_OF_R0) ? BASE_R0: (ptr >= BASE_R1 && ptr < END_OF_R1) ? BASE_R1: (ptr >= BASE_R2 && ptr < END_OF_R2) ? BASE_R2: \
-(ptr >= BASE_R3 && ptr < END_OF_R3) ? BASE_R3: (ptr >= BASE_R4 && ptr <END_OF_R4) ? BASE_R4: -1)
+// Size classes searched by the allocator, regions with 512 B and with 1 KiB subregions
+#define SMALL_SUBREGION_ENTRY(idx, base, sizeField) | ((REGION_BYTES(sizeField) == REGION_4KB) ? REGION_SUBREGIONS(idx) : 0)
+#define LARGE_SUBREGION_ENTRY(idx, base, sizeField) | ((REGION_BYTES(sizeField) == REGION_8KB) ? REGION_SUBREGIONS(idx) : 0)
+#define SMALL_SUBREGIONS (0 HEAP_REGION_LIST(SMALL_SUBREGION_ENTRY))
+#define LARGE_SUBREGIONS (0 HEAP_REGION_LIST(LARGE_SUBREGION_ENTRY))
 
-#define FIND_PTR_SUBREGION_SIZE(ptr) ((ptr >= BASE_R0 && ptr < END_OF_R0) ? BLOCK_512: (ptr >= BASE_R1 && ptr < END_OF_R1) ? BLOCK_1024: (ptr >= BASE_R2 && ptr < END_OF_R2) ? BLOCK_1024: \
-(ptr >= BASE_R3 && ptr < END_OF_R3) ? BLOCK_512: (ptr >= BASE_R4 && ptr < END_OF_R4) ? BLOCK_512: -1)
+// count bits starting at bit
+#define SUBREGION_RUN(bit, count) ((((count) >= 64) ? ~0ull : ((1ull << (count)) - 1)) << (bit))
+#define ALL_SUBREGIONS SUBREGION_RUN(0, NUM_SUBREGIONS)
 
-#define FIND_PTR_REGION_IDX(ptr) ((ptr >= BASE_R0 && ptr < END_OF_R0) ? R0_IDX: (ptr >= BASE_R1 && ptr < END_OF_R1) ? R1_IDX: (ptr >= BASE_R2 && ptr < END_OF_R2) ? R2_IDX: \
-(ptr >= BASE_R3 && ptr < END_OF_R3) ? R3_IDX: (ptr >= BASE_R4 && ptr < END_OF_R4) ? R4_IDX: -1)
+// Count leading zeros, a single instruction on the Cortex-M4
+#if defined(__TI_ARM__)
+#define CLZ(x) _norm(x)
+#else
+#define CLZ(x) __builtin_clz(x)
+#endif
 
 //-----------------------------------------------------------------------------
 // Mask values for the MPU
 //-----------------------------------------------------------------------------
 #define FULL_ACCESS 0b011  // Full access for unprivileged
+#define READ_ONLY_ACCESS 0b010 // RW for privileged, read only for unprivileged
 #define SRD_DISABLE 0xFF    // Disable all subregions
-#define R0_IDX 0
-#define R1_IDX 1
-#define R2_IDX 2
-#define R3_IDX 3
-#define R4_IDX 4
+#define MIN_SRD_REGION_SIZE 7 // 2^(7 + 1) = 256 B, smaller regions have no subregions
 
 typedef struct
 {
     uint32_t baseAddress;
-    uint16_t regionSize;    // 4KiB or 8KiB
-    uint16_t subRegionSize; // 512B or 1024B
-                            // |= 1 to set a subregion as allocated
-                            // &= 0 to set a subregion as free
-    uint8_t subRegionAllocated[8];
-    uint16_t sizeOfAllocations[8];
-
+    uint32_t regionSize;     // 4KiB or 8KiB on the TM4C123
+    uint16_t subRegionSize;  // 512B or 1024B on the TM4C123
+    uint8_t subRegionShift;  // log2(subRegionSize)
+    uint8_t sizeField;       // MPU SIZE field, regionSize = 2^(sizeField + 1)
 } MEM_REGION;
 
-dynamicMemoryOfEachTask[MAX_TASKS];
+// SIZE field n: region 2^(n + 1), subregion 2^(n + 1) / 8 = 2^(n - 2)
+#define MEM_REGION_ENTRY(idx, base, sizeField) {base, REGION_BYTES(sizeField), REGION_BYTES(sizeField) / SUBREGIONS_PER_REGION, (sizeField) - 2, sizeField},
+
+extern const MEM_REGION regions[TOTAL_REGIONS];
+
+/*
+    Fixed size block pool
+
+    The pool lives in memory the caller can already access: a task passes a
+    block from malloc_from_heap_wrapper() (its MPU window), the kernel passes
+    a block from mallocFromHeap(). Free blocks are linked through their first
+    word so alloc and free are O(1) and the pool needs no extra memory.
+
+    poolAlloc()/poolFree() must not be interrupted by code using the same pool.
+    poolAllocAtomic()/poolFreeAtomic() use LDREX/STREX and may be used from
+    ISRs and tasks at the same time, unprivileged code included.
+*/
+typedef struct _POOL
+{
+    void *freeList;     // First free block, each free block holds the address of the next
+    uint8_t *base;
+    uint32_t blockSize; // Multiple of 4 bytes
+    uint32_t blockCount;
+} POOL;
+
+/*
+    Task stacks
+
+    MPU region 6 is moved on every task switch to cover the running task's
+    stack and nothing else, so stacks do not need whole heap subregions.
+    Stacks are packed in heap blocks (chunks) owned by the kernel, which are
+    never in a task's SRD window.
+
+    - The stack size is rounded up to an eighth of the next power of two
+      (a subregion of the smallest region that holds it), at least
+      STACK_GRANULE, e.g. 600 B -> 640 B, 1100 B -> 1280 B
+    - A stack is placed where one region with some subregions disabled
+      can cover it exactly, in the first chunk with such a place
+    - A new chunk is the block ALIGN_SIZE() would have given the stack, so
+      a stack never takes more heap than before and later stacks fill the
+      rest (e.g. a 384 B stack after a 640 B one)
+    - A chunk goes back to the heap when its last stack is freed
+    - Stacks larger than STACK_CHUNK_MAX_SIZE are allocated from the heap as
+      before and use region 6 only if it can cover them, else the SRD window
+
+    Region 6 is numbered above the heap regions, so where it overlaps them
+    its access rules win.
+*/
+#define STACK_CHUNK_MAX_SIZE 4096
+#define STACK_GRANULE (STACK_CHUNK_MAX_SIZE / 64) // One bit of freeGranules
+#define STACK_MIN_SIZE 256
+#define MAX_STACK_CHUNKS MAX_TASKS
+
+typedef struct _STACK_CHUNK
+{
+    uint8_t *base;         // NULL if the chunk is not allocated
+    uint32_t size;
+    uint64_t freeGranules; // bit set = STACK_GRANULE bytes free
+} STACK_CHUNK;
+
+// MPU register values of region 6 for one task
+typedef struct _STACK_WINDOW
+{
+    uint32_t base; // RBAR
+    uint32_t attr; // RASR, 0 keeps the region disabled
+} STACK_WINDOW;
+
+/*
+    Placement policies of mallocFromHeap(), selected at run time
+
+    - ALLOC_SEGREGATED: up to 512 B in the 512 B subregions, larger blocks
+      in the 1 KiB subregions then in the 512 B ones, first fit in each
+      class, spanning both only when neither has room (the default)
+    - ALLOC_FIRST_FIT: lowest address run of free subregions that holds the
+      request, whatever their size
+    - ALLOC_BEST_FIT: the free run with the least bytes that holds the
+      request, ties go to the lowest address
+
+    The first and best fit policies round the request to subregions instead
+    of ALIGN_SIZE(), e.g. 1536 B takes three 512 B subregions.
+*/
+#define ALLOC_SEGREGATED 0
+#define ALLOC_FIRST_FIT 1
+#define ALLOC_BEST_FIT 2
+#define NUM_ALLOC_POLICIES 3
+
+// Histogram of the free runs: 512 B, 1 KiB, 2 KiB, 4 KiB, 8 KiB, 16 KiB and more
+#define FREE_RUN_BUCKETS 6
+#define FREE_RUN_MIN_SHIFT 9 // log2(512), first bucket
+
+// Copy of the allocator state with fragmentation metrics, see readHeapMap()
+typedef struct _HEAP_MAP
+{
+    uint64_t freeSubregions;               // bit set = subregion free
+    uint64_t allocationStarts;             // bit set = first subregion of an allocation
+    uint8_t owner[NUM_SUBREGIONS];         // task owning each subregion, NO_OWNER if free
+    uint32_t regionUsed[NUM_SRAM_REGIONS]; // bytes allocated in each region
+    uint32_t freeBytes;
+    uint32_t largestFreeRun;               // bytes, the largest request that can succeed
+    uint16_t freeRuns[FREE_RUN_BUCKETS];   // number of free runs of each size
+    uint32_t failedAllocations;            // mallocFromHeap() calls that returned NULL
+    uint8_t policy;
+} HEAP_MAP;
+
+/*
+    Allocation trace, built in with HEAP_TRACE defined
+
+    mallocFromHeap(), freeToHeap(), reallocFromHeap(), freeAllOfOwner() and
+    compaction add a record to a ring of the last HEAP_TRACE_SIZE operations
+    (stacks included, they are heap blocks too). readHeapTrace() drains it,
+    the shell's heaptrace command prints it as text for host/heapbench -r,
+    which replays it against any placement policy. Records overwritten
+    before they were read are counted in dropped.
+
+    address is the block passed in (free, realloc, move), result the block
+    given back (malloc, realloc, move), 0 if the call failed
+*/
+#define HEAP_TRACE_SIZE 16 // 192 B of the 4 KiB of OS SRAM, see HEAP_REGION_LIST
+#define HEAP_TRACE_MALLOC 1
+#define HEAP_TRACE_FREE 2
+#define HEAP_TRACE_REALLOC 3
+#define HEAP_TRACE_MOVE 4 // compactHeapStep() moved a handle block
+
+typedef struct _HEAP_TRACE_RECORD
+{
+    uint32_t address;
+    uint32_t result;
+    uint16_t size;  // bytes requested, 0xFFFF for larger requests
+    uint8_t op;
+    uint8_t owner;
+} HEAP_TRACE_RECORD;
+
+/*
+    Relocatable blocks
+
+    hmalloc() returns a HANDLE instead of a pointer. The task locks the
+    handle to get a pointer and unlocks it when it is done, the block is in
+    the task's SRD window only while it is locked. Blocks that are not
+    locked may be moved by compactHeapStep(), which the idle task calls, so
+    a pointer must not be kept across hunlock().
+
+    - Locks nest, the window closes on the last hunlock()
+    - Compaction moves one unlocked block per call to the lowest free run
+      of the same size below it, raw malloc_from_heap_wrapper() blocks and
+      stacks never move
+    - A handle is (generation << 8) | index, freeing bumps the generation
+      so a stale handle is rejected instead of reaching a reused entry
+*/
+#define MAX_HANDLES 16 // In the OS SRAM, see HEAP_REGION_LIST
+#define NO_HANDLE 0xFF
+#define HANDLE_GENERATION_SHIFT 8
+#define HANDLE_INDEX(handle) ((handle) & 0xFF)
+
+typedef struct _HANDLE_ENTRY
+{
+    void *block;         // NULL if the entry is free
+    uint16_t generation; // Never 0, so no valid handle is 0
+    uint8_t owner;
+    uint8_t lockCount;
+} HANDLE_ENTRY;
+
+extern uint32_t dynamicMemoryOfEachTask[MAX_TASKS]; // Bytes allocated by each task, stack excluded
 
 //-----------------------------------------------------------------------------
 // Subroutines
 //-----------------------------------------------------------------------------
 
-void * mallocFromHeap(uint32_t size_in_bytes);
-void *allocate_from_subregion(uint32_t size);   // Added 10/29/24
+void * mallocFromHeap(uint32_t size_in_bytes, uint8_t owner);
 void freeToHeap(void *pMemory);
+void *reallocFromHeap(void *pMemory, uint32_t size_in_bytes);
+uint32_t getAllocationSize(void *pMemory);
+uint8_t getAllocationOwner(void *pMemory);
+uint32_t freeAllOfOwner(uint8_t owner);
+int8_t getSubregionBit(uint32_t address);
+uint32_t getSubregionAddress(uint8_t bit);
+uint64_t getSubregionMask(uint32_t address, uint32_t size_in_bytes);
+uint32_t getRunSize(uint8_t bit, uint8_t count);
+void getHeapBitmap(uint8_t bitmap[NUM_SRAM_REGIONS]);
+bool setAllocationPolicy(uint8_t policy);
+
+HANDLE mallocHandle(uint32_t size_in_bytes, uint8_t owner);
+HANDLE_ENTRY *getHandle(HANDLE handle, uint8_t owner);
+void freeHandle(HANDLE handle);
+bool isHandleBlock(void *pMemory);
+bool compactHeapStep(void);
+void readHeapMap(HEAP_MAP *map);
+uint32_t readHeapTrace(HEAP_TRACE_RECORD records[], uint32_t count, uint32_t *dropped);
+
+uint32_t getStackSize(uint32_t stackBytes);
+void *mallocStack(uint32_t size_in_bytes, uint8_t owner);
+void freeStack(void *stack, uint32_t size_in_bytes);
+bool createStackWindow(STACK_WINDOW *window, uint32_t baseAdd, uint32_t size_in_bytes);
+void applyStackWindow(const STACK_WINDOW *window);
+
+bool poolInit(POOL *pool, void *memory, uint32_t memorySize, uint32_t blockSize);
+void *poolAlloc(POOL *pool);
+void poolFree(POOL *pool, void *block);
+void *poolAllocAtomic(POOL *pool);
+void poolFreeAtomic(POOL *pool, void *block);
 
 void enableMPU(void);
 
-void allowFlashAccess(void);
-void allowPeripheralAccess(void);
+void allowFlashAndPeripheralAccess(void);
+void allowKernelStatsAccess(void);
 void setupSramAccess(void);
 uint64_t createNoSramAccessMask(void);
 void addSramAccessWindow(uint64_t *srdBitMask, uint32_t *baseAdd, uint32_t size_in_bytes);
+void removeSramAccessWindow(uint64_t *srdBitMask, uint32_t *baseAdd, uint32_t size_in_bytes);
 void applySramAccessMask(uint64_t srdBitMask);
+bool isSramAccessAllowed(uint64_t srdBitMask, uint32_t address, uint32_t size_in_bytes);
 
 #endif
@@ -0,0 +1,26 @@
+// Clock Library for the mps2-an386
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: QEMU mps2-an386, built by qemu/Makefile
+// Target uC:       Cortex-M4
+// System Clock:    25 MHz
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#include <stdint.h>
+#include "clock.h"
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+// SYSCLK is fixed at 25 MHz on this machine, there is no PLL to program.
+// SYSTEM_CLOCK_HZ (hal.h) follows it so the tick stays at 1 ms
+void initSystemClockTo40Mhz(void)
+{
+}
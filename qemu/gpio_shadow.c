@@ -0,0 +1,213 @@
+// GPIO Library for the mps2-an386, pins kept in a shadow
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: QEMU mps2-an386, built by qemu/Makefile
+// Target uC:       Cortex-M4
+// System Clock:    -
+
+// Hardware configuration:
+// No LEDs or pushbuttons, see below
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "gpio.h"
+
+/*
+    Same interface as gpio.c. The TM4C ports do not exist on this machine
+    and their bit-band aliases land on the CMSDK UARTs and timers, so each
+    port is a few bytes of RAM instead: outputs hold the value last written,
+    inputs with a pull-up read high (pushbuttons released).
+
+    The shadow is placed in SSRAM1 by mps2_an386.cmd, inside the flash and
+    peripheral aperture of MPU region 5, so unprivileged tasks can drive
+    LEDs the same way they write port registers on the board.
+*/
+#define GPIO_PORTS 6
+
+typedef struct _GPIO_SHADOW
+{
+    uint8_t data;
+    uint8_t output;
+    uint8_t pullup;
+} GPIO_SHADOW;
+
+//-----------------------------------------------------------------------------
+// Global variables
+//-----------------------------------------------------------------------------
+
+#pragma DATA_SECTION(gpioShadow, ".gpio")
+GPIO_SHADOW gpioShadow[GPIO_PORTS];
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+static GPIO_SHADOW *getShadow(PORT port)
+{
+    switch(port)
+    {
+        case PORTA:
+            return &gpioShadow[0];
+        case PORTB:
+            return &gpioShadow[1];
+        case PORTC:
+            return &gpioShadow[2];
+        case PORTD:
+            return &gpioShadow[3];
+        case PORTE:
+            return &gpioShadow[4];
+        default:
+            return &gpioShadow[5];
+    }
+}
+
+static void setInputLevel(GPIO_SHADOW *shadow, uint8_t pin)
+{
+    if (shadow->pullup & (1 << pin))
+        shadow->data |= 1 << pin;
+    else
+        shadow->data &= ~(1 << pin);
+}
+
+void enablePort(PORT port)
+{
+}
+
+void disablePort(PORT port)
+{
+}
+
+void selectPinPushPullOutput(PORT port, uint8_t pin)
+{
+    getShadow(port)->output |= 1 << pin;
+}
+
+void selectPinOpenDrainOutput(PORT port, uint8_t pin)
+{
+    getShadow(port)->output |= 1 << pin;
+}
+
+void selectPinDigitalInput(PORT port, uint8_t pin)
+{
+    GPIO_SHADOW *shadow = getShadow(port);
+
+    shadow->output &= ~(1 << pin);
+    setInputLevel(shadow, pin);
+}
+
+void selectPinAnalogInput(PORT port, uint8_t pin)
+{
+    selectPinDigitalInput(port, pin);
+}
+
+void setPinCommitControl(PORT port, uint8_t pin)
+{
+}
+
+void enablePinPullup(PORT port, uint8_t pin)
+{
+    GPIO_SHADOW *shadow = getShadow(port);
+
+    shadow->pullup |= 1 << pin;
+    if (!(shadow->output & (1 << pin)))
+        setInputLevel(shadow, pin);
+}
+
+void disablePinPullup(PORT port, uint8_t pin)
+{
+    GPIO_SHADOW *shadow = getShadow(port);
+
+    shadow->pullup &= ~(1 << pin);
+    if (!(shadow->output & (1 << pin)))
+        setInputLevel(shadow, pin);
+}
+
+void enablePinPulldown(PORT port, uint8_t pin)
+{
+    disablePinPullup(port, pin);
+}
+
+void disablePinPulldown(PORT port, uint8_t pin)
+{
+}
+
+void setPinAuxFunction(PORT port, uint8_t pin, uint32_t fn)
+{
+}
+
+// There are no edges on a shadow, pin interrupts never fire
+void selectPinInterruptRisingEdge(PORT port, uint8_t pin)
+{
+}
+
+void selectPinInterruptFallingEdge(PORT port, uint8_t pin)
+{
+}
+
+void selectPinInterruptBothEdges(PORT port, uint8_t pin)
+{
+}
+
+void selectPinInterruptHighLevel(PORT port, uint8_t pin)
+{
+}
+
+void selectPinInterruptLowLevel(PORT port, uint8_t pin)
+{
+}
+
+void enablePinInterrupt(PORT port, uint8_t pin)
+{
+}
+
+void disablePinInterrupt(PORT port, uint8_t pin)
+{
+}
+
+void clearPinInterrupt(PORT port, uint8_t pin)
+{
+}
+
+void setPinValue(PORT port, uint8_t pin, bool value)
+{
+    GPIO_SHADOW *shadow = getShadow(port);
+
+    if (!(shadow->output & (1 << pin)))
+        return;
+    if (value)
+        shadow->data |= 1 << pin;
+    else
+        shadow->data &= ~(1 << pin);
+}
+
+void togglePinValue(PORT port, uint8_t pin)
+{
+    GPIO_SHADOW *shadow = getShadow(port);
+
+    if (shadow->output & (1 << pin))
+        shadow->data ^= 1 << pin;
+}
+
+bool getPinValue(PORT port, uint8_t pin)
+{
+    return getShadow(port)->data & (1 << pin);
+}
+
+void setPortValue(PORT port, uint8_t value)
+{
+    GPIO_SHADOW *shadow = getShadow(port);
+
+    shadow->data = (shadow->data & ~shadow->output) | (value & shadow->output);
+}
+
+uint8_t getPortValue(PORT port)
+{
+    return getShadow(port)->data;
+}
@@ -0,0 +1,44 @@
+/******************************************************************************
+ *
+ * Linker command file for the QEMU mps2-an386 machine (Cortex-M4)
+ *
+ * Same layout as tm4c123gh6pm.cmd so FLASH_END, the OS SRAM and the heap
+ * regions keep their addresses. The image is loaded into SSRAM1 at 0 which
+ * is writable, the GPIO shadow lives there just past the 256 KiB the kernel
+ * treats as flash, inside the flash aperture tasks may access (MPU region 5).
+ *
+ *****************************************************************************/
+
+--retain=g_pfnVectors
+
+MEMORY
+{
+    FLASH (RX) : origin = 0x00000000, length = 0x00040000
+    SHADOW (RW): origin = 0x00040000, length = 0x00000100
+    SRAM (RWX) : origin = 0x20000000, length = 0x00001000
+    HEAP (RWX) : origin = 0x20001000, length = 0x00007000
+}
+
+/* Section allocation in memory */
+
+SECTIONS
+{
+    .intvecs:   > 0x00000000
+    .text   :   > FLASH
+    .const  :   > FLASH
+    .cinit  :   > FLASH
+    .pinit  :   > FLASH
+    .init_array : > FLASH
+
+    .gpio   :   > SHADOW /* pin state of gpio_shadow.c */
+
+    .vtable :   > 0x20000000
+    .data   :   > SRAM
+    .bss    :   > SRAM
+    .kstats :   > 0x20000C00  /* kernel statistics page, the last 1 KiB of SRAM: aligned for the MPU without padding */
+    .sysmem :   > SRAM
+    .stack  :   > SRAM
+    .heap   :   > HEAP
+}
+
+__STACK_TOP = __stack + 512;
@@ -0,0 +1,104 @@
+// Benchmark report for the QEMU build
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: QEMU mps2-an386, built by qemu/Makefile
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "kernel.h"
+#include "kstats.h"
+#include "shell_auxiliary.h"
+#include "semihost.h"
+#include "report.h"
+
+/*
+    A timed run: "make -C qemu bench RUN_MS=<ms>" passes the run time as
+    the last semihosting argument. The Report task sleeps that long while the other
+    tasks run, writes the kernel statistics over semihosting as CSV lines
+
+        ticks,<systemTicks>
+        task,<name>,<priority>,<cpuTicks>,<dynamicMemory>
+
+    and stops the emulator, so runs under -icount can be compared from one
+    build to the next. Without a run time the task is not created.
+*/
+#define REPORT_CMDLINE_SIZE 96
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+/**
+ * @brief
+ * Run time in ms from the last word of the semihosting command line
+ *
+ * @return 0 if there is none
+ */
+uint32_t getQemuRunTime(void)
+{
+    char cmdline[REPORT_CMDLINE_SIZE];
+    uint32_t runTime = 0;
+    uint8_t i;
+
+    if (!semihostGetCmdline(cmdline, sizeof(cmdline)))
+        return 0;
+
+    for (i = 0; i < sizeof(cmdline) && cmdline[i] != '\0'; i++)
+    {
+        if (cmdline[i] == ' ')
+            runTime = 0;
+        else if (cmdline[i] >= ASCII_0 && cmdline[i] <= ASCII_9)
+            runTime = runTime * 10 + cmdline[i] - ASCII_0;
+        else
+            runTime = 0;
+    }
+    return runTime;
+}
+
+static void reportField(const char *field, bool last)
+{
+    semihostPuts(field);
+    semihostPuts(last ? "\n" : ",");
+}
+
+static void reportNumber(uint32_t value, bool last)
+{
+    char str[11];
+
+    itoa(value, str, 10);
+    reportField(str, last);
+}
+
+/**
+ * @brief
+ * Task that ends a timed run with the statistics report
+ */
+void qemuReport(void)
+{
+    KSTATS stats;
+    uint8_t i;
+
+    sleep(getQemuRunTime());
+    readKernelStats(&stats);
+
+    reportField("ticks", false);
+    reportNumber(stats.systemTicks, true);
+    for (i = 0; i < stats.taskCount; i++)
+    {
+        if (!stats.tasks[i].pid)
+            continue;
+        reportField("task", false);
+        reportField(stats.tasks[i].name, false);
+        reportNumber(stats.tasks[i].priority, false);
+        reportNumber(stats.tasks[i].cpuTicks, false);
+        reportNumber(stats.tasks[i].dynamicMemory, true);
+    }
+    semihostExit(true);
+}
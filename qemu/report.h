@@ -0,0 +1,21 @@
+// Benchmark report for the QEMU build
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: QEMU mps2-an386, built by qemu/Makefile
+
+#ifndef REPORT_H_
+#define REPORT_H_
+
+#include <stdint.h>
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+uint32_t getQemuRunTime(void);
+void qemuReport(void);
+
+#endif
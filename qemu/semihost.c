@@ -0,0 +1,58 @@
+// Semihosting
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: QEMU mps2-an386, built by qemu/Makefile
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "semihost.h"
+
+typedef struct _SEMIHOST_CMDLINE
+{
+    char *buffer;
+    uint32_t size;
+} SEMIHOST_CMDLINE;
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+/**
+ * @brief
+ * Writes a string to the host, separately from UART0 (QEMU's stdout, or
+ * the chardev given with -semihosting-config)
+ */
+void semihostPuts(const char *str)
+{
+    semihostCall(SEMIHOST_SYS_WRITE0, str);
+}
+
+/**
+ * @brief
+ * Copies the command line (the arg= values of -semihosting-config, or the
+ * image name and the -append string) into buffer
+ *
+ * @return false if there is no command line or it does not fit
+ */
+bool semihostGetCmdline(char *buffer, uint32_t size)
+{
+    SEMIHOST_CMDLINE block = {buffer, size};
+
+    return semihostCall(SEMIHOST_SYS_GET_CMDLINE, &block) == 0;
+}
+
+/**
+ * @brief
+ * Stops the emulator, ok selects QEMU's exit status
+ */
+void semihostExit(bool ok)
+{
+    semihostCall(SEMIHOST_SYS_EXIT, (const void *)(ok ? SEMIHOST_APPLICATION_EXIT : SEMIHOST_RUNTIME_ERROR));
+}
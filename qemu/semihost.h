@@ -0,0 +1,38 @@
+// Semihosting
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: QEMU mps2-an386, built by qemu/Makefile
+
+#ifndef SEMIHOST_H_
+#define SEMIHOST_H_
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Operations from the ARM semihosting specification
+#define SEMIHOST_SYS_WRITE0 0x04
+#define SEMIHOST_SYS_GET_CMDLINE 0x15
+#define SEMIHOST_SYS_EXIT 0x18
+
+// SYS_EXIT reasons, QEMU exits with 0 for the first and 1 otherwise
+#define SEMIHOST_APPLICATION_EXIT 0x20026
+#define SEMIHOST_RUNTIME_ERROR 0x20023
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+uint32_t semihostCall(uint32_t operation, const void *parameter);
+
+void semihostPuts(const char *str);
+bool semihostGetCmdline(char *buffer, uint32_t size);
+void semihostExit(bool ok);
+
+#endif
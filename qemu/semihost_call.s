@@ -0,0 +1,14 @@
+; Semihosting entry for the QEMU mps2-an386 build
+; QEMU runs the request when -semihosting-config enable=on is given, add
+; userspace=on for calls made by unprivileged tasks
+
+.text
+
+;********************************************************************************
+; @brief
+; Semihosting request: operation in r0, parameter block (or value) in r1,
+; the result comes back in r0
+    .def semihostCall
+semihostCall:
+    bkpt #0xab
+    bx lr
@@ -0,0 +1,62 @@
+// Stress suite hooks for the QEMU build
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: QEMU mps2-an386, built by qemu/Makefile
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "stress.h"
+#include "semihost.h"
+
+/*
+    "make -C qemu stress SCENARIO=..." passes the semihosting command line
+    "rtos stress <words>", the scenario is everything after "stress"
+*/
+#define STRESS_CMDLINE_PREFIX "rtos stress "
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+/**
+ * @brief
+ * Scenario from the semihosting command line
+ *
+ * @return false if the run is not a stress run
+ */
+bool stressGetConfig(char config[], uint32_t size)
+{
+    const char *prefix = STRESS_CMDLINE_PREFIX;
+    uint32_t i;
+
+    if (!semihostGetCmdline(config, size))
+        return false;
+
+    for (i = 0; prefix[i] != '\0'; i++)
+    {
+        if (config[i] != prefix[i])
+            return false;
+    }
+
+    // Drop the prefix
+    for (i = 0; config[i + sizeof(STRESS_CMDLINE_PREFIX) - 1] != '\0'; i++)
+        config[i] = config[i + sizeof(STRESS_CMDLINE_PREFIX) - 1];
+    config[i] = '\0';
+    return true;
+}
+
+/**
+ * @brief
+ * Stops the emulator, the verdict is QEMU's exit status
+ */
+void stressExit(bool ok)
+{
+    semihostExit(ok);
+}
@@ -0,0 +1,91 @@
+// UART0 Library for the mps2-an386 CMSDK APB UART
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: QEMU mps2-an386, built by qemu/Makefile
+// Target uC:       Cortex-M4
+// System Clock:    25 MHz
+
+// Hardware configuration:
+// UART Interface:
+//   CMSDK APB UART0 at 0x40004000, connected to QEMU's first serial port
+//   (stdin/stdout with -nographic)
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "uart0.h"
+
+/*
+    Same interface as uart0.c. The TM4C UART and its pins do not exist on
+    this machine, 0x40004000 is the CMSDK UART (TM4C port A on the board).
+    QEMU drops transmitted characters until BAUDDIV is at least 16, the
+    actual rate has no effect on the emulated line.
+*/
+#define UART0_DATA_R            (*((volatile uint32_t *)0x40004000))
+#define UART0_STATE_R           (*((volatile uint32_t *)0x40004004))
+#define UART0_CTRL_R            (*((volatile uint32_t *)0x40004008))
+#define UART0_BAUDDIV_R         (*((volatile uint32_t *)0x40004010))
+
+#define UART_STATE_TXFULL       0x00000001
+#define UART_STATE_RXFULL       0x00000002
+#define UART_CTRL_TXEN          0x00000001
+#define UART_CTRL_RXEN          0x00000002
+
+#define UART_SYSCLK             25000000
+#define UART_MIN_BAUDDIV        16
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+// Initialize UART0
+void initUart0()
+{
+    setUart0BaudRate(115200, UART_SYSCLK);
+}
+
+// Set baud rate as function of instruction cycle frequency
+void setUart0BaudRate(uint32_t baudRate, uint32_t fcyc)
+{
+    uint32_t divisor = UART_SYSCLK / baudRate;          // fcyc assumes the TM4C PLL, the UART runs from SYSCLK
+
+    if (divisor < UART_MIN_BAUDDIV)
+        divisor = UART_MIN_BAUDDIV;
+    UART0_CTRL_R = 0;                                   // turn-off UART0 to allow safe programming
+    UART0_BAUDDIV_R = divisor;
+    UART0_CTRL_R = UART_CTRL_TXEN | UART_CTRL_RXEN;     // turn-on UART0
+}
+
+// Blocking function that writes a serial character when the UART buffer is not full
+void putcUart0(char c)
+{
+    while (UART0_STATE_R & UART_STATE_TXFULL);          // wait if uart0 tx buffer full
+    UART0_DATA_R = c;
+}
+
+// Blocking function that writes a string when the UART buffer is not full
+void putsUart0(const char* str)
+{
+    uint8_t i = 0;
+    while (str[i] != '\0')
+        putcUart0(str[i++]);
+}
+
+// Blocking function that returns with serial data once the buffer is not empty
+char getcUart0()
+{
+    while (!(UART0_STATE_R & UART_STATE_RXFULL));       // wait if uart0 rx buffer empty
+    return UART0_DATA_R & 0xFF;
+}
+
+// Returns the status of the receive buffer
+bool kbhitUart0()
+{
+    return UART0_STATE_R & UART_STATE_RXFULL;
+}
@@ -0,0 +1,294 @@
+// Binary command interface
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target uC:       TM4C123GH6PM
+// System Clock:    40 MHz
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#include <stdint.h>
+#include "tm4c123gh6pm.h"
+#include "rpc.h"
+#include "kernel.h"
+#include "uart0.h"
+#include "telemetry.h"
+#include "shell_auxiliary.h"
+#include "shell_commands.h"
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+static uint16_t putU32(uint8_t *buffer, uint16_t idx, uint32_t value)
+{
+    buffer[idx++] = value & 0xFF;
+    buffer[idx++] = (value >> 8) & 0xFF;
+    buffer[idx++] = (value >> 16) & 0xFF;
+    buffer[idx++] = (value >> 24) & 0xFF;
+    return idx;
+}
+
+static uint32_t getU32(const uint8_t *buffer)
+{
+    return buffer[0] | (buffer[1] << 8) | ((uint32_t)buffer[2] << 16) | ((uint32_t)buffer[3] << 24);
+}
+
+/**
+ * @brief
+ * Copies a name and its null terminator, returns the next write index
+ */
+static uint16_t putName(uint8_t *buffer, uint16_t idx, const char name[])
+{
+    uint8_t i = 0;
+    while (name[i] != 0)
+        buffer[idx++] = name[i++];
+    buffer[idx++] = 0;
+    return idx;
+}
+
+/**
+ * @brief
+ * Same operation as the shell's ps command.
+ * The result is written at result[0] and must not go past result[space - 1]
+ *
+ * @return status, *length holds the result length
+ */
+static uint8_t rpcPs(uint8_t *result, uint16_t space, uint16_t *length)
+{
+    uint32_t pidsArray[MAX_TASKS] = {0};
+    char namesOfTasks[MAX_TASKS][10] = {0};
+    uint32_t statesArray[MAX_TASKS] = {0};
+    uint8_t mutex_semaphore_array[MAX_TASKS] = {0};
+    uint16_t needed = 1;
+    uint16_t idx = 1;
+    uint8_t i, count = 0;
+
+    ps(pidsArray, namesOfTasks, statesArray, mutex_semaphore_array);
+
+    for (i = 0; i < MAX_TASKS; i++)
+    {
+        if (pidsArray[i])
+            needed += 6 + stringLength(namesOfTasks[i]) + 1;
+    }
+    if (needed > space)
+        return RPC_STATUS_NO_SPACE;
+
+    for (i = 0; i < MAX_TASKS; i++)
+    {
+        if (pidsArray[i])
+        {
+            idx = putU32(result, idx, pidsArray[i]);
+            result[idx++] = statesArray[i];
+            result[idx++] = mutex_semaphore_array[i];
+            idx = putName(result, idx, namesOfTasks[i]);
+            count++;
+        }
+    }
+    result[0] = count;
+    *length = idx;
+
+    return RPC_STATUS_OK;
+}
+
+/**
+ * @brief
+ * Same operation as the shell's meminfo command
+ */
+static uint8_t rpcMeminfo(uint8_t *result, uint16_t space, uint16_t *length)
+{
+    char listOfTasks[MAX_TASKS][10] = {0};
+    uint32_t dynamicMemOfEachTask[MAX_TASKS] = {0};
+    uint32_t baseAddress[MAX_TASKS] = {0};
+    uint32_t sizeOfTask[MAX_TASKS] = {0};
+    uint8_t taskCount = meminfo(listOfTasks, baseAddress, sizeOfTask, dynamicMemOfEachTask);
+    uint16_t needed = 1;
+    uint16_t idx = 1;
+    uint8_t i;
+
+    for (i = 0; i < taskCount; i++)
+        needed += 12 + stringLength(listOfTasks[i]) + 1;
+    if (needed > space)
+        return RPC_STATUS_NO_SPACE;
+
+    for (i = 0; i < taskCount; i++)
+    {
+        idx = putU32(result, idx, baseAddress[i]);
+        idx = putU32(result, idx, sizeOfTask[i]);
+        idx = putU32(result, idx, dynamicMemOfEachTask[i]);
+        idx = putName(result, idx, listOfTasks[i]);
+    }
+    result[0] = taskCount;
+    *length = idx;
+
+    return RPC_STATUS_OK;
+}
+
+static uint8_t rpcPidof(const uint8_t *args, uint8_t argLength, uint8_t *result, uint16_t space, uint16_t *length)
+{
+    char name[16];
+    uint32_t pid;
+    uint8_t i;
+
+    if (argLength == 0 || argLength >= sizeof(name))
+        return RPC_STATUS_BAD_ARGS;
+    if (space < 4)
+        return RPC_STATUS_NO_SPACE;
+
+    for (i = 0; i < argLength; i++)
+        name[i] = args[i];
+    name[i] = 0;
+
+    pid = pidof(name);
+    if (!pid)
+        return RPC_STATUS_NOT_FOUND;
+
+    *length = putU32(result, 0, pid);
+    return RPC_STATUS_OK;
+}
+
+/**
+ * @brief
+ * Executes every op of a decoded request (CRC already removed) and
+ * builds the response frame.
+ *
+ * @return false when the host asked to go back to the text shell
+ */
+bool rpcHandleRequest(uint8_t *request, uint16_t length, uint8_t *response)
+{
+    uint16_t readIdx = 4;
+    uint16_t writeIdx = 4;
+    uint8_t opCount = request[3];
+    uint8_t done = 0;
+    bool stay = true;
+
+    // Type, request id and op count
+    response[0] = RPC_FRAME_RESPONSE;
+    response[1] = request[1];
+    response[2] = request[2];
+
+    while (done < opCount && readIdx + 2 <= length)
+    {
+        uint8_t op = request[readIdx];
+        uint8_t argLength = request[readIdx + 1];
+        uint8_t *args = &request[readIdx + 2];
+        uint8_t *result = &response[writeIdx + 4];
+        uint16_t resultLength = 0;
+        uint8_t status = RPC_STATUS_OK;
+
+        // Room for the op header and the CRC of the response
+        if (writeIdx + 4 + 2 > RPC_MAX_FRAME)
+            break;
+        uint16_t space = RPC_MAX_FRAME - writeIdx - 4 - 2;
+
+        readIdx += 2 + argLength;
+        if (readIdx > length)
+            break;
+
+        switch (op)
+        {
+        case RPC_OP_PING:
+            break;
+        case RPC_OP_PS:
+            status = rpcPs(result, space, &resultLength);
+            break;
+        case RPC_OP_KILL:
+            if (argLength != 4)
+                status = RPC_STATUS_BAD_ARGS;
+            else if (!kill(getU32(args)))
+                status = RPC_STATUS_NOT_FOUND;
+            break;
+        case RPC_OP_SCHED:
+            if (argLength == 1)
+                sched(args[0] ? PRIORITY_SCHEDULER : ROUND_ROBIN_SCHEDULER);
+            else
+                status = RPC_STATUS_BAD_ARGS;
+            break;
+        case RPC_OP_PREEMPT:
+            if (argLength == 1)
+                preempt(args[0] ? PREEMPTIVE : COOPERATIVE);
+            else
+                status = RPC_STATUS_BAD_ARGS;
+            break;
+        case RPC_OP_MEMINFO:
+            status = rpcMeminfo(result, space, &resultLength);
+            break;
+        case RPC_OP_PIDOF:
+            status = rpcPidof(args, argLength, result, space, &resultLength);
+            break;
+        case RPC_OP_TEXT_MODE:
+            stay = false;
+            break;
+        default:
+            status = RPC_STATUS_UNKNOWN_OP;
+        }
+
+        if (status != RPC_STATUS_OK)
+            resultLength = 0;
+
+        response[writeIdx++] = op;
+        response[writeIdx++] = status;
+        response[writeIdx++] = resultLength & 0xFF;
+        response[writeIdx++] = resultLength >> 8;
+        writeIdx += resultLength;
+        done++;
+    }
+    response[3] = done;
+
+    sendFrame(response, writeIdx);
+
+    return stay;
+}
+
+/**
+ * @brief
+ * Binary request/response loop on UART0, entered from the shell with "rpc".
+ * Frames that fail COBS decoding or the CRC are dropped silently, the host
+ * matches responses to requests with the request id.
+ * Runs in the shell task, so every buffer lives on its stack
+ */
+void rpcServe(void)
+{
+    uint8_t request[RPC_MAX_FRAME + RPC_MAX_FRAME / 254 + 1];
+    uint8_t response[RPC_MAX_FRAME];
+    uint16_t length = 0;
+    bool overflow = false;
+    bool running = true;
+
+    while (running)
+    {
+        if (!kbhitUart0())
+        {
+            yield();
+            continue;
+        }
+
+        uint8_t c = getcUart0();
+        if (c != 0)
+        {
+            if (length < sizeof(request))
+                request[length++] = c;
+            else
+                overflow = true;
+            continue;
+        }
+
+        // End of frame
+        if (!overflow && length > 0)
+        {
+            uint16_t decoded = cobsDecode(request, length);
+            if (decoded >= 6 && request[0] == RPC_FRAME_REQUEST)
+            {
+                uint16_t crc = request[decoded - 2] | (request[decoded - 1] << 8);
+                if (crc == crc16(request, decoded - 2))
+                    running = rpcHandleRequest(request, decoded - 2, response);
+            }
+        }
+        length = 0;
+        overflow = false;
+    }
+}
@@ -0,0 +1,69 @@
+// Binary command interface
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target uC:       TM4C123GH6PM
+// System Clock:    40 MHz
+
+#ifndef RPC_H_
+#define RPC_H_
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+    Framing is the same as the telemetry stream (see telemetry.h):
+    COBS encoded, 0x00 terminated, CRC-16/CCITT of the decoded frame appended.
+
+    Request:  RPC_FRAME_REQUEST (1) | requestId (2) | opCount (1) |
+              opCount x { op (1) | argLength (1) | args (argLength) }
+
+    Response: RPC_FRAME_RESPONSE (1) | requestId (2) | opCount (1) |
+              opCount x { op (1) | status (1) | resultLength (2) | result (resultLength) }
+
+    Ops are executed in order, a batch answers with a single response frame.
+
+    Op arguments and results (little endian):
+    RPC_OP_PING       -                      -
+    RPC_OP_PS         -                      count (1) | count x { pid (4) | state (1) | mutex/semaphore (1) | name\0 }
+    RPC_OP_KILL       pid (4)                -   (NOT_FOUND if no such task is running)
+    RPC_OP_SCHED      prio on (1)            -
+    RPC_OP_PREEMPT    preemption on (1)      -
+    RPC_OP_MEMINFO    -                      count (1) | count x { base (4) | size (4) | dynamic (4) | name\0 }
+    RPC_OP_PIDOF      name (argLength)       pid (4)
+    RPC_OP_TEXT_MODE  -                      -   (back to the text shell after the response)
+*/
+#define RPC_FRAME_REQUEST 0x10
+#define RPC_FRAME_RESPONSE 0x11
+
+#define RPC_OP_PING 0x00
+#define RPC_OP_PS 0x01
+#define RPC_OP_KILL 0x02
+#define RPC_OP_SCHED 0x03
+#define RPC_OP_PREEMPT 0x04
+#define RPC_OP_MEMINFO 0x05
+#define RPC_OP_PIDOF 0x06
+#define RPC_OP_TEXT_MODE 0x7F
+
+#define RPC_STATUS_OK 0
+#define RPC_STATUS_UNKNOWN_OP 1
+#define RPC_STATUS_BAD_ARGS 2
+#define RPC_STATUS_NOT_FOUND 3
+#define RPC_STATUS_NO_SPACE 4
+
+#define RPC_MAX_FRAME 512
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+void rpcServe(void);
+bool rpcHandleRequest(uint8_t *request, uint16_t length, uint8_t *response);
+
+#endif
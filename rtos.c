@@ -24,6 +24,7 @@
 // Memory Protection Unit (MPU):
 //   Region to control access to flash, peripherals, and bitbanded areas
 //   4 or more regions to allow SRAM access (RW or none for task)
+//   1 region for the kernel statistics page (read only for task)
 
 //-----------------------------------------------------------------------------
 // Device includes, defines, and assembler directives
@@ -39,6 +40,12 @@
 #include "faults.h"
 #include "tasks.h"
 #include "shell.h"
+#include "bench.h"
+#include "stress.h"
+#ifdef QEMU_MPS2
+#include "CortexM4Registers.h"
+#include "report.h"
+#endif
 
 //-----------------------------------------------------------------------------
 // Main
@@ -46,15 +53,21 @@
 
 int main(void)
 {
+    char scenario[STRESS_CONFIG_SIZE];
     bool ok;
 
     // Initialize hardware
     initSystemClockTo40Mhz();
     initHw();
     initUart0();
-    allowFlashAccess();
-    allowPeripheralAccess();
+    allowFlashAndPeripheralAccess();
     setupSramAccess();
+    allowKernelStatsAccess();
+#ifdef QEMU_ENABLE_MPU
+    // Enforce the regions above under QEMU (qemu/Makefile MPU=on)
+    enableMPUHandler();
+    enableMPU();
+#endif
     initRtos();
 
     // Setup UART0 baud rate
@@ -69,6 +82,15 @@ int main(void)
     // Add required idle process at lowest priority
     ok =  createThread(idle, "Idle", 15, 512);
 
+    // A stress run (see stress.h) replaces the other processes
+    if (stressGetConfig(scenario, sizeof(scenario)))
+    {
+        ok &= initStress(scenario);
+        if (ok)
+            startRtos();
+        while(true);
+    }
+
     // Add other processes
     ok &= createThread(lengthyFn, "LengthyFn", 12, 1024);
     ok &= createThread(flash4Hz, "Flash4Hz", 8, 512);
@@ -80,6 +102,16 @@ int main(void)
     ok &= createThread(errant, "Errant", 12, 512);
     ok &= createThread(shell, "Shell", 12, 4096);
 
+#ifdef BENCH
+    // Peers of the bench command (bench.c), blocked until it runs
+    ok &= initBench();
+#endif
+#ifdef QEMU_MPS2
+    // Timed benchmark run, see qemu/report.c
+    if (getQemuRunTime() > 0)
+        ok &= createThread(qemuReport, "Report", 0, 1536);
+#endif
+
     // TODO: Add code to implement a periodic timer and ISR
 
     // Start up RTOS
@@ -21,6 +21,11 @@
 // REQUIRED: Add header files here for your strings functions, ...
 #include "shell_auxiliary.h"
 #include "shell_commands.h"
+#include "telemetry.h"
+#include "rpc.h"
+#include "kstats.h"
+#include "bench.h"
+#include "load.h"
 
 //-----------------------------------------------------------------------------
 // Subroutines
@@ -37,7 +42,7 @@ void shell(void)
     uint32_t processesCount = 0;
 
     // Initially get the list of processes when we start the shell
-    getListOfProcesses(processList, &processesCount);
+    processesCount = getListOfProcesses(processList);
 
     // Clear the screen and move the cursor to the top left
     putsUart0("\033[2J\033[H");
@@ -82,28 +87,40 @@ void shell(void)
             }
             else if (inProcessesList(processList, data.buffer, processesCount))
             {
-                putsUart0("Process already running\n\n");
+                // Typing the name of a stopped process restarts it
+                uint32_t pid = pidof(data.buffer);
+                KSTATS stats;
+                uint8_t i;
+
+                readKernelStats(&stats);
+                for (i = 0; i < stats.taskCount && stats.tasks[i].pid != pid; i++)
+                    ;
+
+                if (i < stats.taskCount && stats.tasks[i].state == STATE_STOPPED)
+                {
+                    restartThread((_fn)pid);
+                    putsUart0("Process restarted\n\n");
+                }
+                else
+                    putsUart0("Process already running\n\n");
 
                 // Update the list of processes
-                getListOfProcesses(processList, &processesCount);
+                processesCount = getListOfProcesses(processList);
 
                 foo = true;
             }
             else if (isCommand(&data, "ps", 0))
             {
-                uint32_t pidsArray[MAX_TASKS] = {0};
-                char namesOfTasks[MAX_TASKS][10] = {0};
-                uint32_t statesArray[MAX_TASKS] = {0};
-                uint8_t mutex_semaphore_array[MAX_TASKS] = {0};
-
-                ps(pidsArray, namesOfTasks, statesArray, mutex_semaphore_array);
+                // Read from the statistics page, no service call needed
+                KSTATS stats;
+                readKernelStats(&stats);
 
                 uint8_t i = 0;
                 putsUart0("\nPID\t\tName\t\tCPU%\tState\t\tMutex/Semaphore\n");
                 putsUart0("------------------------------------------------------------------------------\n\n");
-                for (i = 0; i < MAX_TASKS; i++)
+                for (i = 0; i < stats.taskCount; i++)
                 {
-                    if (pidsArray[i])
+                    if (stats.tasks[i].pid)
                     {
                         uint8_t j = 0;
 
@@ -111,35 +128,37 @@ void shell(void)
 
                         // Printing out the PID
                         putsUart0("0x");
-                        itoa(pidsArray[i], str, 16);
+                        itoa(stats.tasks[i].pid, str, 16);
                         putsUart0(str);
                         for (j = stringLength(str) + 2; j < 16; j++)
                             putcUart0(' ');
 
                         // Printing the thread name
-                        putsUart0(namesOfTasks[i]);
-                        for (j = stringLength(namesOfTasks[i]); j < 16; j++)
+                        putsUart0(stats.tasks[i].name);
+                        for (j = stringLength(stats.tasks[i].name); j < 16; j++)
                             putcUart0(' ');
 
-                        // Print the CPU percentage
-                        // Print zero for now
-                        putcUart0('0');
-                        for (j = 0; j < 8; j++)
+                        // Print the CPU percentage since the RTOS started
+                        itoa(stats.systemTicks ? (uint32_t)((uint64_t)stats.tasks[i].cpuTicks * 100 / stats.systemTicks) : 0, str, 10);
+                        putsUart0(str);
+                        for (j = stringLength(str); j < 9; j++)
                             putcUart0(' ');
 
                         // Printing out the state of the thread
-                        statesArray[i] == 0 ? strCopy(str, "INVALID") : statesArray[i] == 1 ? strCopy(str, "STOPPED")
-                                                                    : statesArray[i] == 2   ? strCopy(str, "READY")
-                                                                    : statesArray[i] == 3   ? strCopy(str, "DELAYED")
-                                                                    : statesArray[i] == 4   ? strCopy(str, "BLOCKED_MUTEX")
-                                                                    : statesArray[i] == 5   ? strCopy(str, "BLOCKED_SEMAPHORE")
-                                                                                            : strCopy(str, "UNKNOWN");
+                        uint32_t state = stats.tasks[i].state;
+                        state == STATE_INVALID             ? strCopy(str, "INVALID")
+                        : state == STATE_STOPPED           ? strCopy(str, "STOPPED")
+                        : state == STATE_READY             ? strCopy(str, "READY")
+                        : state == STATE_DELAYED           ? strCopy(str, "DELAYED")
+                        : state == STATE_BLOCKED_MUTEX     ? strCopy(str, "BLOCKED_MUTEX")
+                        : state == STATE_BLOCKED_SEMAPHORE ? strCopy(str, "BLOCKED_SEMAPHORE")
+                                                           : strCopy(str, "UNKNOWN");
                         putsUart0(str);
                         for (j = stringLength(str); j < 20; j++)
                             putcUart0(' ');
 
                         // Printing out the mutex or semaphore
-                        itoa(mutex_semaphore_array[i], str, 10);
+                        itoa(stats.tasks[i].blockedOn, str, 10);
                         putsUart0(str);
                         putcUart0('\n');
                     }
@@ -165,7 +184,7 @@ void shell(void)
                 }
             
                 // Update the list of processes
-                getListOfProcesses(processList, &processesCount);
+                processesCount = getListOfProcesses(processList);
                 foo = true;
             }
             else if (isCommand(&data, "pi", 1))
@@ -217,10 +236,9 @@ void shell(void)
             }
             else if (isCommand(&data, "pidof", 1))
             {
-                uint32_t pid = 0;
+                uint32_t pid = pidof(getFieldString(&data, 1));
                 char str[20] = {0};
 
-                pidof(getFieldString(&data, 1), &pid);
                 if (pid)
                 {
                     putsUart0("PID: 0x");
@@ -240,12 +258,12 @@ void shell(void)
                 char strBuffer[MAX_CHARS] = {0};
                 uint32_t baseAddress[MAX_TASKS] = {0};
                 uint32_t sizeOfTask[MAX_TASKS] = {0};
-                uint32_t dynamicMemOfEachTask[MAX_TASKS] = {1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1};
+                uint32_t dynamicMemOfEachTask[MAX_TASKS] = {0};
                 uint8_t taskCount = 0;
 
                 putsUart0("\nTask Name\tBase Address\tSize\t\tDynamic Memory\n");
                 putsUart0("------------------------------------------------------------\n\n");
-                meminfo(listOfTasks, baseAddress, sizeOfTask, &taskCount, dynamicMemOfEachTask);
+                taskCount = meminfo(listOfTasks, baseAddress, sizeOfTask, dynamicMemOfEachTask);
 
                 uint8_t i = 0;
 
@@ -281,6 +299,62 @@ void shell(void)
 
                 foo = true;
             }
+            else if (isCommand(&data, "memmap", 0))
+            {
+                memmap();
+                foo = true;
+            }
+            else if (isCommand(&data, "trace", 0))
+            {
+                // Kernel event trace for tools/ktrace_export.py
+                trace(&data);
+                foo = true;
+            }
+            else if (isCommand(&data, "heaptrace", 0))
+            {
+                // Allocation trace for host/heapbench -r
+                heaptrace();
+                foo = true;
+            }
+            else if (isCommand(&data, "policy", 1))
+            {
+                // Placement policy of the next allocations
+                char *name = getFieldString(&data, 1);
+                uint8_t policy = strCmp(name, "SEG")     ? ALLOC_SEGREGATED
+                                 : strCmp(name, "FIRST") ? ALLOC_FIRST_FIT
+                                 : strCmp(name, "BEST")  ? ALLOC_BEST_FIT
+                                                         : NUM_ALLOC_POLICIES;
+
+                putsUart0(allocPolicy(policy) ? "Policy set\n\n" : "Policies: SEG, FIRST, BEST\n\n");
+                foo = true;
+            }
+            else if (isCommand(&data, "telemetry", 0))
+            {
+                // Binary frames until any key is pressed
+                // tools/telemetry_decode.py decodes the stream on the host
+                streamTelemetry(getFieldInteger(&data, 1));
+                foo = true;
+            }
+            else if (isCommand(&data, "rpc", 0))
+            {
+                // Binary request/response mode for host automation (tools/rpc_client.py)
+                // until the host sends RPC_OP_TEXT_MODE
+                putsUart0("RPC mode\n");
+                rpcServe();
+                foo = true;
+            }
+            else if (isCommand(&data, "bench", 0))
+            {
+                // Kernel primitive timings, all of them or the one named
+                runBenchmarks(shell, getFieldString(&data, 1));
+                foo = true;
+            }
+            else if (isCommand(&data, "load", 0))
+            {
+                // Synthetic load tasks and their effect on the others, see load.h
+                loadCommand(&data);
+                foo = true;
+            }
             else if (isCommand(&data, "clear", 0))
             {
                 // Clear the screen and move the cursor to the top left
@@ -110,7 +110,7 @@ void parseFields(USER_DATA *dataStruct)
      */
     uint8_t count = 0;
 
-    // Can only parse 5 fields
+    // Can only parse MAX_FIELDS fields
     while ((dataStruct->buffer[count] != 0) && (dataStruct->fieldCount < MAX_FIELDS))
     {
         // 97 = 'a'
@@ -242,7 +242,7 @@ int32_t getFieldInteger(USER_DATA *dataStruct, uint8_t fieldNumber)
  * 
  * @param str
  */
-uint8_t stringLength(char *str)
+uint8_t stringLength(const char *str)
 {
     uint8_t i = 0;
     while (str[i] != 0)
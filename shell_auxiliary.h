@@ -10,7 +10,7 @@
 // Maximum number of chars that can be accepted from the user
 // and the structure for holding UI info
 #define MAX_CHARS 80
-#define MAX_FIELDS 5
+#define MAX_FIELDS 8
 
 #define ASCII_BACKSPACE 8
 #define ASCII_COMMA 44
@@ -47,7 +47,7 @@ void strCopy(char *dstStr, const char *srcStr);
 
 char *getFieldString(USER_DATA *dataStruct, uint8_t fieldNumber);
 int32_t getFieldInteger(USER_DATA *dataStruct, uint8_t fieldNumber);
-uint8_t stringLength(char *str);
+uint8_t stringLength(const char *str);
 // int32_t atoi(char *str);
 
 #endif
@@ -1,122 +1,370 @@
 #include "shell_commands.h"
 #include "shell_auxiliary.h"
+#include "telemetry.h"
+#include "kstats.h"
+#include "ktrace.h"
+#include "hal.h"
+
+#define HEAP_TRACE_BATCH 16 // Records read per getHeapTrace() call
+#define KTRACE_BATCH 16     // Records read per getKernelTrace() call
+
+/*
+    reboot, ps, preempt, sched, pidof, meminfo, getListOfProcesses,
+    getHeapMap, allocPolicy, getHeapTrace, traceControl and getKernelTrace
+    are service calls, their wrappers are generated in kernel.c from
+    SYSCALL_LIST in syscalls.h
+*/
 
 /**
  * @brief
- * Reboots the microcontroller. Will be implemenented
- * as part of the mini project.
+ * Prints a task name from the snapshot, or its index if it is not a task
  */
-void reboot(void)
+void putTaskName(TELEMETRY_SNAPSHOT *snapshot, uint8_t task)
 {
-    /*
-        Can only be accessed from priveleged mode.
-        Provides priority grouping control for the
-        - exception model
-        - endian status
-        - reset control of the system
-
-        To write to the register, 0x05FA must be written to the VECTKEY field i.e bits 31:16
-        otherwise the write is ignored.
-    */
-    __asm(" SVC #12");
+    char str[10];
+
+    if (task < snapshot->taskCount)
+        putsUart0(snapshot->tasks[task].name);
+    else
+    {
+        itoa(task, str, 10);
+        putsUart0(str);
+    }
 }
 
 /**
  * @brief
- * Displays the process status.
- * For now, it displays the text "ps called"
+ * Displays the inter-process (thread) communication status
  */
-void ps(uint32_t *pidsArray, char namesOfTasks[][10], uint32_t *statesArray, uint8_t *mutex_semaphore_array)
+void ipcs()
 {
-    __asm(" SVC #13");
+    TELEMETRY_SNAPSHOT snapshot;
+    char str[10];
+    uint8_t i, j;
+
+    getTelemetrySnapshot(&snapshot);
+
+    putsUart0("\nMutex\tLocked\tLocked by\tQueue\n");
+    putsUart0("------------------------------------------------\n");
+    for (i = 0; i < MAX_MUTEXES; i++)
+    {
+        itoa(i, str, 10);
+        putsUart0(str);
+        putcUart0('\t');
+        putsUart0(snapshot.mutexes[i].lock ? "yes\t" : "no\t");
+        if (snapshot.mutexes[i].lock)
+            putTaskName(&snapshot, snapshot.mutexes[i].lockedBy);
+        putcUart0('\t');
+        putcUart0('\t');
+        for (j = 0; j < snapshot.mutexes[i].queueSize; j++)
+        {
+            putTaskName(&snapshot, snapshot.mutexes[i].processQueue[j]);
+            putcUart0(' ');
+        }
+        putcUart0('\n');
+    }
+
+    putsUart0("\nSemaphore\tCount\tQueue\n");
+    putsUart0("------------------------------------------------\n");
+    for (i = 0; i < MAX_SEMAPHORES; i++)
+    {
+        itoa(i, str, 10);
+        putsUart0(str);
+        putsUart0("\t\t");
+        itoa(snapshot.semaphores[i].count, str, 10);
+        putsUart0(str);
+        putcUart0('\t');
+        for (j = 0; j < snapshot.semaphores[i].queueSize; j++)
+        {
+            putTaskName(&snapshot, snapshot.semaphores[i].processQueue[j]);
+            putcUart0(' ');
+        }
+        putcUart0('\n');
+    }
+    putcUart0('\n');
 }
 
 /**
  * @brief
- * Displays the inter-process (thread) communication status
+ * Character drawn by memmap for a subregion owner:
+ * 0-9 then A, B... for tasks, S for stack chunks, . for free
  */
-void ipcs()
+static char ownerChar(uint8_t owner)
 {
-    __asm(" SVC #14");
+    if (owner == NO_OWNER)
+        return '.';
+    if (owner == STACK_CHUNK_OWNER)
+        return 'S';
+    return owner < 10 ? '0' + owner : 'A' + owner - 10;
 }
 
 /**
  * @brief
- * Kills the process (thread) with the matching PID.
- * @param pid
+ * Prints n followed by spaces up to width characters
  */
-void kill(int32_t pid)
+void putPadded(uint32_t n, uint8_t width)
 {
-    // Will use the stopThread function in kernel.c
-    // SVC #3
-    stopThread((void *)pid);
-}
+    char str[12];
+    uint8_t j;
 
-void pkill(const char name[])
-{
-    // Will use the stopThread function in kernel.c
-    // SVC #3
-    stopThread((void *)name);
+    itoa(n, str, 10);
+    putsUart0(str);
+    for (j = stringLength(str); j < width; j++)
+        putcUart0(' ');
 }
 
 /**
  * @brief
- * Turns priority inheritance on or off.
- * @param state
+ * Draws the subregion bitmap, one line per region, with the task owning
+ * each subregion and '|' at the edges of the allocations, followed by
+ * the fragmentation metrics
  */
-void pi(bool state)
+void memmap()
 {
+    static const char *const policyNames[NUM_ALLOC_POLICIES] = {"SEG", "FIRST", "BEST"};
+    static const char *const bucketNames[FREE_RUN_BUCKETS] = {"512", "1K", "2K", "4K", "8K", "16K+"};
+    HEAP_MAP map;
+    KSTATS stats;
+    char str[12];
+    uint8_t regionIdx, i;
+
+    getHeapMap(&map);
+    readKernelStats(&stats);
+
+    putsUart0("\nRegion\tBase\t\tSub\tSubregions\t\tUsed\n");
+    putsUart0("------------------------------------------------------------\n");
+    for (regionIdx = 0; regionIdx < NUM_SRAM_REGIONS; regionIdx++)
+    {
+        bool previousFree = true;
+
+        putcUart0('R');
+        itoa(regionIdx, str, 10);
+        putsUart0(str);
+        putsUart0("\t0x");
+        itoa(regions[regionIdx].baseAddress, str, 16);
+        putsUart0(str);
+        putcUart0('\t');
+        itoa(regions[regionIdx].subRegionSize, str, 10);
+        putsUart0(str);
+        putcUart0('\t');
+
+        for (i = 0; i < SUBREGIONS_PER_REGION; i++)
+        {
+            uint8_t bit = regionIdx * SUBREGIONS_PER_REGION + i;
+            bool isFree = (map.freeSubregions >> bit) & 1;
+            bool edge = ((map.allocationStarts >> bit) & 1) || (isFree && !previousFree);
+
+            putcUart0(edge ? '|' : ' ');
+            putcUart0(ownerChar(map.owner[bit]));
+            previousFree = isFree;
+        }
+        putcUart0(previousFree ? ' ' : '|');
+        putcUart0('\t');
+
+        itoa(map.regionUsed[regionIdx] * 100 / regions[regionIdx].regionSize, str, 10);
+        putsUart0(str);
+        putsUart0("%\n");
+    }
+
+    putsUart0("\nPolicy: ");
+    putsUart0(map.policy < NUM_ALLOC_POLICIES ? policyNames[map.policy] : "?");
+    putsUart0("\nFree: ");
+    putPadded(map.freeBytes, 0);
+    putsUart0(" B, largest run: ");
+    putPadded(map.largestFreeRun, 0);
+    putsUart0(" B, fragmentation: ");
+    putPadded(map.freeBytes ? 100 - map.largestFreeRun * 100 / map.freeBytes : 0, 0);
+    putsUart0("%, failed allocations: ");
+    putPadded(map.failedAllocations, 0);
+
+    putsUart0("\nFree runs: ");
+    for (i = 0; i < FREE_RUN_BUCKETS; i++)
+    {
+        putsUart0(bucketNames[i]);
+        putcUart0(':');
+        putPadded(map.freeRuns[i], 4);
+    }
+
+    putsUart0("\nOwners: S stacks");
+    for (i = 0; i < stats.taskCount; i++)
+    {
+        putsUart0(", ");
+        putcUart0(ownerChar(i));
+        putcUart0(' ');
+        putsUart0(stats.tasks[i].name);
+    }
+    putsUart0("\n\n");
 }
 
 /**
  * @brief
- * Turns preemption on or off.
- * @param state
+ * Prints and drains the allocation trace (see HEAP_TRACE in mm.h), one
+ * operation per line: op owner size address result, op is m(alloc),
+ * f(ree), r(ealloc) or v (compaction move). Saved to a file it is the
+ * input of host/heapbench -r
  */
-void preempt(bool state)
+void heaptrace()
 {
-    __asm(" SVC #18");
+#ifdef HEAP_TRACE
+    static const char opNames[] = "?mfrv";
+    HEAP_TRACE_RECORD records[HEAP_TRACE_BATCH];
+    uint32_t count, dropped, i;
+    char str[12];
+
+    putsUart0("# heaptrace\n");
+    do
+    {
+        // Operations lost to the ring before they were read
+        count = getHeapTrace(records, HEAP_TRACE_BATCH, &dropped);
+        if (dropped > 0)
+        {
+            putsUart0("# dropped ");
+            putPadded(dropped, 0);
+            putcUart0('\n');
+        }
+        for (i = 0; i < count; i++)
+        {
+            putcUart0(records[i].op <= HEAP_TRACE_MOVE ? opNames[records[i].op] : '?');
+            putcUart0(' ');
+            putPadded(records[i].owner, 0);
+            putcUart0(' ');
+            putPadded(records[i].size, 0);
+            putsUart0(" 0x");
+            itoa(records[i].address, str, 16);
+            putsUart0(str);
+            putsUart0(" 0x");
+            itoa(records[i].result, str, 16);
+            putsUart0(str);
+            putcUart0('\n');
+        }
+    } while (count > 0);
+    putcUart0('\n');
+#else
+    putsUart0("No allocation trace, build with HEAP_TRACE defined\n\n");
+#endif
 }
 
 /**
  * @brief
- * Selects scheduling algorithm.
- * Either priority or round robin.
- *
- * @param prio_on
+ * trace start [switch|block|wake|svc|tick|fault ...], trace stop and
+ * trace dump (see ktrace.h). start records the events named, by default
+ * all but the ticks. dump prints and drains the ring after the clock and
+ * the task names, one event per line: op time task arg detail, op is
+ * s(witch), b(lock), w(ake), c(all), t(ick) or f(ault) and time is in
+ * cycles. Saved to a file it is the input of tools/ktrace_export.py
  */
-void sched(bool prio_on)
+void trace(USER_DATA *data)
 {
-    __asm(" SVC #19");
+#ifdef KERNEL_TRACE
+    static const char *const eventNames[] = {"", "switch", "block", "wake", "svc", "tick", "fault"};
+    static const char opNames[] = "?sbwctf";
+    char *action = getFieldString(data, 1);
+    KTRACE_RECORD records[KTRACE_BATCH];
+    KSTATS stats;
+    uint32_t count, dropped, i;
+    uint8_t mask = 0, event, field;
+
+    if (action != NULL && strCmp(action, "start"))
+    {
+        for (field = 2; field < data->fieldCount; field++)
+        {
+            for (event = KTRACE_SWITCH; event <= KTRACE_FAULT; event++)
+            {
+                if (strCmp(getFieldString(data, field), eventNames[event]))
+                    break;
+            }
+            if (event > KTRACE_FAULT)
+            {
+                putsUart0("Events: switch block wake svc tick fault\n\n");
+                return;
+            }
+            mask |= KTRACE_MASK(event);
+        }
+        traceControl(mask != 0 ? mask : KTRACE_DEFAULT_MASK);
+        putsUart0("Tracing\n\n");
+    }
+    else if (action != NULL && strCmp(action, "stop"))
+    {
+        traceControl(0);
+        putsUart0("Trace stopped\n\n");
+    }
+    else if (action == NULL || strCmp(action, "dump"))
+    {
+        readKernelStats(&stats);
+        putsUart0("# ktrace\n# clock ");
+        putPadded(SYSTEM_CLOCK_HZ, 0);
+        putcUart0('\n');
+        for (i = 0; i < stats.taskCount; i++)
+        {
+            putsUart0("# task ");
+            putPadded(i, 0);
+            putcUart0(' ');
+            putsUart0(stats.tasks[i].name);
+            putcUart0('\n');
+        }
+        do
+        {
+            // Events lost to the ring before they were read
+            count = getKernelTrace(records, KTRACE_BATCH, &dropped);
+            if (dropped > 0)
+            {
+                putsUart0("# dropped ");
+                putPadded(dropped, 0);
+                putcUart0('\n');
+            }
+            for (i = 0; i < count; i++)
+            {
+                putcUart0(records[i].event <= KTRACE_FAULT ? opNames[records[i].event] : '?');
+                putcUart0(' ');
+                putPadded(records[i].time, 0);
+                putcUart0(' ');
+                putPadded(records[i].task, 0);
+                putcUart0(' ');
+                putPadded(records[i].arg, 0);
+                putcUart0(' ');
+                putPadded(records[i].detail, 0);
+                putcUart0('\n');
+            }
+        } while (count > 0);
+        putcUart0('\n');
+    }
+    else
+        putsUart0("trace [start [events]|stop|dump]\n\n");
+#else
+    putsUart0("No kernel trace, build with KERNEL_TRACE defined\n\n");
+#endif
 }
 
 /**
  * @brief
- * Display the PID of the process (thread).
- * @param name
+ * Kills the process (thread) with the matching PID.
+ * @param pid
  */
-void pidof(const char name[], uint32_t *pid)
+bool kill(int32_t pid)
 {
-    __asm(" SVC #20");
+    // Will use the stopThread function in kernel.c
+    // SVC #3
+    // False if there is no such task, or it is stopped or the idle task
+    return stopThread((void *)pid);
 }
 
-/**
- * @brief
- * Display the memory usage by all threas, including the base address and size of
- * each allocation. Optionally display dynamic memory
- */
-void meminfo(char namesOfTasks[][10], uint32_t *baseAddress, uint32_t *sizeOfTask, uint8_t *taskCount, uint32_t *dynamicMemOfEachTask)
+void pkill(const char name[])
 {
-    __asm(" SVC #21");
+    // Will use the stopThread function in kernel.c
+    // SVC #3
+    uint32_t pid = pidof(name);
+
+    if (pid)
+        stopThread((_fn)pid);
 }
 
 /**
  * @brief
- * Gets the list of processes
+ * Turns priority inheritance on or off.
+ * @param state
  */
-void getListOfProcesses(char processList[][10], uint32_t *currentProcessCount)
+void pi(bool state)
 {
-    __asm(" SVC #22");
 }
 
 /**
@@ -5,6 +5,8 @@
 #include "tm4c123gh6pm.h"
 
 #include "kernel.h"
+#include "mm.h"
+#include "shell_auxiliary.h"
 //-----------------------------------------------------------------------------
 // RTOS service calls for shell commands
 //-----------------------------------------------------------------------------
@@ -12,14 +14,21 @@
 void reboot(void);
 void ps(uint32_t *pidsArray, char namesOfTasks[][10], uint32_t *statesArray, uint8_t *mutex_semaphore_array);
 void ipcs();
-void kill(int32_t pid);
+bool kill(int32_t pid);
 void pkill(const char name[]);
 void pi(bool state);
 void preempt(bool state);
 void sched(bool prio_on);
-void pidof(const char name[], uint32_t *pid);
-void meminfo(char namesOfTasks[][10], uint32_t *baseAddress, uint32_t *sizeOfTask, uint8_t *taskCount, uint32_t *dynamicMemOfEachTask);
-void getListOfProcesses(char processList[][10], uint32_t *currentProcessCount);
+uint32_t pidof(const char name[]);
+uint8_t meminfo(char namesOfTasks[][10], uint32_t *baseAddress, uint32_t *sizeOfTask, uint32_t *dynamicMemOfEachTask);
+uint32_t getListOfProcesses(char processList[][10]);
+void getHeapMap(HEAP_MAP *map);
+bool allocPolicy(uint8_t policy);
+void memmap(void);
+uint32_t getHeapTrace(HEAP_TRACE_RECORD *records, uint32_t count, uint32_t *dropped);
+void heaptrace(void);
+void trace(USER_DATA *data);
+void putPadded(uint32_t n, uint8_t width);
 
 bool inProcessesList(char list[][10], char processName[], uint8_t processesCount);
 
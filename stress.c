@@ -0,0 +1,649 @@
+// Stress test functions
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target uC:       TM4C123GH6PM
+// System Clock:    40 MHz
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#include <stdint.h>
+#include "hal.h"
+#include "stress.h"
+#include "uart0.h"
+#include "shell_auxiliary.h"
+#include "shell_commands.h"
+#include "kstats.h"
+#include "telemetry.h"
+
+#ifdef STRESS
+#define STRESS_CYCLES_PER_MS (SYSTEM_CLOCK_HZ / 1000)
+#define STRESS_CYCLES_PER_US (SYSTEM_CLOCK_HZ / 1000000)
+#define STRESS_STACK_SIZE 1536
+#define STRESS_MONITOR_STACK_SIZE 2048
+#define STRESS_MONITOR_PRIORITY 0
+#define STRESS_TIMEOUT 1000 // ms past the last report before unfinished tasks fail the run
+#define STRESS_MAX_PRIORITY 15
+#define STRESS_MAX_CHURN_SIZE 4096
+
+// Workload words of a scenario and their defaults
+typedef struct _STRESS_WORKLOAD
+{
+    const char *word;
+    uint8_t kind;
+    uint8_t priority;
+    uint32_t period;
+    uint32_t param;
+} STRESS_WORKLOAD;
+
+static const STRESS_WORKLOAD stressWorkloads[] = {
+    {"hog", STRESS_HOG, 12, 0, 0},
+    {"lock", STRESS_LOCK, 12, 50, 5},
+    {"chain", STRESS_PRODUCER, 12, 20, 2},
+    {"churn", STRESS_CHURN, 12, 10, 512},
+};
+
+#define NUM_STRESS_WORKLOADS (sizeof(stressWorkloads) / sizeof(stressWorkloads[0]))
+
+// Task names, the slot number is appended
+static const char *const stressTaskNames[] = {"Hog", "Lock", "Prod", "Cons", "Churn"};
+
+// One task function per slot, each runs row slot of the scenario
+void stressWorker0(void);
+void stressWorker1(void);
+void stressWorker2(void);
+void stressWorker3(void);
+void stressWorker4(void);
+void stressWorker5(void);
+void stressWorker6(void);
+void stressWorker7(void);
+
+static const _fn stressWorkers[STRESS_MAX_WORKERS] = {
+    stressWorker0, stressWorker1, stressWorker2, stressWorker3,
+    stressWorker4, stressWorker5, stressWorker6, stressWorker7,
+};
+
+//-----------------------------------------------------------------------------
+// Scenario
+//-----------------------------------------------------------------------------
+
+/**
+ * @brief
+ * True if the word starts with name followed by the end of the word,
+ * a ':' or a '='
+ */
+static bool wordIs(const char *word, const char name[])
+{
+    while (*name != '\0')
+    {
+        if (*word++ != *name++)
+            return false;
+    }
+    return *word == '\0' || *word == ' ' || *word == ':' || *word == '=';
+}
+
+/**
+ * @brief
+ * Reads the decimal number after the separator at *p and moves *p past it.
+ * An empty field (e.g. "lock::20") leaves value at its default
+ *
+ * @return False if the field is not a number
+ */
+static bool parseField(const char **p, uint32_t *value)
+{
+    const char *c = *p + 1;
+    uint32_t n = 0;
+
+    if (*c == ':' || *c == ' ' || *c == '\0')
+    {
+        *p = c;
+        return true;
+    }
+    while (*c >= ASCII_0 && *c <= ASCII_9)
+        n = n * 10 + *c++ - ASCII_0;
+    if (c == *p + 1 || (*c != ':' && *c != ' ' && *c != '\0'))
+        return false;
+    *value = n;
+    *p = c;
+    return true;
+}
+
+/**
+ * @brief
+ * Parses a limit word: time=, latency=, misses= or heapfail=
+ */
+static bool parseLimit(const char *word, STRESS_SCENARIO *scenario)
+{
+    const char *p = word;
+    uint32_t *value;
+
+    if (wordIs(word, "time"))
+        value = &scenario->time;
+    else if (wordIs(word, "latency"))
+        value = &scenario->latency;
+    else if (wordIs(word, "misses"))
+        value = &scenario->misses;
+    else if (wordIs(word, "heapfail"))
+        value = &scenario->heapFailures;
+    else
+        return false;
+
+    while (*p != '=')
+        p++;
+    return parseField(&p, value) && *p != ':';
+}
+
+/**
+ * @brief
+ * Parses a workload word into the next task rows, a chain takes two
+ */
+static bool parseWorkload(const char *word, STRESS_SCENARIO *scenario, uint8_t *locks, uint8_t *chains)
+{
+    const STRESS_WORKLOAD *workload = NULL;
+    STRESS_TASK *task;
+    const char *p = word;
+    uint32_t priority;
+    uint8_t i;
+
+    for (i = 0; i < NUM_STRESS_WORKLOADS; i++)
+    {
+        if (wordIs(word, stressWorkloads[i].word))
+            workload = &stressWorkloads[i];
+    }
+    if (workload == NULL || scenario->count + (workload->kind == STRESS_PRODUCER ? 2 : 1) > STRESS_MAX_WORKERS)
+        return false;
+
+    task = &scenario->tasks[scenario->count];
+    task->kind = workload->kind;
+    task->chain = 0;
+    task->period = workload->period;
+    task->param = workload->param;
+    priority = workload->priority;
+
+    // Fields in the order prio:period:param, a hog has only a priority
+    while (*p != '\0' && *p != ' ' && *p != ':' && *p != '=')
+        p++;
+    if (*p == ':' && !parseField(&p, &priority))
+        return false;
+    if (*p == ':' && (task->kind == STRESS_HOG || !parseField(&p, &task->period)))
+        return false;
+    if (*p == ':' && !parseField(&p, &task->param))
+        return false;
+    if (*p == ':' || *p == '=' || priority > STRESS_MAX_PRIORITY)
+        return false;
+    task->priority = priority;
+
+    switch (task->kind)
+    {
+    case STRESS_LOCK:
+        if (++*locks > STRESS_MAX_LOCKS || task->period == 0)
+            return false;
+        break;
+    case STRESS_PRODUCER:
+        if (*chains >= STRESS_MAX_CHAINS || task->period == 0)
+            return false;
+        task->chain = (*chains)++;
+        scenario->tasks[scenario->count + 1] = *task;
+        scenario->tasks[scenario->count + 1].kind = STRESS_CONSUMER;
+        scenario->count++;
+        break;
+    case STRESS_CHURN:
+        if (task->period == 0 || task->param < STRESS_CHURN_MIN_SIZE || task->param > STRESS_MAX_CHURN_SIZE)
+            return false;
+        break;
+    }
+    scenario->count++;
+    return true;
+}
+
+/**
+ * @brief
+ * Parses a scenario (see stress.h)
+ *
+ * @return NULL on success, else the word that is not valid
+ */
+static const char *parseScenario(const char config[], STRESS_SCENARIO *scenario)
+{
+    const char *word = config;
+    uint8_t locks = 0;
+    uint8_t chains = 0;
+
+    scenario->count = 0;
+    scenario->time = 5000;
+    scenario->latency = 10000;
+    scenario->misses = 0;
+    scenario->heapFailures = 0;
+
+    while (*word != '\0')
+    {
+        if (*word == ' ')
+        {
+            word++;
+            continue;
+        }
+        if (!parseWorkload(word, scenario, &locks, &chains) && !parseLimit(word, scenario))
+            return word;
+        while (*word != '\0' && *word != ' ')
+            word++;
+    }
+    if (scenario->count == 0 || scenario->time == 0 || scenario->time > STRESS_MAX_TIME)
+        return config;
+    return NULL;
+}
+
+//-----------------------------------------------------------------------------
+// Workload tasks
+//-----------------------------------------------------------------------------
+
+/**
+ * @brief
+ * True if cycle count a comes before b, across a wrap of the counter
+ */
+static bool before(uint32_t a, uint32_t b)
+{
+    return (int32_t)(a - b) < 0;
+}
+
+/**
+ * @brief
+ * Cycle count of tick 0, the common origin of the run for every task
+ */
+static uint32_t runOrigin(void)
+{
+    KSTATS stats;
+
+    readKernelStats(&stats);
+    return getCycleCount() - stats.systemTicks * STRESS_CYCLES_PER_MS;
+}
+
+/**
+ * @brief
+ * Sleeps until the cycle count reaches time, returns at once if it has
+ */
+static void sleepUntil(uint32_t time)
+{
+    uint32_t now = getCycleCount();
+
+    if (before(now, time))
+        sleep((time - now + STRESS_CYCLES_PER_MS - 1) / STRESS_CYCLES_PER_MS);
+}
+
+/**
+ * @brief
+ * Keeps the processor for ms milliseconds of wall time
+ */
+static void busy(uint32_t ms)
+{
+    uint32_t end = getCycleCount() + ms * STRESS_CYCLES_PER_MS;
+
+    while (before(getCycleCount(), end));
+}
+
+/**
+ * @brief
+ * Builds the task name of a slot, e.g. "Lock1"
+ */
+static void taskName(char name[], const STRESS_TASK *task, uint8_t slot)
+{
+    uint8_t length;
+
+    strCopy(name, stressTaskNames[task->kind]);
+    length = stringLength(name);
+    name[length] = ASCII_0 + slot;
+    name[length + 1] = '\0';
+}
+
+/**
+ * @brief
+ * Prints the result line of a workload task
+ */
+static void putResult(const STRESS_TASK *task, uint8_t slot, uint32_t jobs, uint32_t misses, uint32_t response, bool ok)
+{
+    char name[10];
+    uint8_t i;
+
+    taskName(name, task, slot);
+    putsUart0(name);
+    for (i = stringLength(name); i < 8; i++)
+        putcUart0(' ');
+    putsUart0(task->kind == STRESS_HOG ? "loops " : "jobs ");
+    putPadded(jobs, 9);
+    if (task->period != 0 && task->kind != STRESS_CONSUMER)
+    {
+        putsUart0("misses ");
+        putPadded(misses, 6);
+        putsUart0("response max ");
+        putPadded(response / STRESS_CYCLES_PER_US, 0);
+        putsUart0(" us");
+    }
+    putsUart0(ok ? "\n" : "  FAIL\n");
+}
+
+/**
+ * @brief
+ * Body of every workload task: finds its row of the scenario, runs it until
+ * the time is up, reports and stops itself
+ */
+static void stressRun(uint8_t slot)
+{
+    char config[STRESS_CONFIG_SIZE];
+    STRESS_SCENARIO scenario;
+    STRESS_TASK *task;
+    void *blocks[STRESS_CHURN_BLOCKS] = {NULL};
+    uint32_t period, start, end, release, finish, response;
+    uint32_t jobs = 0, misses = 0, responseMax = 0;
+    uint32_t random = slot + 1;
+    uint8_t request, acknowledge, oldest = 0, i;
+    bool ok;
+
+    stressGetConfig(config, sizeof(config));
+    parseScenario(config, &scenario);
+    task = &scenario.tasks[slot];
+    request = stressChain + 2 * task->chain;
+    acknowledge = request + 1;
+    period = task->period * STRESS_CYCLES_PER_MS;
+    start = runOrigin();
+    end = start + scenario.time * STRESS_CYCLES_PER_MS;
+
+    switch (task->kind)
+    {
+    case STRESS_HOG:
+        // Never gives up the processor, like Uncoop
+        while (before(getCycleCount(), end))
+            jobs++;
+        break;
+
+    case STRESS_CONSUMER:
+        // Every request is acknowledged, the first one after the time is
+        // up (at the latest the producer's last) ends the loop
+        while (true)
+        {
+            wait(request);
+            if (!before(getCycleCount(), end))
+            {
+                post(acknowledge);
+                break;
+            }
+            busy(task->param);
+            post(acknowledge);
+            jobs++;
+        }
+        break;
+
+    default:
+        // Periodic jobs on an absolute release schedule, the deadline is the next release
+        release = getCycleCount();
+        while (before(release, end))
+        {
+            sleepUntil(release);
+            switch (task->kind)
+            {
+            case STRESS_LOCK:
+                lock(stressMutex);
+                busy(task->param);
+                unlock(stressMutex);
+                break;
+            case STRESS_PRODUCER:
+                post(request);
+                wait(acknowledge);
+                break;
+            case STRESS_CHURN:
+                random = random * 1664525 + 1013904223;
+                if (blocks[oldest] != NULL)
+                    free_to_heap_wrapper(blocks[oldest]);
+                blocks[oldest] = malloc_from_heap_wrapper(STRESS_CHURN_MIN_SIZE + (random >> 8) % (task->param - STRESS_CHURN_MIN_SIZE + 1));
+                oldest = (oldest + 1) % STRESS_CHURN_BLOCKS;
+                break;
+            }
+            finish = getCycleCount();
+            response = finish - release;
+            jobs++;
+            if (response > responseMax)
+                responseMax = response;
+            if (response > period)
+                misses++;
+
+            // Releases that went by during the job are skipped and missed
+            release += period;
+            while (before(release, finish))
+            {
+                release += period;
+                misses++;
+            }
+        }
+        for (i = 0; i < STRESS_CHURN_BLOCKS; i++)
+        {
+            if (blocks[i] != NULL)
+                free_to_heap_wrapper(blocks[i]);
+        }
+        if (task->kind == STRESS_PRODUCER)
+        {
+            sleepUntil(end);
+            post(request);
+        }
+        break;
+    }
+
+    // Report lines one after the other, in slot order
+    ok = misses <= scenario.misses;
+    sleepUntil(end + (slot + 1) * STRESS_REPORT_GAP * STRESS_CYCLES_PER_MS);
+    putResult(task, slot, jobs, misses, responseMax, ok);
+    if (!ok)
+        post(stressFail);
+    stopThread(stressWorkers[slot]);
+}
+
+void stressWorker0(void) { stressRun(0); }
+void stressWorker1(void) { stressRun(1); }
+void stressWorker2(void) { stressRun(2); }
+void stressWorker3(void) { stressRun(3); }
+void stressWorker4(void) { stressRun(4); }
+void stressWorker5(void) { stressRun(5); }
+void stressWorker6(void) { stressRun(6); }
+void stressWorker7(void) { stressRun(7); }
+
+//-----------------------------------------------------------------------------
+// Monitor
+//-----------------------------------------------------------------------------
+
+/**
+ * @brief
+ * True once every workload task has stopped, sets *ticks to the tick count
+ */
+static bool workersStopped(const STRESS_SCENARIO *scenario, uint32_t *ticks)
+{
+    KSTATS stats;
+    uint8_t slot, i;
+    bool stopped = true;
+
+    readKernelStats(&stats);
+    *ticks = stats.systemTicks;
+    for (slot = 0; slot < scenario->count; slot++)
+    {
+        for (i = 0; i < stats.taskCount; i++)
+        {
+            if (stats.tasks[i].pid == (uint32_t)stressWorkers[slot] && stats.tasks[i].state != STATE_STOPPED)
+                stopped = false;
+        }
+    }
+    return stopped;
+}
+
+/**
+ * @brief
+ * Prints the wake-up latency and CPU time of every workload task
+ *
+ * @return False if a task is still running or went past the latency limit
+ */
+static bool putLatencies(const STRESS_SCENARIO *scenario)
+{
+    KSTATS stats;
+    KSTATS_TASK *task;
+    uint8_t slot, i, j;
+    bool ok = true;
+
+    readKernelStats(&stats);
+    putsUart0("\nTask    Wakeups  Avg us  Max us  CPU%\n");
+    putsUart0("----------------------------------------\n");
+    for (slot = 0; slot < scenario->count; slot++)
+    {
+        for (i = 0; i < stats.taskCount; i++)
+        {
+            task = &stats.tasks[i];
+            if (task->pid != (uint32_t)stressWorkers[slot])
+                continue;
+            putsUart0(task->name);
+            for (j = stringLength(task->name); j < 8; j++)
+                putcUart0(' ');
+            putPadded(task->wakeups, 9);
+            putPadded(task->wakeLatencyAvg / STRESS_CYCLES_PER_US, 8);
+            putPadded(task->wakeLatencyMax / STRESS_CYCLES_PER_US, 8);
+            putPadded(stats.systemTicks ? task->cpuTicks * 100 / stats.systemTicks : 0, 0);
+            if (task->wakeLatencyMax / STRESS_CYCLES_PER_US > scenario->latency)
+            {
+                putsUart0("  FAIL latency");
+                ok = false;
+            }
+            if (task->state != STATE_STOPPED)
+            {
+                putsUart0("  FAIL unfinished");
+                ok = false;
+            }
+            putcUart0('\n');
+            break;
+        }
+    }
+    return ok;
+}
+
+/**
+ * @brief
+ * Checks the heap failures and the failures the workload tasks posted
+ */
+static bool checkFailures(const STRESS_SCENARIO *scenario)
+{
+    TELEMETRY_SNAPSHOT snapshot;
+    HEAP_MAP map;
+    bool ok = true;
+
+    getHeapMap(&map);
+    putsUart0("heap failures ");
+    putPadded(map.failedAllocations, 0);
+    if (map.failedAllocations > scenario->heapFailures)
+    {
+        putsUart0("  FAIL");
+        ok = false;
+    }
+    putcUart0('\n');
+
+    getTelemetrySnapshot(&snapshot);
+    if (snapshot.semaphores[stressFail].count > 0)
+    {
+        putPadded(snapshot.semaphores[stressFail].count, 0);
+        putsUart0(" task(s) missed more than ");
+        putPadded(scenario->misses, 0);
+        putsUart0(" deadlines  FAIL\n");
+        ok = false;
+    }
+    return ok;
+}
+
+/**
+ * @brief
+ * StressMon: waits for the workload tasks to report, then prints the
+ * latencies and the verdict and ends the run
+ */
+void stressMonitor(void)
+{
+    char config[STRESS_CONFIG_SIZE];
+    STRESS_SCENARIO scenario;
+    uint32_t timeout, ticks = 0;
+    bool ok;
+
+    stressGetConfig(config, sizeof(config));
+    parseScenario(config, &scenario);
+    timeout = scenario.time + (scenario.count + 1) * STRESS_REPORT_GAP + STRESS_TIMEOUT;
+
+    do
+        sleep(STRESS_POLL_PERIOD);
+    while (!workersStopped(&scenario, &ticks) && ticks < timeout);
+
+    ok = putLatencies(&scenario);
+    ok &= checkFailures(&scenario);
+    putsUart0(ok ? "stress: PASS\n" : "stress: FAIL\n");
+    stressExit(ok);
+}
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+/**
+ * @brief
+ * Creates the tasks of a scenario in place of the application, called from
+ * main() before startRtos(). Ends the run through stressExit() if the
+ * scenario is not valid
+ */
+bool initStress(const char config[])
+{
+    STRESS_SCENARIO scenario;
+    const char *bad;
+    char name[10];
+    uint8_t slot;
+    bool ok = true;
+
+    bad = parseScenario(config, &scenario);
+    if (bad != NULL)
+    {
+        putsUart0("stress: not a valid scenario at \"");
+        while (*bad != '\0' && *bad != ' ')
+            putcUart0(*bad++);
+        putsUart0("\", see stress.h\n");
+        stressExit(false);
+        return false;
+    }
+
+    initMutex(stressMutex);
+    for (slot = stressChain; slot < stressChain + 2 * STRESS_MAX_CHAINS; slot++)
+        initSemaphore(slot, 0);
+    initSemaphore(stressFail, 0);
+
+    for (slot = 0; slot < scenario.count; slot++)
+    {
+        taskName(name, &scenario.tasks[slot], slot);
+        ok &= createThread(stressWorkers[slot], name, scenario.tasks[slot].priority, STRESS_STACK_SIZE);
+    }
+    ok &= createThread(stressMonitor, "StressMon", STRESS_MONITOR_PRIORITY, STRESS_MONITOR_STACK_SIZE);
+    if (!ok)
+    {
+        putsUart0("stress: could not create the tasks\n");
+        stressExit(false);
+    }
+    return ok;
+}
+#else
+bool initStress(const char config[])
+{
+    putsUart0("stress: no stress suite, build with STRESS defined\n");
+    stressExit(false);
+    return false;
+}
+#endif
+
+#if !defined(HOST) && !defined(QEMU_MPS2)
+// The board has no way to pass a scenario, main() runs the application
+
+bool stressGetConfig(char config[], uint32_t size)
+{
+    return false;
+}
+
+void stressExit(bool ok)
+{
+    while (true);
+}
+#endif
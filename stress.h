@@ -0,0 +1,102 @@
+// Stress test functions
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target uC:       TM4C123GH6PM
+// System Clock:    40 MHz
+
+#ifndef STRESS_H_
+#define STRESS_H_
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "kernel.h"
+
+/*
+    Scenario stress suite
+
+    When the host port or QEMU passes a scenario, main() creates synthetic
+    workloads in place of the application, runs them for a fixed time and
+    checks the results against limits. The suite and its mutex and semaphores
+    are only built with STRESS defined (make clean first):
+        make -C host STRESS=on
+        HOST_STRESS="hog lock:4 lock:12:50:5 chain churn time=10000" host/rtos
+        make -C qemu STRESS=on stress SCENARIO="hog lock:4 lock:12:50:5 chain churn time=10000"
+
+    A scenario is a list of words. Workloads, times in ms, each word one task
+    (a chain is two):
+        hog[:prio]                      busy for the whole run, never yields (like Uncoop)
+        lock[:prio[:period[:hold]]]     locks stressMutex for hold every period (like LengthyFn, Important)
+        chain[:prio[:period[:work]]]    a producer posts a request every period, a consumer works
+                                        for work and acknowledges it, the producer waits for the
+                                        acknowledgement before the next request (like ReadKeys, Debounce)
+        churn[:prio[:period[:size]]]    allocates a block of 64 to size bytes every period and
+                                        frees the oldest of the last STRESS_CHURN_BLOCKS
+    Limits:
+        time=<ms>         run time, at most 50000 so two cycle counts of the run are
+                          less than 2^31 apart (see before() in stress.c)
+        latency=<us>      worst wake-up latency of any workload task (kernel measured, see kstats.h)
+        misses=<n>        deadline misses allowed per periodic task, the deadline is the period
+        heapfail=<n>      failed heap allocations allowed (HEAP_MAP.failedAllocations)
+
+    Each periodic task keeps an absolute release schedule, a job that ends
+    past its next release is a miss and the releases it overran are skipped.
+    Every task prints its result line STRESS_REPORT_GAP ms apart once the
+    time is up, then stops itself. StressMon waits for all of them, prints
+    the wake-up latencies and the verdict, then ends the run through
+    stressExit(): the exit status of host/rtos or QEMU is 0 on a pass.
+*/
+#define STRESS_MAX_WORKERS 8
+#define STRESS_MAX_LOCKS (1 + MAX_MUTEX_QUEUE_SIZE) // The owner and a full queue
+#define STRESS_MAX_CHAINS 2
+#define STRESS_CONFIG_SIZE 128
+#define STRESS_WORD_SIZE 24
+#define STRESS_MAX_TIME 50000
+#define STRESS_REPORT_GAP 20
+#define STRESS_POLL_PERIOD 100
+#define STRESS_CHURN_BLOCKS 4
+#define STRESS_CHURN_MIN_SIZE 64
+
+// Workload kinds, a chain word becomes a producer and a consumer
+#define STRESS_HOG 0
+#define STRESS_LOCK 1
+#define STRESS_PRODUCER 2
+#define STRESS_CONSUMER 3
+#define STRESS_CHURN 4
+
+typedef struct _STRESS_TASK
+{
+    uint8_t kind;
+    uint8_t priority;
+    uint8_t chain;   // index of the chain, producer and consumer only
+    uint32_t period; // ms, 0 if not periodic
+    uint32_t param;  // hold or work in ms, size in bytes
+} STRESS_TASK;
+
+typedef struct _STRESS_SCENARIO
+{
+    uint8_t count;
+    STRESS_TASK tasks[STRESS_MAX_WORKERS];
+    uint32_t time;
+    uint32_t latency;
+    uint32_t misses;
+    uint32_t heapFailures;
+} STRESS_SCENARIO;
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+bool initStress(const char config[]);
+
+// Provided by the platform: host/stress_host.c, qemu/stress_qemu.c
+bool stressGetConfig(char config[], uint32_t size);
+void stressExit(bool ok);
+
+#endif
@@ -0,0 +1,223 @@
+// Service calls
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target uC:       TM4C123GH6PM
+// System Clock:    40 MHz
+
+#ifndef SYSCALLS_H_
+#define SYSCALLS_H_
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+    Service call ABI
+
+    - R12 holds the service number, R0-R3 hold up to four arguments (AAPCS)
+    - SVC is executed, svCallIsr() reads the number from the stacked R12 and
+      indexes svcTable[] directly. The SVC immediate is the same number but it
+      is only there to make disassembly readable, the kernel never reads it
+    - The handler's return value is written to the stacked R0, so the wrapper
+      returns it to the caller when the exception returns
+    - Pointer arguments are checked against the caller's SRD window (or flash
+      for read only arguments) before the kernel touches them. A bad pointer
+      makes the call fail without side effects
+
+    Every wrapper is generated from SYSCALL_LIST so the number, the handler and
+    the C prototype cannot drift apart.
+*/
+
+//-----------------------------------------------------------------------------
+// Service call numbers
+//-----------------------------------------------------------------------------
+#define SVC_START_R 0
+#define SVC_YIELD 1
+#define SVC_RESTART_T 2
+#define SVC_STOP_T 3
+#define SVC_SET_PRIORITY_T 4
+#define SVC_SLEEP 5
+#define SVC_LOCK 6
+#define SVC_UNLOCK 7
+#define SVC_WAIT 8
+#define SVC_POST 9
+#define SVC_MALLOC_WRAPPER 10
+#define SVC_FREE_WRAPPER 11
+
+#define SVC_REBOOT 12
+#define SVC_PS 13
+#define SVC_IPCS 14 // Retired: ipcs reads the telemetry snapshot
+#define SVC_KILL 15 // Retired: kill uses SVC_STOP_T
+#define SVC_PKILL 16 // Retired: pkill uses SVC_STOP_T
+#define SVC_PI 17
+#define SVC_PREEMPT 18
+#define SVC_SCHED 19
+#define SVC_PIDOF 20
+#define SVC_MEMINFO 21
+#define SVC_GET_PROCESSES 22
+#define SVC_TELEMETRY 23
+#define SVC_BATCH 24
+#define SVC_REALLOC_WRAPPER 25
+#define SVC_HEAP_MAP 26
+#define SVC_ALLOC_POLICY 27
+#define SVC_HMALLOC 28
+#define SVC_HLOCK 29
+#define SVC_HUNLOCK 30
+#define SVC_HFREE 31
+#define SVC_COMPACT 32
+#define SVC_CYCLE_COUNT 33
+#define SVC_HEAP_TRACE 34
+#define SVC_WAKE_RESET 35
+#define SVC_SPAWN_T 36
+#define SVC_TRACE_CONTROL 37
+#define SVC_KERNEL_TRACE 38
+
+#define NUM_SVCS 39
+
+//-----------------------------------------------------------------------------
+// Syscall table
+//-----------------------------------------------------------------------------
+
+//      number              kernel handler          return      wrapper                     wrapper parameters
+#define SYSCALL_LIST(X)                                                                                                                          \
+    X(SVC_START_R,          svcStartRtos,           void,       launchTask,                 (void))                                          \
+    X(SVC_YIELD,            svcYield,               void,       yield,                      (void))                                          \
+    X(SVC_RESTART_T,        svcRestartThread,       void,       restartThread,              (_fn fn))                                        \
+    X(SVC_STOP_T,           svcStopThread,          bool,       stopThread,                 (_fn fn))                                        \
+    X(SVC_SET_PRIORITY_T,   svcSetThreadPriority,   void,       setThreadPriority,          (_fn fn, uint8_t priority))                      \
+    X(SVC_SLEEP,            svcSleep,               void,       sleep,                      (uint32_t tick))                                 \
+    X(SVC_LOCK,             svcLock,                bool,       lock,                       (int8_t mutex))                                  \
+    X(SVC_UNLOCK,           svcUnlock,              void,       unlock,                     (int8_t mutex))                                  \
+    X(SVC_WAIT,             svcWait,                bool,       wait,                       (int8_t semaphore))                              \
+    X(SVC_POST,             svcPost,                void,       post,                       (int8_t semaphore))                              \
+    X(SVC_MALLOC_WRAPPER,   svcMalloc,              void *,     malloc_from_heap_wrapper,   (uint32_t size))                                 \
+    X(SVC_FREE_WRAPPER,     svcFree,                bool,       free_to_heap_wrapper,       (void *pMemory))                                 \
+    X(SVC_REBOOT,           svcReboot,              void,       reboot,                     (void))                                          \
+    X(SVC_PS,               svcPs,                  void,       ps,                         (uint32_t *pidsArray, char namesOfTasks[][10],   \
+                                                                                             uint32_t *statesArray,                          \
+                                                                                             uint8_t *mutex_semaphore_array))                \
+    X(SVC_PREEMPT,          svcPreempt,             void,       preempt,                    (bool state))                                    \
+    X(SVC_SCHED,            svcSched,               void,       sched,                      (bool prio_on))                                  \
+    X(SVC_PIDOF,            svcPidof,               uint32_t,   pidof,                      (const char name[]))                             \
+    X(SVC_MEMINFO,          svcMeminfo,             uint8_t,    meminfo,                    (char namesOfTasks[][10], uint32_t *baseAddress, \
+                                                                                             uint32_t *sizeOfTask,                           \
+                                                                                             uint32_t *dynamicMemOfEachTask))                \
+    X(SVC_GET_PROCESSES,    svcGetProcesses,        uint32_t,   getListOfProcesses,         (char processList[][10]))                        \
+    X(SVC_TELEMETRY,        svcTelemetry,           void,       getTelemetrySnapshot,       (TELEMETRY_SNAPSHOT *snapshot))                  \
+    X(SVC_BATCH,            svcBatch,               uint32_t,   syscallBatch,               (SYSCALL_RECORD *records, uint32_t count))      \
+    X(SVC_REALLOC_WRAPPER,  svcRealloc,             void *,     realloc_from_heap_wrapper,  (void *pMemory, uint32_t size))                  \
+    X(SVC_HEAP_MAP,         svcHeapMap,             void,       getHeapMap,                 (HEAP_MAP *map))                                 \
+    X(SVC_ALLOC_POLICY,     svcAllocPolicy,         bool,       allocPolicy,                (uint8_t policy))                                \
+    X(SVC_HMALLOC,          svcHandleMalloc,        HANDLE,     hmalloc,                    (uint32_t size))                                 \
+    X(SVC_HLOCK,            svcHandleLock,          void *,     hlock,                      (HANDLE handle))                                 \
+    X(SVC_HUNLOCK,          svcHandleUnlock,        bool,       hunlock,                    (HANDLE handle))                                 \
+    X(SVC_HFREE,            svcHandleFree,          bool,       hfree,                      (HANDLE handle))                                 \
+    X(SVC_COMPACT,          svcCompact,             bool,       compactHeap,                (void))                                          \
+    X(SVC_CYCLE_COUNT,      svcCycleCount,          uint32_t,   getCycleCount,              (void))                                          \
+    X(SVC_HEAP_TRACE,       svcHeapTrace,           uint32_t,   getHeapTrace,               (HEAP_TRACE_RECORD *records, uint32_t count,     \
+                                                                                             uint32_t *dropped))                             \
+    X(SVC_WAKE_RESET,       svcResetWakeStats,      void,       resetWakeStats,             (void))                                          \
+    X(SVC_SPAWN_T,          svcSpawnThread,         bool,       spawnThread,                (const THREAD_SPEC *spec))                       \
+    X(SVC_TRACE_CONTROL,    svcTraceControl,        bool,       traceControl,               (uint8_t mask))                                  \
+    X(SVC_KERNEL_TRACE,     svcKernelTrace,         uint32_t,   getKernelTrace,             (KTRACE_RECORD *records, uint32_t count,         \
+                                                                                             uint32_t *dropped))
+
+//-----------------------------------------------------------------------------
+// Batched service calls
+//-----------------------------------------------------------------------------
+
+/*
+    syscallBatch() runs up to MAX_BATCH_OPS service calls for the price of one
+    exception entry/exit. Records are executed in order with the same handlers
+    as the single calls and each result is written back to its record.
+
+    - Any reschedule requested by the ops (yield, sleep, a blocking wait...)
+      only pends PendSV, which cannot preempt the SVC handler, so the task
+      switch happens once after the whole batch
+    - The batch stops after an op that leaves the caller not READY (e.g. it
+      blocked on a wait or went to sleep), the remaining records are not run
+    - SVC_START_R and SVC_BATCH cannot be batched
+    - Returns the number of records that were executed
+
+    Example, post two semaphores and sleep in one trap:
+        SYSCALL_RECORD batch[3] = {SYSCALL_OP1(SVC_POST, keyPressed),
+                                   SYSCALL_OP1(SVC_POST, flashReq),
+                                   SYSCALL_OP1(SVC_SLEEP, 100)};
+        syscallBatch(batch, 3);
+*/
+#define MAX_BATCH_OPS 8
+
+typedef struct _SYSCALL_RECORD
+{
+    uint32_t op;      // SVC_ number
+    uint32_t args[4]; // R0-R3 of the single call
+    uint32_t result;  // R0 returned by the single call
+} SYSCALL_RECORD;
+
+#define SYSCALL_OP0(op) {(op), {0, 0, 0, 0}, 0}
+#define SYSCALL_OP1(op, a0) {(op), {(uint32_t)(a0), 0, 0, 0}, 0}
+#define SYSCALL_OP2(op, a0, a1) {(op), {(uint32_t)(a0), (uint32_t)(a1), 0, 0}, 0}
+
+//-----------------------------------------------------------------------------
+// Stub generation
+//-----------------------------------------------------------------------------
+
+#define SVC_STR_(x) #x
+#define SVC_STR(x) SVC_STR_(x)
+
+#ifdef HOST
+// Host port: the number is passed as a fifth argument to hostSvCall()
+// (host/hal_host.c), which plays the part of the SVC exception
+#if defined(__x86_64__)
+#define SVC_CALL(number) __asm(" movl $" SVC_STR(number) ", %r8d\n jmp hostSvCall")
+#else
+#error "host port: no service call stub for this architecture"
+#endif
+#define SYSCALL_STUB_ATTRIBUTES __attribute__((naked))
+#else
+// Arguments are already in R0-R3, only the number has to be loaded
+#define SVC_CALL(number)                     \
+    __asm(" MOV R12, #" SVC_STR(number));    \
+    __asm(" SVC #" SVC_STR(number))
+#define SYSCALL_STUB_ATTRIBUTES
+#endif
+
+// The result comes back in R0, so non-void wrappers have no return statement
+#define SYSCALL_STUB(number, handler, type, wrapper, params) \
+    SYSCALL_STUB_ATTRIBUTES type wrapper params              \
+    {                                                        \
+        SVC_CALL(number);                                    \
+    }
+
+// Exception frame stacked by the hardware on the PSP
+typedef struct _SVC_FRAME
+{
+    uint32_t r0;
+    uint32_t r1;
+    uint32_t r2;
+    uint32_t r3;
+    uint32_t r12;
+    uint32_t lr;
+    uint32_t pc;
+    uint32_t xpsr;
+} SVC_FRAME;
+
+typedef uint32_t (*_svcHandler)(SVC_FRAME *frame);
+
+#define SYSCALL_HANDLER_PROTOTYPE(number, handler, type, wrapper, params) static uint32_t handler(SVC_FRAME *frame);
+#define SYSCALL_TABLE_ENTRY(number, handler, type, wrapper, params) [number] = handler,
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+void svcDispatch(SVC_FRAME *frame);
+uint32_t syscallBatch(SYSCALL_RECORD *records, uint32_t count);
+
+#endif
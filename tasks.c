@@ -100,6 +100,8 @@ void idle(void)
         setPinValue(ORANGE_LED, 1);
         waitMicrosecond(1000);
         setPinValue(ORANGE_LED, 0);
+        // Nothing else is ready, move one relocatable block down the heap
+        compactHeap();
         yield();
     }
 }
@@ -0,0 +1,219 @@
+// Telemetry functions
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target uC:       TM4C123GH6PM
+// System Clock:    40 MHz
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#include <stdint.h>
+#include "tm4c123gh6pm.h"
+#include "telemetry.h"
+#include "uart0.h"
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+/**
+ * @brief
+ * Decodes a COBS block in place (the delimiter must not be included)
+ *
+ * @return Number of decoded bytes or 0 if the block is malformed
+ */
+uint16_t cobsDecode(uint8_t *data, uint16_t length)
+{
+    uint16_t readIdx = 0;
+    uint16_t writeIdx = 0;
+    uint8_t code, i;
+
+    while (readIdx < length)
+    {
+        code = data[readIdx++];
+        if (code == 0 || readIdx + code - 1 > length)
+            return 0;
+
+        for (i = 1; i < code; i++)
+            data[writeIdx++] = data[readIdx++];
+
+        // A full block does not hide a zero, the end of the frame neither
+        if (code != 0xFF && readIdx < length)
+            data[writeIdx++] = 0;
+    }
+    return writeIdx;
+}
+
+/**
+ * @brief
+ * CRC-16/CCITT-FALSE (poly 0x1021, init 0xFFFF)
+ */
+uint16_t crc16(const uint8_t *data, uint16_t length)
+{
+    uint16_t crc = 0xFFFF;
+    uint16_t i;
+    uint8_t bit;
+
+    for (i = 0; i < length; i++)
+    {
+        crc ^= (uint16_t)data[i] << 8;
+        for (bit = 0; bit < 8; bit++)
+            crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+    }
+    return crc;
+}
+
+/**
+ * @brief
+ * Appends the CRC to the frame and writes it to UART0 with
+ * Consistent Overhead Byte Stuffing, followed by the 0x00 delimiter.
+ * COBS removes every 0x00 from the frame so 0x00 can only mean end of frame.
+ * The blocks are encoded on the fly so no second buffer is needed.
+ * The frame buffer must have TELEMETRY_CRC_SIZE spare bytes at the end for the CRC
+ */
+void sendFrame(uint8_t *frame, uint16_t length)
+{
+    uint16_t crc = crc16(frame, length);
+    uint16_t idx = 0;
+    uint8_t blockLength, i;
+
+    frame[length++] = crc & 0xFF;
+    frame[length++] = crc >> 8;
+
+    do
+    {
+        // A block is up to 254 non-zero bytes, prefixed by its length + 1
+        blockLength = 0;
+        while (idx + blockLength < length && frame[idx + blockLength] != 0 && blockLength < 0xFE)
+            blockLength++;
+
+        putcUart0(blockLength + 1);
+        for (i = 0; i < blockLength; i++)
+            putcUart0(frame[idx + i]);
+
+        idx += blockLength;
+        // Skip the zero that ended the block, full blocks do not end in one
+        if (blockLength < 0xFE)
+            idx++;
+    } while (idx <= length);
+
+    putcUart0(0);
+}
+
+/**
+ * @brief
+ * Writes a 32-bit value little endian and returns the next write index
+ */
+static uint16_t putU32(uint8_t *frame, uint16_t idx, uint32_t value)
+{
+    frame[idx++] = value & 0xFF;
+    frame[idx++] = (value >> 8) & 0xFF;
+    frame[idx++] = (value >> 16) & 0xFF;
+    frame[idx++] = (value >> 24) & 0xFF;
+    return idx;
+}
+
+static uint16_t putHeader(uint8_t *frame, uint8_t type, uint16_t seq)
+{
+    frame[0] = type;
+    frame[1] = seq & 0xFF;
+    frame[2] = seq >> 8;
+    return 3;
+}
+
+static void sendNamesFrame(TELEMETRY_SNAPSHOT *snapshot, uint16_t seq)
+{
+    uint8_t frame[TELEMETRY_MAX_PAYLOAD + TELEMETRY_CRC_SIZE];
+    uint16_t idx = putHeader(frame, TELEMETRY_FRAME_NAMES, seq);
+    uint8_t i, j;
+
+    frame[idx++] = snapshot->taskCount;
+    for (i = 0; i < snapshot->taskCount; i++)
+    {
+        idx = putU32(frame, idx, snapshot->tasks[i].pid);
+        for (j = 0; j < sizeof(snapshot->tasks[i].name) - 1 && snapshot->tasks[i].name[j] != 0; j++)
+            frame[idx++] = snapshot->tasks[i].name[j];
+        frame[idx++] = 0;
+    }
+
+    sendFrame(frame, idx);
+}
+
+static void sendSnapshotFrame(TELEMETRY_SNAPSHOT *snapshot, uint16_t seq)
+{
+    uint8_t frame[TELEMETRY_MAX_PAYLOAD + TELEMETRY_CRC_SIZE];
+    uint16_t idx = putHeader(frame, TELEMETRY_FRAME_SNAPSHOT, seq);
+    uint8_t i, j;
+
+    idx = putU32(frame, idx, snapshot->systemTicks);
+
+    frame[idx++] = snapshot->taskCount;
+    for (i = 0; i < snapshot->taskCount; i++)
+    {
+        idx = putU32(frame, idx, snapshot->tasks[i].pid);
+        idx = putU32(frame, idx, snapshot->tasks[i].cpuTicks);
+        frame[idx++] = snapshot->tasks[i].state;
+        frame[idx++] = snapshot->tasks[i].priority;
+        frame[idx++] = snapshot->tasks[i].currentPriority;
+        frame[idx++] = snapshot->tasks[i].blockedOn;
+    }
+
+    for (i = 0; i < NUM_SRAM_REGIONS; i++)
+        frame[idx++] = snapshot->heapBitmap[i];
+
+    frame[idx++] = MAX_MUTEXES;
+    for (i = 0; i < MAX_MUTEXES; i++)
+    {
+        frame[idx++] = snapshot->mutexes[i].lock;
+        frame[idx++] = snapshot->mutexes[i].lockedBy;
+        frame[idx++] = snapshot->mutexes[i].queueSize;
+        for (j = 0; j < MAX_MUTEX_QUEUE_SIZE; j++)
+            frame[idx++] = snapshot->mutexes[i].processQueue[j];
+    }
+
+    frame[idx++] = MAX_SEMAPHORES;
+    for (i = 0; i < MAX_SEMAPHORES; i++)
+    {
+        frame[idx++] = snapshot->semaphores[i].count;
+        frame[idx++] = snapshot->semaphores[i].queueSize;
+        for (j = 0; j < MAX_SEMAPHORE_QUEUE_SIZE; j++)
+            frame[idx++] = snapshot->semaphores[i].processQueue[j];
+    }
+
+    sendFrame(frame, idx);
+}
+
+/**
+ * @brief
+ * Streams framed binary snapshots of the kernel state every periodMs
+ * until a key is received on UART0.
+ * Runs in the calling (unprivileged) task, so every buffer lives on its stack
+ */
+void streamTelemetry(uint32_t periodMs)
+{
+    TELEMETRY_SNAPSHOT snapshot;
+    uint16_t seq = 0;
+
+    if (periodMs == 0)
+        periodMs = TELEMETRY_DEFAULT_PERIOD;
+
+    while (!kbhitUart0())
+    {
+        getTelemetrySnapshot(&snapshot);
+
+        // Names only change when threads are created, so they are sent sparingly
+        if ((seq % TELEMETRY_NAMES_INTERVAL) == 0)
+            sendNamesFrame(&snapshot, seq);
+        sendSnapshotFrame(&snapshot, seq);
+        seq++;
+
+        sleep(periodMs);
+    }
+
+    // Consume the key that stopped the stream
+    getcUart0();
+}
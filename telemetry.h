@@ -0,0 +1,94 @@
+// Telemetry functions
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target uC:       TM4C123GH6PM
+// System Clock:    40 MHz
+
+#ifndef TELEMETRY_H_
+#define TELEMETRY_H_
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "kernel.h"
+#include "mm.h"
+
+/*
+    Wire format (all multi-byte fields are little endian)
+
+    Every frame is COBS encoded and terminated by a 0x00 byte:
+        type (1) | sequence (2) | payload (n) | CRC-16/CCITT of type..payload (2)
+
+    TELEMETRY_FRAME_NAMES payload:
+        taskCount (1) | taskCount x { pid (4) | name, null terminated }
+
+    TELEMETRY_FRAME_SNAPSHOT payload:
+        systemTicks (4) | taskCount (1) |
+        taskCount x { pid (4) | cpuTicks (4) | state (1) | priority (1) | currentPriority (1) | blockedOn (1) } |
+        heap bitmap (NUM_SRAM_REGIONS, one byte per region, bit set = subregion allocated) |
+        mutexCount (1) | mutexCount x { lock (1) | lockedBy (1) | queueSize (1) | queue (MAX_MUTEX_QUEUE_SIZE) } |
+        semaphoreCount (1) | semaphoreCount x { count (1) | queueSize (1) | queue (MAX_SEMAPHORE_QUEUE_SIZE) }
+*/
+#define TELEMETRY_FRAME_NAMES 0x01
+#define TELEMETRY_FRAME_SNAPSHOT 0x02
+
+#define TELEMETRY_DEFAULT_PERIOD 100 // ms between snapshots
+#define TELEMETRY_NAMES_INTERVAL 16  // Resend the task names every 16 snapshots
+
+#define TELEMETRY_MAX_PAYLOAD 320 // Names frame of MAX_TASKS tasks with 15 character names
+#define TELEMETRY_CRC_SIZE 2
+
+typedef struct _TELEMETRY_TASK
+{
+    uint32_t pid;
+    uint32_t cpuTicks;       // systick interrupts that landed while the task was running
+    uint8_t state;
+    uint8_t priority;
+    uint8_t currentPriority;
+    uint8_t blockedOn;       // index of the mutex or semaphore
+    char name[16];
+} TELEMETRY_TASK;
+
+typedef struct _TELEMETRY_MUTEX
+{
+    uint8_t lock;
+    uint8_t lockedBy;
+    uint8_t queueSize;
+    uint8_t processQueue[MAX_MUTEX_QUEUE_SIZE];
+} TELEMETRY_MUTEX;
+
+typedef struct _TELEMETRY_SEMAPHORE
+{
+    uint8_t count;
+    uint8_t queueSize;
+    uint8_t processQueue[MAX_SEMAPHORE_QUEUE_SIZE];
+} TELEMETRY_SEMAPHORE;
+
+typedef struct _TELEMETRY_SNAPSHOT
+{
+    uint32_t systemTicks;
+    uint8_t taskCount;
+    TELEMETRY_TASK tasks[MAX_TASKS];
+    uint8_t heapBitmap[NUM_SRAM_REGIONS];
+    TELEMETRY_MUTEX mutexes[MAX_MUTEXES];
+    TELEMETRY_SEMAPHORE semaphores[MAX_SEMAPHORES];
+} TELEMETRY_SNAPSHOT;
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+void getTelemetrySnapshot(TELEMETRY_SNAPSHOT *snapshot);
+void streamTelemetry(uint32_t periodMs);
+
+uint16_t cobsDecode(uint8_t *data, uint16_t length);
+uint16_t crc16(const uint8_t *data, uint16_t length);
+void sendFrame(uint8_t *frame, uint16_t length);
+
+#endif
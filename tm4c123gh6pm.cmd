@@ -39,6 +39,7 @@ SECTIONS
     .vtable :   > 0x20000000
     .data   :   > SRAM
     .bss    :   > SRAM
+    .kstats :   > 0x20000C00  /* kernel statistics page, the last 1 KiB of SRAM: aligned for the MPU without padding */
     .sysmem :   > SRAM
     .stack  :   > SRAM
     .heap   :   > HEAP
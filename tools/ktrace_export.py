@@ -0,0 +1,251 @@
+#!/usr/bin/env python3
+"""Convert the output of the shell `trace dump` command to Chrome trace JSON.
+
+Open the result in https://ui.perfetto.dev or chrome://tracing. The RTOS must
+be built with KERNEL_TRACE defined (make -C host KERNEL_TRACE=on on the host).
+Save the console output of one or more dumps, other lines are ignored:
+
+    trace start              # or e.g. trace start switch wake tick
+    ...
+    trace stop
+    trace dump
+
+    ktrace_export.py console.log -o trace.json
+
+Each task gets two tracks: "<name>" with a slice for every time it ran and
+the service calls it made, and "<name> wait" with what it waited for (sleep,
+mutex, semaphore), then how long it was ready before it ran, the wake-up
+latency. Ticks go to their own track. Ring overruns ("# dropped") end every
+open slice, the events in between were lost. The record format is in ktrace.h.
+"""
+
+import argparse
+import json
+import os
+import re
+import sys
+
+# Must match ktrace.h
+EVENTS = {"s": "switch", "b": "block", "w": "wake", "c": "svc", "t": "tick", "f": "fault"}
+BLOCK_REASONS = {1: "sleep", 2: "lock", 3: "wait", 4: "stopped"}
+WAKE_SOURCES = {1: "tick", 2: "unlock", 3: "post", 4: "restart"}
+FAULTS = {1: "MPU fault", 2: "hard fault", 3: "bus fault", 4: "usage fault"}
+
+SVC_NUMBER = re.compile(r"#define\s+(SVC_\w+)\s+(\d+)")
+SVC_ENTRY = re.compile(r"X\(\s*(SVC_\w+)\s*,\s*\w+\s*,\s*[^,]+,\s*(\w+)\s*,")
+
+ANSI_ESCAPE = re.compile(r"\x1b\[[0-9;]*[A-Za-z]")
+
+PID = 1
+TICK_TID = 1
+
+
+def read_syscalls(path):
+    """Service call names (the wrappers of SYSCALL_LIST) by number."""
+    names = {}
+    if not os.path.exists(path):
+        return names
+    with open(path) as source:
+        text = source.read()
+    numbers = {name: int(number) for name, number in SVC_NUMBER.findall(text)}
+    for svc, wrapper in SVC_ENTRY.findall(text):
+        if svc in numbers:
+            names[numbers[svc]] = wrapper
+    return names
+
+
+def read_dumps(path):
+    """Clock, task names and records of every dump in the file, in order.
+
+    Records are (kind, time, task, arg, detail), a ring overrun is ("dropped", count)
+    """
+    clock = None
+    tasks = {}
+    records = []
+    inside = False
+    with open(path, errors="replace") as console:
+        for line in console:
+            line = ANSI_ESCAPE.sub("", line).strip()
+            if line == "# ktrace":
+                inside = True
+                continue
+            if not inside:
+                continue
+            if not line:
+                inside = False
+                continue
+            fields = line.split()
+            if fields[0] == "#" and len(fields) >= 3:
+                if fields[1] == "clock":
+                    clock = int(fields[2])
+                elif fields[1] == "task" and len(fields) >= 4:
+                    tasks[int(fields[2])] = fields[3]
+                elif fields[1] == "dropped":
+                    records.append(("dropped", int(fields[2])))
+            elif fields[0] in EVENTS and len(fields) == 5:
+                records.append((fields[0],) + tuple(int(f) for f in fields[1:]))
+    return clock, tasks, records
+
+
+class Exporter:
+    def __init__(self, clock, tasks, syscalls):
+        self.clock = clock
+        self.tasks = tasks
+        self.syscalls = syscalls
+        self.events = []
+        self.running = None  # (task, start)
+        self.waiting = {}    # task: (name, start, args)
+        self.ready = {}      # task: (source, start)
+        self.latency = {}    # task: [count, total, worst] in us
+        self.busy = {}       # task: us
+        self.dropped = 0
+        self.last = None
+        self.epoch = 0
+
+    def us(self, cycles):
+        return cycles * 1e6 / self.clock
+
+    def unwrap(self, time):
+        # 32 bit cycle counter, consecutive records are less than a wrap apart
+        if self.last is not None and time < self.last:
+            self.epoch += 1 << 32
+        self.last = time
+        return self.us(self.epoch + time)
+
+    def name(self, task):
+        return self.tasks.get(task, "task %d" % task)
+
+    def run_tid(self, task):
+        return 2 * task + 2
+
+    def wait_tid(self, task):
+        return 2 * task + 3
+
+    def slice(self, tid, name, start, end, args=None):
+        event = {"ph": "X", "pid": PID, "tid": tid, "name": name, "ts": start, "dur": max(end - start, 0.0)}
+        if args:
+            event["args"] = args
+        self.events.append(event)
+
+    def instant(self, tid, name, ts, args=None):
+        event = {"ph": "i", "s": "t", "pid": PID, "tid": tid, "name": name, "ts": ts}
+        if args:
+            event["args"] = args
+        self.events.append(event)
+
+    def lost(self, count):
+        # The state of every task is unknown after events were lost
+        self.dropped += count
+        self.running = None
+        self.waiting.clear()
+        self.ready.clear()
+
+    def end_wait(self, task, ts):
+        if task in self.waiting:
+            name, start, args = self.waiting.pop(task)
+            self.slice(self.wait_tid(task), name, start, ts, args)
+
+    def switch(self, task, previous, ts):
+        if self.running is not None and self.running[0] == previous:
+            self.slice(self.run_tid(previous), "running", self.running[1], ts)
+            self.busy[previous] = self.busy.get(previous, 0.0) + ts - self.running[1]
+        if task in self.ready:
+            source, start = self.ready.pop(task)
+            latency = ts - start
+            stats = self.latency.setdefault(task, [0, 0.0, 0.0])
+            stats[0] += 1
+            stats[1] += latency
+            stats[2] = max(stats[2], latency)
+            self.slice(self.wait_tid(task), "ready", start, ts, {"woken by": source, "latency us": round(latency, 3)})
+        self.running = (task, ts)
+
+    def add(self, record):
+        if record[0] == "dropped":
+            self.lost(record[1])
+            return
+        kind, time, task, arg, detail = record
+        ts = self.unwrap(time)
+        if kind == "s":
+            self.switch(task, arg, ts)
+        elif kind == "b":
+            reason = BLOCK_REASONS.get(arg, "blocked")
+            name = reason
+            if reason == "lock":
+                name = "lock mutex %d" % detail
+            elif reason == "wait":
+                name = "wait semaphore %d" % detail
+            self.end_wait(task, ts)
+            self.ready.pop(task, None)
+            self.waiting[task] = (name, ts, None)
+        elif kind == "w":
+            source = WAKE_SOURCES.get(arg, "?")
+            if arg in (2, 3):
+                source += " %d" % detail
+            self.end_wait(task, ts)
+            self.ready[task] = (source, ts)
+        elif kind == "c":
+            self.instant(self.run_tid(task), self.syscalls.get(arg, "svc %d" % arg), ts, {"svc": arg})
+        elif kind == "t":
+            self.instant(TICK_TID, "tick", ts, {"interrupted": self.name(task)})
+        elif kind == "f":
+            self.instant(self.run_tid(task), FAULTS.get(arg, "fault"), ts)
+
+    def metadata(self, tasks):
+        meta = [{"ph": "M", "pid": PID, "name": "process_name", "args": {"name": "RTOS"}},
+                {"ph": "M", "pid": PID, "tid": TICK_TID, "name": "thread_name", "args": {"name": "SysTick"}},
+                {"ph": "M", "pid": PID, "tid": TICK_TID, "name": "thread_sort_index", "args": {"sort_index": 0}}]
+        for task in sorted(tasks):
+            for tid, suffix in ((self.run_tid(task), ""), (self.wait_tid(task), " wait")):
+                meta.append({"ph": "M", "pid": PID, "tid": tid, "name": "thread_name",
+                             "args": {"name": self.name(task) + suffix}})
+                meta.append({"ph": "M", "pid": PID, "tid": tid, "name": "thread_sort_index",
+                             "args": {"sort_index": tid}})
+        return meta
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("console", help="saved console output with trace dumps")
+    parser.add_argument("-o", "--output", help="JSON file, stdout if not given")
+    parser.add_argument("--clock", type=int, help="cycles per second, overrides the dump's '# clock'")
+    parser.add_argument("--syscalls", default=os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "syscalls.h"),
+                        help="names the service calls (default: the repository's syscalls.h)")
+    args = parser.parse_args()
+
+    clock, tasks, records = read_dumps(args.console)
+    clock = args.clock or clock
+    if not records:
+        print("no trace dump in %s" % args.console, file=sys.stderr)
+        return 1
+    if not clock:
+        print("no '# clock' line, give --clock", file=sys.stderr)
+        return 1
+
+    exporter = Exporter(clock, tasks, read_syscalls(args.syscalls))
+    for record in records:
+        exporter.add(record)
+
+    used = set(tasks)
+    for record in records:
+        if record[0] != "dropped":
+            used.add(record[2])
+            if record[0] == "s":
+                used.add(record[3])
+    trace = {"traceEvents": exporter.metadata(used) + exporter.events, "displayTimeUnit": "ns"}
+    if args.output:
+        with open(args.output, "w") as out:
+            json.dump(trace, out)
+    else:
+        json.dump(trace, sys.stdout)
+
+    print("%d events, %d dropped" % (len(records), exporter.dropped), file=sys.stderr)
+    print("%-10s %10s %8s %10s %10s" % ("Task", "Run us", "Wakeups", "Avg us", "Max us"), file=sys.stderr)
+    for task in sorted(used):
+        count, total, worst = exporter.latency.get(task, [0, 0.0, 0.0])
+        print("%-10s %10.1f %8d %10.1f %10.1f" % (exporter.name(task), exporter.busy.get(task, 0.0), count,
+                                                  total / count if count else 0.0, worst), file=sys.stderr)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,193 @@
+#!/usr/bin/env python3
+"""Host side of the binary command interface (see rpc.h).
+
+Usage as a library:
+    with RpcClient("/dev/ttyACM0") as rtos:
+        print(rtos.ps())
+        rtos.sched(prio=True)
+        results = rtos.batch([(OP_PIDOF, b"Shell"), (OP_MEMINFO, b"")])
+
+Usage from the command line:
+    rpc_client.py /dev/ttyACM0 ps
+    rpc_client.py /dev/ttyACM0 pidof Shell
+    rpc_client.py /dev/ttyACM0 sched rr
+"""
+
+import argparse
+import struct
+import sys
+
+from telemetry_decode import cobs_decode, crc16, STATES
+
+FRAME_REQUEST = 0x10
+FRAME_RESPONSE = 0x11
+
+OP_PING = 0x00
+OP_PS = 0x01
+OP_KILL = 0x02
+OP_SCHED = 0x03
+OP_PREEMPT = 0x04
+OP_MEMINFO = 0x05
+OP_PIDOF = 0x06
+OP_TEXT_MODE = 0x7F
+
+STATUS = {0: "OK", 1: "UNKNOWN_OP", 2: "BAD_ARGS", 3: "NOT_FOUND", 4: "NO_SPACE"}
+
+
+class RpcError(Exception):
+    pass
+
+
+def cobs_encode(data):
+    out = bytearray()
+    block = bytearray()
+    for byte in data:
+        if byte == 0:
+            out += bytes([len(block) + 1]) + block
+            block = bytearray()
+        else:
+            block.append(byte)
+            if len(block) == 0xFE:
+                out += b"\xff" + block
+                block = bytearray()
+    out += bytes([len(block) + 1]) + block
+    return bytes(out)
+
+
+def _names(payload, idx, count, fixed):
+    entries = []
+    for _ in range(count):
+        fields = struct.unpack_from(fixed, payload, idx)
+        idx += struct.calcsize(fixed)
+        end = payload.index(0, idx)
+        entries.append(fields + (payload[idx:end].decode("ascii", "replace"),))
+        idx = end + 1
+    return entries
+
+
+def parse_result(op, result):
+    if op == OP_PS:
+        return [{"pid": pid, "state": STATES.get(state, "UNKNOWN"), "mutex_semaphore": ms, "name": name}
+                for pid, state, ms, name in _names(result, 1, result[0], "<IBB")]
+    if op == OP_MEMINFO:
+        return [{"base": base, "size": size, "dynamic": dynamic, "name": name}
+                for base, size, dynamic, name in _names(result, 1, result[0], "<III")]
+    if op == OP_PIDOF:
+        return struct.unpack("<I", result)[0]
+    return None
+
+
+class RpcClient:
+    def __init__(self, port, baud=115200, timeout=2.0, enter=True):
+        import serial  # pyserial
+        self.port = serial.Serial(port, baud, timeout=timeout)
+        self.request_id = 0
+        if enter:
+            self.port.write(b"rpc\r")
+            self.ping()
+
+    def close(self):
+        self.port.close()
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *exc):
+        self.close()
+
+    def batch(self, ops):
+        """Run [(op, args bytes), ...] in one frame, return [(status, result), ...]."""
+        self.request_id = (self.request_id + 1) & 0xFFFF
+        frame = struct.pack("<BHB", FRAME_REQUEST, self.request_id, len(ops))
+        for op, args in ops:
+            frame += struct.pack("<BB", op, len(args)) + args
+        frame += struct.pack("<H", crc16(frame))
+        self.port.write(cobs_encode(frame) + b"\x00")
+        return self._response(ops)
+
+    def _response(self, ops):
+        while True:
+            raw = self.port.read_until(b"\x00")
+            if not raw.endswith(b"\x00"):
+                raise RpcError("timeout waiting for request %d" % self.request_id)
+            try:
+                frame = cobs_decode(raw[:-1])
+            except ValueError:
+                continue
+            if len(frame) < 6 or crc16(frame[:-2]) != struct.unpack("<H", frame[-2:])[0]:
+                continue
+            kind, request_id, count = struct.unpack_from("<BHB", frame)
+            if kind != FRAME_RESPONSE or request_id != self.request_id:
+                continue
+            results = []
+            idx = 4
+            for _ in range(count):
+                op, status, length = struct.unpack_from("<BBH", frame, idx)
+                idx += 4
+                result = frame[idx:idx + length]
+                idx += length
+                results.append((STATUS.get(status, status), parse_result(op, result) if status == 0 else None))
+            if count < len(ops):
+                raise RpcError("only %d of %d ops executed" % (count, len(ops)))
+            return results
+
+    def _single(self, op, args=b""):
+        status, result = self.batch([(op, args)])[0]
+        if status != "OK":
+            raise RpcError("op 0x%02x failed: %s" % (op, status))
+        return result
+
+    def ping(self):
+        self._single(OP_PING)
+
+    def ps(self):
+        return self._single(OP_PS)
+
+    def kill(self, pid):
+        self._single(OP_KILL, struct.pack("<I", pid))
+
+    def sched(self, prio):
+        self._single(OP_SCHED, bytes([1 if prio else 0]))
+
+    def preempt(self, on):
+        self._single(OP_PREEMPT, bytes([1 if on else 0]))
+
+    def meminfo(self):
+        return self._single(OP_MEMINFO)
+
+    def pidof(self, name):
+        return self._single(OP_PIDOF, name.encode("ascii"))
+
+    def text_mode(self):
+        self._single(OP_TEXT_MODE)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("port")
+    parser.add_argument("command", choices=["ps", "kill", "sched", "preempt", "meminfo", "pidof", "text"])
+    parser.add_argument("arg", nargs="?")
+    parser.add_argument("--baud", type=int, default=115200)
+    args = parser.parse_args()
+
+    with RpcClient(args.port, args.baud) as rtos:
+        if args.command == "ps":
+            for task in rtos.ps():
+                print("0x%-8x %-10s %-18s %d" % (task["pid"], task["name"], task["state"], task["mutex_semaphore"]))
+        elif args.command == "meminfo":
+            for task in rtos.meminfo():
+                print("%-10s 0x%08x %6d %6d" % (task["name"], task["base"], task["size"], task["dynamic"]))
+        elif args.command == "kill":
+            rtos.kill(int(args.arg, 0))
+        elif args.command == "sched":
+            rtos.sched(args.arg.lower() == "prio")
+        elif args.command == "preempt":
+            rtos.preempt(args.arg.lower() == "on")
+        elif args.command == "pidof":
+            print("0x%x" % rtos.pidof(args.arg))
+        elif args.command == "text":
+            rtos.text_mode()
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,261 @@
+#!/usr/bin/env python3
+"""Fixed-priority response-time analysis of the task set.
+
+Tasks come from the createThread() calls in rtos.c (name, priority, stack)
+and/or from a task file that adds the timing. Tasks in both are merged by
+name, values in the task file win. Times are in ms.
+
+    [system]
+    tick = 1                 # SysTick period
+    tick_overhead = 0.005    # systickIsr() per tick
+    context_switch = 0.005   # pendSvIsr() and the scheduler, charged twice per preemption
+
+    [Flash4Hz]
+    priority = 8             # optional when --rtos gives it
+    period = 125             # period or minimum inter-arrival time
+    wcet = 0.05
+    deadline = 125           # defaults to the period
+    jitter = 0               # release jitter
+    lock.resource = 0.02     # longest critical section on each mutex it locks
+
+A task without a period is background work that may run whenever it is the
+highest ready task (Idle, Uncoop...). It makes every task of higher number
+(lower priority) unschedulable, and costs tasks of its own priority up to a
+tick per slice they run: the kernel round-robins equal priorities on every
+SysTick.
+
+Blocking, for the --protocol the mutexes use:
+    none  the kernel as it is: FIFO queues, no priority change. A task can
+          wait for every lower or equal priority task that shares a mutex,
+          and while it waits any task above the lowest of them preempts it
+    pip   priority inheritance: at most one critical section per lower task
+          and per mutex (the smaller sum of the two)
+    pcp   priority ceiling (immediate or original): one critical section
+
+Examples:
+    rta.py --rtos ../rtos.c rtos_tasks.ini
+    rta.py --rtos ../rtos.c rtos_tasks.ini --protocol pip
+    rta.py --rtos ../rtos.c rtos_tasks.ini --add Logger:6:50:2 --add Ctrl:2:10:1.5:5:resource=0.1
+
+--add NAME:PRIORITY:PERIOD:WCET[:DEADLINE[:MUTEX=CS,...]] checks a new task
+before it is deployed. The exit status is 1 if a deadline can be missed.
+"""
+
+import argparse
+import configparser
+import math
+import re
+import sys
+
+# Must match kernel.h
+NUM_PRIORITIES = 16
+
+CREATE_THREAD = re.compile(r'createThread\(\s*(\w+)\s*,\s*"([^"]*)"\s*,\s*(\d+)\s*,\s*(\d+)\s*\)')
+LIMIT = 1e9  # Response times past this are reported as unbounded
+
+
+def read_rtos(path):
+    """Tasks of the default build, threads created under #if (e.g. QEMU_MPS2) are left out."""
+    tasks = {}
+    lines = []
+    depth = 0
+    with open(path) as source:
+        for line in source:
+            directive = line.strip()
+            if directive.startswith("#if"):
+                depth += 1
+            elif directive.startswith("#endif"):
+                depth -= 1
+            elif depth == 0:
+                lines.append(line)
+        for fn, name, priority, stack in CREATE_THREAD.findall("".join(lines)):
+            tasks[name] = {"name": name, "fn": fn, "priority": int(priority), "stack": int(stack)}
+    return tasks
+
+
+def read_config(path, tasks, system):
+    config = configparser.ConfigParser(inline_comment_prefixes=("#", ";"))
+    config.optionxform = str  # task and mutex names are case sensitive
+    config.read_file(open(path))
+    for section in config.sections():
+        values = config[section]
+        if section == "system":
+            for key in values:
+                system[key] = float(values[key])
+            continue
+        task = tasks.setdefault(section, {"name": section})
+        for key in values:
+            if key.startswith("lock."):
+                task.setdefault("locks", {})[key[5:]] = float(values[key])
+            elif key in ("priority", "stack"):
+                task[key] = int(values[key])
+            else:
+                task[key] = float(values[key])
+
+
+def parse_add(text):
+    fields = text.split(":")
+    if len(fields) < 4:
+        raise argparse.ArgumentTypeError("expected NAME:PRIORITY:PERIOD:WCET[:DEADLINE[:MUTEX=CS,...]]")
+    task = {"name": fields[0], "priority": int(fields[1]), "period": float(fields[2]), "wcet": float(fields[3])}
+    if len(fields) > 4 and fields[4]:
+        task["deadline"] = float(fields[4])
+    if len(fields) > 5 and fields[5]:
+        task["locks"] = {m: float(cs) for m, cs in (lock.split("=") for lock in fields[5].split(","))}
+    return task
+
+
+def check(tasks):
+    for task in tasks:
+        if "priority" not in task:
+            sys.exit("rta: %s has no priority" % task["name"])
+        if not 0 <= task["priority"] < NUM_PRIORITIES:
+            sys.exit("rta: %s: priority out of range" % task["name"])
+        if "period" in task:
+            if "wcet" not in task:
+                sys.exit("rta: %s has a period but no wcet" % task["name"])
+            task.setdefault("deadline", task["period"])
+            task.setdefault("jitter", 0.0)
+        task.setdefault("locks", {})
+
+
+def blocking(task, tasks, protocol):
+    """Blocking term of task and the lowest priority (highest number) it can wait for."""
+    lower = [t for t in tasks if t is not task and t["priority"] >= task["priority"]]
+    sections = [(t, m, cs) for t in lower for m, cs in t["locks"].items() if m in task["locks"]]
+    if protocol == "pcp":
+        # Any lower task whose critical section has a ceiling at or above this task
+        ceilings = {m: min(t["priority"] for t in tasks if m in t["locks"]) for t in tasks for m in t["locks"]}
+        sections = [(t, m, cs) for t in lower for m, cs in t["locks"].items() if ceilings[m] <= task["priority"]]
+        return max([cs for _, _, cs in sections], default=0.0), task["priority"]
+    if protocol == "pip":
+        by_task = sum(max(cs for t, _, cs in sections if t is holder) for holder in {id(t): t for t, _, _ in sections}.values())
+        by_mutex = sum(max(cs for _, m, cs in sections if m == mutex) for mutex in {m for _, m, _ in sections})
+        return min(by_task, by_mutex), task["priority"]
+    # No protocol: every sharer ahead in the FIFO queue, preempted by anything above it
+    holders = {id(t): t for t, _, _ in sections}.values()
+    b = sum(max(cs for t, _, cs in sections if t is holder) for holder in holders)
+    return b, max([t["priority"] for t in holders], default=task["priority"])
+
+
+def response_time(task, tasks, system, protocol, scale=1.0):
+    """Worst-case response time, math.inf if there is no bound below LIMIT."""
+    tick = system.get("tick", 1.0)
+    cs = system.get("context_switch", 0.0)
+    b, exposed = blocking(task, tasks, protocol)
+    b *= scale
+    c = task["wcet"] * scale
+
+    higher = []
+    peers = 0
+    for other in tasks:
+        if other is task:
+            continue
+        # While blocked the task is exposed down to the priority of the holder
+        above = other["priority"] < task["priority"] or (exposed > task["priority"] and other["priority"] < exposed)
+        if "period" not in other:
+            if above:
+                return math.inf
+            if other["priority"] == task["priority"]:
+                peers += 1
+            continue
+        if above or other["priority"] == task["priority"]:
+            higher.append(other)
+
+    # A slice ends at every tick (the first one may be partial), then each
+    # peer of the same priority runs for up to a tick
+    slices = math.ceil(c / tick) + 1 if peers else 0
+    r = c + b
+    while True:
+        demand = c + b + math.ceil(r / tick) * system.get("tick_overhead", 0.0) + slices * peers * tick
+        for other in higher:
+            demand += math.ceil((r + other["jitter"]) / other["period"]) * (other["wcet"] * scale + 2 * cs)
+        if demand <= r + 1e-12:
+            return r + task["jitter"]
+        if demand > LIMIT:
+            return math.inf
+        r = demand
+
+
+def schedulable(periodic, tasks, system, protocol, scale=1.0):
+    return all(response_time(t, tasks, system, protocol, scale) <= t["deadline"] for t in periodic)
+
+
+def headroom(periodic, tasks, system, protocol):
+    """Largest factor every WCET and critical section can grow by and still meet all deadlines."""
+    if not periodic or not schedulable(periodic, tasks, system, protocol):
+        return None
+    low, high = 1.0, 2.0
+    while schedulable(periodic, tasks, system, protocol, high) and high < 1e6:
+        low, high = high, high * 2
+    for _ in range(40):
+        mid = (low + high) / 2
+        if schedulable(periodic, tasks, system, protocol, mid):
+            low = mid
+        else:
+            high = mid
+    return low
+
+
+def fmt(value):
+    return "unbounded" if value == math.inf else "%.3f" % value
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("taskfile", nargs="?", help="task timing (INI format above)")
+    parser.add_argument("--rtos", help="read names, priorities and stacks from the createThread() calls")
+    parser.add_argument("--protocol", choices=["none", "pip", "pcp"], default="none")
+    parser.add_argument("--add", type=parse_add, action="append", default=[], help="candidate task")
+    args = parser.parse_args()
+
+    if not args.taskfile and not args.rtos:
+        parser.error("give a task file, --rtos or both")
+
+    by_name = read_rtos(args.rtos) if args.rtos else {}
+    system = {}
+    if args.taskfile:
+        read_config(args.taskfile, by_name, system)
+    for task in args.add:
+        by_name[task["name"]] = task
+    tasks = sorted(by_name.values(), key=lambda t: t["priority"] if "priority" in t else -1)
+    check(tasks)
+
+    periodic = [t for t in tasks if "period" in t]
+    tick = system.get("tick", 1.0)
+    utilization = sum(t["wcet"] / t["period"] for t in periodic) + system.get("tick_overhead", 0.0) / tick
+
+    print("%-12s %3s %6s %9s %9s %9s %7s %9s %10s %10s  %s" % ("Task", "Pri", "Stack", "Period", "WCET", "Deadline",
+                                                             "U%", "Blocking", "WCRT", "Slack", "Result"))
+    ok = True
+    for task in tasks:
+        stack = str(task["stack"]) if "stack" in task else "-"
+        if "period" not in task:
+            print("%-12s %3d %6s %9s %9s %9s %7s %9s %10s %10s  %s" % (task["name"], task["priority"], stack,
+                                                                     "-", "-", "-", "-", "-", "-", "-", "background"))
+            continue
+        r = response_time(task, tasks, system, args.protocol)
+        b, _ = blocking(task, tasks, args.protocol)
+        met = r <= task["deadline"]
+        ok &= met
+        print("%-12s %3d %6s %9.3f %9.3f %9.3f %7.2f %9.3f %10s %10s  %s" % (
+            task["name"], task["priority"], stack, task["period"], task["wcet"], task["deadline"],
+            100.0 * task["wcet"] / task["period"], b, fmt(r), fmt(task["deadline"] - r) if met else "-",
+            "ok" if met else "MISS"))
+
+    n = len(periodic)
+    print("\nprotocol %s, utilization %.2f%%" % (args.protocol, 100.0 * utilization), end="")
+    if n:
+        print(" (Liu-Layland bound for %d tasks %.2f%%)" % (n, 100.0 * n * (2 ** (1.0 / n) - 1)))
+    else:
+        print()
+    factor = headroom(periodic, tasks, system, args.protocol)
+    if factor is not None:
+        print("headroom: WCETs can grow x%.2f, %.2f%% more utilization" % (factor, 100.0 * utilization * (factor - 1)))
+    else:
+        print("headroom: none, the task set misses deadlines")
+    return 0 if ok else 1
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,213 @@
+#!/usr/bin/env python3
+"""Decode the binary telemetry stream started with the shell `telemetry` command.
+
+Frames are COBS encoded, terminated by 0x00 and protected by a CRC-16/CCITT.
+The layout is documented in telemetry.h.
+
+Examples:
+    telemetry_decode.py /dev/ttyACM0                    # live table on the console
+    telemetry_decode.py /dev/ttyACM0 --record run.bin   # also keep the raw stream
+    telemetry_decode.py run.bin --csv run.csv --plot    # offline decode and CPU plot
+"""
+
+import argparse
+import csv
+import os
+import struct
+import sys
+
+FRAME_NAMES = 0x01
+FRAME_SNAPSHOT = 0x02
+
+STATES = {0: "INVALID", 1: "STOPPED", 2: "READY", 3: "DELAYED",
+          4: "BLOCKED_MUTEX", 5: "BLOCKED_SEMAPHORE"}
+
+# Must match kernel.h / mm.h
+MAX_MUTEX_QUEUE_SIZE = 2
+MAX_SEMAPHORE_QUEUE_SIZE = 2
+NUM_SRAM_REGIONS = 5
+
+
+def cobs_decode(data):
+    out = bytearray()
+    idx = 0
+    while idx < len(data):
+        code = data[idx]
+        if code == 0 or idx + code > len(data) + 1:
+            raise ValueError("bad COBS block")
+        out += data[idx + 1:idx + code]
+        idx += code
+        if code < 0xFF and idx < len(data):
+            out.append(0)
+    return bytes(out)
+
+
+def crc16(data):
+    crc = 0xFFFF
+    for byte in data:
+        crc ^= byte << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021) if crc & 0x8000 else crc << 1
+            crc &= 0xFFFF
+    return crc
+
+
+def parse_names(payload):
+    count = payload[0]
+    idx = 1
+    names = {}
+    for _ in range(count):
+        pid, = struct.unpack_from("<I", payload, idx)
+        idx += 4
+        end = payload.index(0, idx)
+        names[pid] = payload[idx:end].decode("ascii", "replace")
+        idx = end + 1
+    return names
+
+
+def parse_snapshot(payload):
+    ticks, count = struct.unpack_from("<IB", payload, 0)
+    idx = 5
+    tasks = []
+    for _ in range(count):
+        pid, cpu, state, prio, cur_prio, blocked = struct.unpack_from("<IIBBBB", payload, idx)
+        idx += 12
+        tasks.append({"pid": pid, "cpu": cpu, "state": state, "priority": prio,
+                      "current_priority": cur_prio, "blocked_on": blocked})
+    heap = list(payload[idx:idx + NUM_SRAM_REGIONS])
+    idx += NUM_SRAM_REGIONS
+
+    mutexes = []
+    for _ in range(payload[idx]):
+        lock, locked_by, qsize = payload[idx + 1:idx + 4]
+        queue = list(payload[idx + 4:idx + 4 + MAX_MUTEX_QUEUE_SIZE])[:qsize]
+        mutexes.append({"lock": lock, "locked_by": locked_by, "queue": queue})
+        idx += 3 + MAX_MUTEX_QUEUE_SIZE
+    idx += 1
+
+    semaphores = []
+    for _ in range(payload[idx]):
+        count_, qsize = payload[idx + 1:idx + 3]
+        queue = list(payload[idx + 3:idx + 3 + MAX_SEMAPHORE_QUEUE_SIZE])[:qsize]
+        semaphores.append({"count": count_, "queue": queue})
+        idx += 2 + MAX_SEMAPHORE_QUEUE_SIZE
+
+    return {"ticks": ticks, "tasks": tasks, "heap": heap,
+            "mutexes": mutexes, "semaphores": semaphores}
+
+
+def frames(stream, record=None):
+    """Yield (type, seq, payload) for every frame with a valid CRC."""
+    buffer = bytearray()
+    while True:
+        chunk = stream.read(256)
+        if not chunk:
+            return
+        if record:
+            record.write(chunk)
+        buffer += chunk
+        while 0 in buffer:
+            end = buffer.index(0)
+            raw = bytes(buffer[:end])
+            del buffer[:end + 1]
+            if not raw:
+                continue
+            try:
+                frame = cobs_decode(raw)
+            except ValueError:
+                continue
+            if len(frame) < 5 or crc16(frame[:-2]) != struct.unpack("<H", frame[-2:])[0]:
+                # Text from the shell or a damaged frame
+                continue
+            yield frame[0], struct.unpack_from("<H", frame, 1)[0], frame[3:-2]
+
+
+def open_input(path, baud):
+    if path == "-":
+        return sys.stdin.buffer
+    if os.path.exists(path) and not path.startswith("/dev/"):
+        return open(path, "rb")
+    import serial  # pyserial, only needed for live capture
+    return serial.Serial(path, baud, timeout=1)
+
+
+def print_snapshot(snap, names, previous):
+    elapsed = snap["ticks"] - previous["ticks"] if previous else 0
+    print("\033[2J\033[Hticks %d" % snap["ticks"])
+    print("%-12s %-10s %6s %-18s %4s" % ("Name", "PID", "CPU%", "State", "Prio"))
+    last = {t["pid"]: t["cpu"] for t in previous["tasks"]} if previous else {}
+    for task in snap["tasks"]:
+        cpu = 100.0 * (task["cpu"] - last.get(task["pid"], task["cpu"])) / elapsed if elapsed else 0.0
+        print("%-12s 0x%-8x %6.1f %-18s %4d" % (names.get(task["pid"], "?"), task["pid"], cpu,
+                                                STATES.get(task["state"], "UNKNOWN"), task["priority"]))
+    print("heap  " + " ".join("%02x" % b for b in snap["heap"]))
+    for i, mutex in enumerate(snap["mutexes"]):
+        print("mutex %d lock=%d by=%d queue=%s" % (i, mutex["lock"], mutex["locked_by"], mutex["queue"]))
+    for i, sem in enumerate(snap["semaphores"]):
+        print("sem   %d count=%d queue=%s" % (i, sem["count"], sem["queue"]))
+
+
+def plot(history, names):
+    import matplotlib.pyplot as plt
+    series = {}
+    for prev, snap in zip(history, history[1:]):
+        elapsed = snap["ticks"] - prev["ticks"]
+        if elapsed <= 0:
+            continue
+        last = {t["pid"]: t["cpu"] for t in prev["tasks"]}
+        for task in snap["tasks"]:
+            cpu = 100.0 * (task["cpu"] - last.get(task["pid"], task["cpu"])) / elapsed
+            series.setdefault(task["pid"], ([], []))
+            series[task["pid"]][0].append(snap["ticks"] / 1000.0)
+            series[task["pid"]][1].append(cpu)
+    for pid, (xs, ys) in series.items():
+        plt.plot(xs, ys, label=names.get(pid, hex(pid)))
+    plt.xlabel("time (s)")
+    plt.ylabel("CPU %")
+    plt.legend()
+    plt.show()
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("input", help="serial port, recorded file or - for stdin")
+    parser.add_argument("--baud", type=int, default=115200)
+    parser.add_argument("--record", help="write the raw stream to this file")
+    parser.add_argument("--csv", help="write one row per task per snapshot")
+    parser.add_argument("--plot", action="store_true", help="plot CPU usage when the stream ends")
+    parser.add_argument("--quiet", action="store_true", help="do not print the live table")
+    args = parser.parse_args()
+
+    record = open(args.record, "wb") if args.record else None
+    writer = None
+    if args.csv:
+        csv_file = open(args.csv, "w", newline="")
+        writer = csv.writer(csv_file)
+        writer.writerow(["seq", "ticks", "pid", "name", "cpu_ticks", "state", "priority",
+                         "current_priority", "blocked_on"])
+
+    names = {}
+    history = []
+    try:
+        for kind, seq, payload in frames(open_input(args.input, args.baud), record):
+            if kind == FRAME_NAMES:
+                names.update(parse_names(payload))
+            elif kind == FRAME_SNAPSHOT:
+                snap = parse_snapshot(payload)
+                if not args.quiet:
+                    print_snapshot(snap, names, history[-1] if history else None)
+                if writer:
+                    for task in snap["tasks"]:
+                        writer.writerow([seq, snap["ticks"], "0x%x" % task["pid"], names.get(task["pid"], ""),
+                                         task["cpu"], STATES.get(task["state"], "UNKNOWN"), task["priority"],
+                                         task["current_priority"], task["blocked_on"]])
+                history.append(snap)
+    except KeyboardInterrupt:
+        pass
+
+    if args.plot and history:
+        plot(history, names)
+
+
+if __name__ == "__main__":
+    main()
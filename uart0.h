@@ -31,7 +31,7 @@
 void initUart0();
 void setUart0BaudRate(uint32_t baudRate, uint32_t fcyc);
 void putcUart0(char c);
-void putsUart0(char* str);
+void putsUart0(const char* str);
 char getcUart0();
 bool kbhitUart0();
 